@@ -0,0 +1,105 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.  Produced at the
+// Lawrence Livermore National Laboratory in collaboration with University of
+// Illinois Urbana-Champaign.
+//
+// Written by the LBANN Research Team (N. Dryden, N. Maruyama, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-756777.
+// All rights reserved.
+//
+// This file is part of Aluminum GPU-aware Communication Library. For details, see
+// http://software.llnl.gov/Aluminum or https://github.com/LLNL/Aluminum.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include "Al.hpp"
+#include "test_utils.hpp"
+
+// Count every global operator new, from all threads.
+std::atomic<size_t> num_allocations(0);
+
+// The replacement operators go through these so the compiler does not pair
+// operator new with free, which it would warn about.
+__attribute__((noinline)) void* counted_alloc(std::size_t size) {
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+  void* ptr = std::malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+__attribute__((noinline)) void counted_free(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void* operator new(std::size_t size) {
+  return counted_alloc(size);
+}
+
+void operator delete(void* ptr) noexcept {
+  counted_free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+  counted_free(ptr);
+}
+
+const std::vector<size_t> sizes = {1, 1<<10, 1<<16};
+const size_t num_warmup = 10;
+const size_t num_ops = 1000;
+
+/** Return heap allocations per nonblocking allreduce in steady state. */
+double allocs_per_op(Al::MPIAllreduceAlgorithm algo, size_t size,
+                     Al::MPIBackend::comm_type& comm) {
+  std::vector<float> data(size, 1.0f);
+  Al::MPIBackend::req_type req = get_request<Al::MPIBackend>();
+  for (size_t i = 0; i < num_warmup; ++i) {
+    Al::NonblockingAllreduce<Al::MPIBackend>(
+      data.data(), data.size(), Al::ReductionOperator::sum, comm, req, algo);
+    Al::Wait<Al::MPIBackend>(req);
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+  const size_t start = num_allocations.load();
+  for (size_t i = 0; i < num_ops; ++i) {
+    Al::NonblockingAllreduce<Al::MPIBackend>(
+      data.data(), data.size(), Al::ReductionOperator::sum, comm, req, algo);
+    Al::Wait<Al::MPIBackend>(req);
+  }
+  const size_t end = num_allocations.load();
+  return static_cast<double>(end - start) / num_ops;
+}
+
+int main(int argc, char** argv) {
+  Al::Initialize(argc, argv);
+  Al::MPIBackend::comm_type comm(MPI_COMM_WORLD);
+  for (const auto& algo : get_nb_allreduce_algorithms<Al::MPIBackend>()) {
+    for (const auto& size : sizes) {
+      const double allocs = allocs_per_op(algo, size, comm);
+      if (comm.rank() == 0) {
+        std::cout << Al::algorithm_name(algo) << " size=" << size
+                  << " allocs/op=" << allocs << std::endl;
+      }
+    }
+  }
+  Al::Finalize();
+  return 0;
+}
@@ -0,0 +1,135 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.  Produced at the
+// Lawrence Livermore National Laboratory in collaboration with University of
+// Illinois Urbana-Champaign.
+//
+// Written by the LBANN Research Team (N. Dryden, N. Maruyama, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-756777.
+// All rights reserved.
+//
+// This file is part of Aluminum GPU-aware Communication Library. For details, see
+// http://software.llnl.gov/Aluminum or https://github.com/LLNL/Aluminum.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "Al.hpp"
+#include "test_utils.hpp"
+
+const size_t num_trials = 100;
+
+/** Simple executor that runs callbacks on a separate thread. */
+class ThreadExecutor {
+ public:
+  ThreadExecutor() : thread([this] () { run(); }) {}
+  ~ThreadExecutor() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stop = true;
+    }
+    cv.notify_one();
+    thread.join();
+  }
+  void submit(Al::CompletionCallback callback) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      callbacks.push_back(std::move(callback));
+    }
+    cv.notify_one();
+  }
+ private:
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      cv.wait(lock, [this] () { return stop || !callbacks.empty(); });
+      if (callbacks.empty()) {
+        return;
+      }
+      Al::CompletionCallback callback = std::move(callbacks.front());
+      callbacks.pop_front();
+      lock.unlock();
+      callback();
+      lock.lock();
+    }
+  }
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<Al::CompletionCallback> callbacks;
+  bool stop = false;
+  std::thread thread;
+};
+
+/**
+ * Time from starting an allreduce until the caller learns it completed,
+ * either by waiting on it or through a completion callback.
+ */
+void time_completion(const std::string& mode, size_t count,
+                     Al::MPIBackend::comm_type& comm) {
+  std::vector<float> data(count, 1.0f);
+  std::vector<double> latencies;
+  for (size_t trial = 0; trial < num_trials + 1; ++trial) {
+    Al::MPIBackend::req_type req = get_request<Al::MPIBackend>();
+    std::atomic<double> done_time(0.0);
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start = get_time();
+    Al::NonblockingAllreduce<Al::MPIBackend>(
+      data.data(), data.size(), Al::ReductionOperator::sum, comm, req,
+      Al::MPIAllreduceAlgorithm::mpi_recursive_doubling);
+    if (mode == "wait") {
+      Al::Wait<Al::MPIBackend>(req);
+      done_time = get_time();
+    } else {
+      Al::OnComplete<Al::MPIBackend>(
+        req, [&done_time] () { done_time = get_time(); });
+      while (done_time.load() == 0.0) {
+        std::this_thread::yield();
+      }
+    }
+    latencies.push_back(done_time.load() - start);
+  }
+  // Delete warmup trial.
+  latencies.erase(latencies.begin());
+  if (comm.rank() == 0) {
+    std::cout << "mode=" << mode << " count=" << count << " ";
+    print_stats(latencies);
+  }
+}
+
+int main(int argc, char** argv) {
+  Al::Initialize(argc, argv);
+  size_t count = 1;
+  if (argc == 2) {
+    count = std::stoul(argv[1]);
+  }
+  Al::MPIBackend::comm_type comm(MPI_COMM_WORLD);
+  time_completion("wait", count, comm);
+  time_completion("callback", count, comm);
+  {
+    ThreadExecutor executor;
+    Al::SetCompletionExecutor([&executor] (Al::CompletionCallback callback) {
+        executor.submit(std::move(callback));
+      });
+    time_completion("executor", count, comm);
+    Al::SetCompletionExecutor(Al::CompletionExecutor());
+  }
+  Al::Finalize();
+  return 0;
+}
@@ -0,0 +1,128 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.  Produced at the
+// Lawrence Livermore National Laboratory in collaboration with University of
+// Illinois Urbana-Champaign.
+//
+// Written by the LBANN Research Team (N. Dryden, N. Maruyama, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-756777.
+// All rights reserved.
+//
+// This file is part of Aluminum GPU-aware Communication Library. For details, see
+// http://software.llnl.gov/Aluminum or https://github.com/LLNL/Aluminum.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include "Al.hpp"
+#include "test_utils.hpp"
+
+const size_t num_trials = 10;
+const size_t ops_per_thread = 100000;
+const std::vector<size_t> thread_counts = {1, 2, 4, 8};
+
+/** Trivial operation that completes on its first step. */
+class NoopState : public Al::internal::AlState {
+ public:
+  NoopState(std::atomic<size_t>& completed_, void* stream_) :
+    AlState(Al::internal::NULL_REQUEST), completed(completed_),
+    stream(stream_) {}
+  Al::internal::PEAction step() override {
+    completed.fetch_add(1, std::memory_order_release);
+    return Al::internal::PEAction::complete;
+  }
+  bool needs_completion() const override { return false; }
+  void* get_compute_stream() const override { return stream; }
+  Al::internal::RunType get_run_type() const override {
+    return Al::internal::RunType::unbounded;
+  }
+  std::string get_name() const override { return "Noop"; }
+ private:
+  std::atomic<size_t>& completed;
+  void* stream;
+};
+
+/**
+ * Have each producer thread enqueue ops_per_thread operations, either all
+ * onto the default stream or each onto its own stream.
+ * Return the aggregate enqueue rate in operations per second.
+ */
+double time_enqueue(size_t num_threads, bool shared_stream) {
+  Al::internal::ProgressEngine* pe = Al::internal::get_progress_engine();
+  // Keep the number of in-flight ops within the input queue capacity.
+  const size_t max_in_flight = AL_PE_INPUT_QUEUE_SIZE / 2 / num_threads;
+  std::vector<std::atomic<size_t>> completed(num_threads);
+  std::vector<double> times(num_threads);
+  std::atomic<size_t> ready(0);
+  std::vector<std::thread> producers;
+  for (size_t t = 0; t < num_threads; ++t) {
+    completed[t] = 0;
+    producers.emplace_back([&, t] () {
+        void* stream = shared_stream ? Al::internal::DEFAULT_STREAM
+          : reinterpret_cast<void*>(t + 1);
+        ++ready;
+        while (ready.load() != num_threads) {
+          std::this_thread::yield();
+        }
+        double start = get_time();
+        for (size_t i = 0; i < ops_per_thread; ++i) {
+          while (i - completed[t].load(std::memory_order_acquire)
+                 >= max_in_flight) {
+            std::this_thread::yield();
+          }
+          pe->enqueue(new NoopState(completed[t], stream));
+        }
+        times[t] = get_time() - start;
+        while (completed[t].load() != ops_per_thread) {
+          std::this_thread::yield();
+        }
+        if (!shared_stream) {
+          pe->retire_stream(stream);
+        }
+      });
+  }
+  for (auto&& producer : producers) {
+    producer.join();
+  }
+  double max_time = *std::max_element(times.begin(), times.end());
+  return num_threads * ops_per_thread / max_time;
+}
+
+int main(int argc, char** argv) {
+  Al::Initialize(argc, argv);
+  Al::MPIBackend::comm_type comm(MPI_COMM_WORLD);
+  for (const bool shared_stream : {true, false}) {
+    for (const auto& num_threads : thread_counts) {
+      std::vector<double> rates;
+      for (size_t trial = 0; trial < num_trials + 1; ++trial) {
+        rates.push_back(time_enqueue(num_threads, shared_stream));
+      }
+      // Delete warmup trial.
+      rates.erase(rates.begin());
+      if (comm.rank() == 0) {
+        std::cout << (shared_stream ? "shared" : "per-thread")
+                  << " streams, " << num_threads << " producers ops/s ";
+        print_stats(rates);
+      }
+    }
+  }
+  Al::Finalize();
+  return 0;
+}
@@ -0,0 +1,82 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.  Produced at the
+// Lawrence Livermore National Laboratory in collaboration with University of
+// Illinois Urbana-Champaign.
+//
+// Written by the LBANN Research Team (N. Dryden, N. Maruyama, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-756777.
+// All rights reserved.
+//
+// This file is part of Aluminum GPU-aware Communication Library. For details, see
+// http://software.llnl.gov/Aluminum or https://github.com/LLNL/Aluminum.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <algorithm>
+#include "Al.hpp"
+#include "test_utils.hpp"
+
+const size_t num_trials = 1000;
+
+/**
+ * Time from starting a small allreduce to Wait returning, with the operation
+ * run by the progress engine or by the caller.
+ */
+void time_mode(Al::ProgressMode mode, size_t count,
+               Al::MPIBackend::comm_type& comm) {
+  std::vector<float> data(count, 1.0f);
+  std::vector<double> latencies;
+  for (size_t trial = 0; trial < num_trials + 1; ++trial) {
+    MPI_Barrier(MPI_COMM_WORLD);
+    Al::MPIBackend::req_type req = get_request<Al::MPIBackend>();
+    double start = get_time();
+    Al::NonblockingAllreduce<Al::MPIBackend>(
+      data.data(), data.size(), Al::ReductionOperator::sum, comm, req,
+      Al::MPIAllreduceAlgorithm::mpi_recursive_doubling,
+      Al::OpPriority::normal, mode);
+    Al::Wait<Al::MPIBackend>(req);
+    latencies.push_back(get_time() - start);
+  }
+  // Delete warmup trial.
+  latencies.erase(latencies.begin());
+  if (comm.rank() == 0) {
+    const char* name = mode == Al::ProgressMode::caller ? "caller" : "engine";
+    std::cout << "mode=" << name << " count=" << count << " ";
+    print_stats(latencies);
+    std::cout << "mode=" << name << " count=" << count
+              << " p50=" << percentile(latencies, 0.5)
+              << " p90=" << percentile(latencies, 0.9)
+              << " p99=" << percentile(latencies, 0.99) << std::endl;
+  }
+}
+
+int main(int argc, char** argv) {
+  Al::Initialize(argc, argv);
+  size_t max_count = 256;
+  if (argc == 2) {
+    max_count = std::stoul(argv[1]);
+  }
+  Al::MPIBackend::comm_type comm(MPI_COMM_WORLD);
+  for (size_t count = 1; count <= max_count; count *= 16) {
+    for (const auto& mode : {Al::ProgressMode::engine,
+                             Al::ProgressMode::caller}) {
+      time_mode(mode, count, comm);
+    }
+  }
+  Al::Finalize();
+  return 0;
+}
@@ -0,0 +1,253 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.  Produced at the
+// Lawrence Livermore National Laboratory in collaboration with University of
+// Illinois Urbana-Champaign.
+//
+// Written by the LBANN Research Team (N. Dryden, N. Maruyama, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-756777.
+// All rights reserved.
+//
+// This file is part of Aluminum GPU-aware Communication Library. For details, see
+// http://software.llnl.gov/Aluminum or https://github.com/LLNL/Aluminum.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Al.hpp"
+#include "test_utils.hpp"
+
+const size_t num_ops = 100000;
+/**
+ * Operations and largest count for the mixed-size pattern. These are kept
+ * small since the baseline keeps a buffer for almost every count it sees.
+ */
+const size_t num_mixed_ops = 10000;
+const size_t max_mixed_count = 1<<16;
+/** Number of buffers live at once in the mixed-size pattern. */
+const size_t num_live = 8;
+/** Elements per buffer in the multi-threaded patterns. */
+const size_t thread_count = 4096;
+
+/**
+ * The previous memory pool, kept as a baseline: one pool per type, with a
+ * list of buffers per exact element count.
+ */
+template <typename T>
+struct ExactSizeMempool {
+  std::unordered_map<size_t, std::vector<std::pair<T*, bool>>> memmap;
+  std::unordered_map<T*, size_t> allocated;
+  std::mutex lock;
+  T* get(size_t count) {
+    std::lock_guard<std::mutex> l(lock);
+    for (auto&& entry : memmap[count]) {
+      if (!entry.second) {
+        entry.second = true;
+        allocated[entry.first] = count;
+        return entry.first;
+      }
+    }
+    T* mem = new T[count];
+    memmap[count].emplace_back(mem, true);
+    allocated[mem] = count;
+    return mem;
+  }
+  void release(T* mem) {
+    std::lock_guard<std::mutex> l(lock);
+    size_t count = allocated[mem];
+    for (auto&& entry : memmap[count]) {
+      if (entry.first == mem) {
+        entry.second = false;
+        return;
+      }
+    }
+  }
+  /** Return the number of buffers the pool holds. */
+  size_t num_buffers() const {
+    size_t n = 0;
+    for (const auto& size_list : memmap) {
+      n += size_list.second.size();
+    }
+    return n;
+  }
+};
+
+/** Adapts the library's pool to the same interface. */
+template <typename T>
+struct SizeClassPool {
+  T* get(size_t count) { return Al::internal::get_memory<T>(count); }
+  void release(T* mem) { Al::internal::release_memory(mem); }
+};
+
+/** Time get/release pairs of one size; return seconds per pair. */
+template <typename Pool>
+double time_fixed(Pool& pool, size_t count) {
+  // Warm up so the buffer exists.
+  pool.release(pool.get(count));
+  double start = get_time();
+  for (size_t i = 0; i < num_ops; ++i) {
+    pool.release(pool.get(count));
+  }
+  return (get_time() - start) / num_ops;
+}
+
+/**
+ * Time replacing random buffers among num_live live ones with buffers of a
+ * random size in [1, max_count]; return seconds per get/release pair.
+ */
+template <typename Pool>
+double time_mixed(Pool& pool, size_t max_count) {
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<size_t> count_dist(1, max_count);
+  std::uniform_int_distribution<size_t> slot_dist(0, num_live - 1);
+  std::vector<float*> live(num_live);
+  for (auto&& buf : live) {
+    buf = pool.get(count_dist(gen));
+  }
+  double start = get_time();
+  for (size_t i = 0; i < num_mixed_ops; ++i) {
+    const size_t slot = slot_dist(gen);
+    pool.release(live[slot]);
+    live[slot] = pool.get(count_dist(gen));
+  }
+  double t = (get_time() - start) / num_mixed_ops;
+  for (auto&& buf : live) {
+    pool.release(buf);
+  }
+  return t;
+}
+
+/**
+ * Time num_threads threads each doing get/release pairs concurrently; return
+ * seconds per pair per thread.
+ */
+template <typename Pool>
+double time_threads(Pool& pool, size_t num_threads) {
+  std::atomic<bool> go(false);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&pool, &go] () {
+        while (!go.load()) {}
+        for (size_t i = 0; i < num_ops; ++i) {
+          pool.release(pool.get(thread_count));
+        }
+      });
+  }
+  double start = get_time();
+  go = true;
+  for (auto&& thread : threads) {
+    thread.join();
+  }
+  return (get_time() - start) / num_ops;
+}
+
+/**
+ * Time one thread getting buffers and handing them to another that releases
+ * them, as a user thread and the progress engine do; return seconds per
+ * buffer.
+ */
+template <typename Pool>
+double time_handoff(Pool& pool) {
+  // Single-producer, single-consumer ring of buffers in flight.
+  constexpr size_t ring_size = 64;
+  std::vector<std::atomic<float*>> ring(ring_size);
+  for (auto&& slot : ring) {
+    slot = nullptr;
+  }
+  std::thread consumer([&pool, &ring] () {
+      for (size_t i = 0; i < num_ops; ++i) {
+        std::atomic<float*>& slot = ring[i % ring_size];
+        float* buf;
+        while ((buf = slot.exchange(nullptr)) == nullptr) {
+          std::this_thread::yield();
+        }
+        pool.release(buf);
+      }
+    });
+  double start = get_time();
+  for (size_t i = 0; i < num_ops; ++i) {
+    float* buf = pool.get(thread_count);
+    std::atomic<float*>& slot = ring[i % ring_size];
+    while (slot.load() != nullptr) {
+      std::this_thread::yield();
+    }
+    slot = buf;
+  }
+  consumer.join();
+  return (get_time() - start) / num_ops;
+}
+
+int main(int argc, char** argv) {
+  Al::Initialize(argc, argv);
+  size_t max_count = 1<<20;
+  if (argc == 2) {
+    max_count = std::stoul(argv[1]);
+  }
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  // Each rank runs independently; only rank 0 reports.
+  ExactSizeMempool<float> exact_pool;
+  SizeClassPool<float> class_pool;
+  for (size_t count = 1; count <= max_count; count *= 16) {
+    const double exact_time = time_fixed(exact_pool, count);
+    const double class_time = time_fixed(class_pool, count);
+    if (rank == 0) {
+      std::cout << "fixed count=" << count
+                << " exact=" << exact_time*1e9 << "ns"
+                << " size-class=" << class_time*1e9 << "ns" << std::endl;
+    }
+  }
+  ExactSizeMempool<float> mixed_exact_pool;
+  const size_t mixed_count = std::min(max_count, max_mixed_count);
+  const double exact_time = time_mixed(mixed_exact_pool, mixed_count);
+  const double class_time = time_mixed(class_pool, mixed_count);
+  if (rank == 0) {
+    std::cout << "mixed max_count=" << mixed_count
+              << " exact=" << exact_time*1e9 << "ns"
+              << " (" << mixed_exact_pool.num_buffers() << " buffers)"
+              << " size-class=" << class_time*1e9 << "ns" << std::endl;
+  }
+  // Contention between threads.
+  const size_t max_threads = std::max<size_t>(
+    2, std::min<size_t>(8, std::thread::hardware_concurrency()));
+  for (size_t num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+    const double exact_time = time_threads(exact_pool, num_threads);
+    const double class_time = time_threads(class_pool, num_threads);
+    if (rank == 0) {
+      std::cout << "threads=" << num_threads
+                << " exact=" << exact_time*1e9 << "ns"
+                << " size-class=" << class_time*1e9 << "ns" << std::endl;
+    }
+  }
+  {
+    const double exact_time = time_handoff(exact_pool);
+    const double class_time = time_handoff(class_pool);
+    if (rank == 0) {
+      std::cout << "handoff"
+                << " exact=" << exact_time*1e9 << "ns"
+                << " size-class=" << class_time*1e9 << "ns" << std::endl;
+    }
+  }
+  Al::Finalize();
+  return 0;
+}
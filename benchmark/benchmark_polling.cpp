@@ -0,0 +1,94 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.  Produced at the
+// Lawrence Livermore National Laboratory in collaboration with University of
+// Illinois Urbana-Champaign.
+//
+// Written by the LBANN Research Team (N. Dryden, N. Maruyama, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-756777.
+// All rights reserved.
+//
+// This file is part of Aluminum GPU-aware Communication Library. For details, see
+// http://software.llnl.gov/Aluminum or https://github.com/LLNL/Aluminum.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <cstdlib>
+#include <thread>
+#include "Al.hpp"
+#include "test_utils.hpp"
+
+const size_t num_trials = 10;
+const std::vector<size_t> num_ops = {1, 8, 64};
+// How long rank 0 measures while the other ranks hold the operations open.
+const double window = 0.05;
+
+/**
+ * Measure the progress engine's time per busy iteration on rank 0 while
+ * num_concurrent operations are waiting on the other ranks.
+ */
+void time_polling(bool aggregate, size_t num_concurrent,
+                  Al::MPIBackend::comm_type& comm) {
+  Al::internal::ProgressEngine* pe = Al::internal::get_progress_engine();
+  pe->set_aggregate_mpi_polling(aggregate);
+  std::vector<std::vector<float>> data(num_concurrent,
+                                       std::vector<float>(1, 1.0f));
+  std::vector<Al::MPIBackend::req_type> reqs(num_concurrent);
+  std::vector<double> iter_times;
+  for (size_t trial = 0; trial < num_trials + 1; ++trial) {
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (comm.rank() != 0) {
+      // Join late so rank 0's operations stay in flight.
+      std::this_thread::sleep_for(std::chrono::duration<double>(2*window));
+    }
+    for (size_t i = 0; i < num_concurrent; ++i) {
+      Al::NonblockingAllreduce<Al::MPIBackend>(
+        data[i].data(), data[i].size(), Al::ReductionOperator::sum, comm,
+        reqs[i], Al::MPIAllreduceAlgorithm::mpi_recursive_doubling);
+    }
+    if (comm.rank() == 0) {
+      Al::internal::ProgressEngineStats start_stats = pe->get_stats();
+      double start = get_time();
+      std::this_thread::sleep_for(std::chrono::duration<double>(window));
+      Al::internal::ProgressEngineStats end_stats = pe->get_stats();
+      double elapsed = get_time() - start;
+      iter_times.push_back(
+        elapsed / (end_stats.busy_iterations - start_stats.busy_iterations));
+    }
+    Al::WaitAll<Al::MPIBackend>(num_concurrent, reqs.data());
+  }
+  if (comm.rank() == 0) {
+    // Delete warmup trial.
+    iter_times.erase(iter_times.begin());
+    std::cout << "aggregate=" << aggregate << " ops=" << num_concurrent
+              << " iteration ";
+    print_stats(iter_times);
+  }
+}
+
+int main(int argc, char** argv) {
+  // Let all the operations run at once.
+  setenv("AL_PE_NUM_CONCURRENT_SMALL_OPS", "64", 0);
+  Al::Initialize(argc, argv);
+  Al::MPIBackend::comm_type comm(MPI_COMM_WORLD);
+  for (const auto& aggregate : {false, true}) {
+    for (const auto& n : num_ops) {
+      time_polling(aggregate, n, comm);
+    }
+  }
+  Al::Finalize();
+  return 0;
+}
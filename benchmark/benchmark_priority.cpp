@@ -0,0 +1,97 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.  Produced at the
+// Lawrence Livermore National Laboratory in collaboration with University of
+// Illinois Urbana-Champaign.
+//
+// Written by the LBANN Research Team (N. Dryden, N. Maruyama, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-756777.
+// All rights reserved.
+//
+// This file is part of Aluminum GPU-aware Communication Library. For details, see
+// http://software.llnl.gov/Aluminum or https://github.com/LLNL/Aluminum.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <algorithm>
+#include "Al.hpp"
+#include "test_utils.hpp"
+
+const size_t num_trials = 20;
+
+/**
+ * Time a one-element allreduce with the given priority while num_background
+ * large allreduces are in progress.
+ */
+void time_priority(Al::OpPriority priority, size_t num_background,
+                   size_t background_count,
+                   Al::MPIBackend::comm_type& comm) {
+  std::vector<std::vector<float>> background(
+    num_background, std::vector<float>(background_count, 1.0f));
+  std::vector<Al::MPIBackend::req_type> background_reqs(num_background);
+  std::vector<float> small(1, 1.0f);
+  std::vector<double> latencies;
+  for (size_t trial = 0; trial < num_trials + 1; ++trial) {
+    MPI_Barrier(MPI_COMM_WORLD);
+    for (size_t i = 0; i < num_background; ++i) {
+      background_reqs[i] = get_request<Al::MPIBackend>();
+      Al::NonblockingAllreduce<Al::MPIBackend>(
+        background[i].data(), background_count, Al::ReductionOperator::sum,
+        comm, background_reqs[i], Al::MPIAllreduceAlgorithm::mpi_ring);
+    }
+    Al::MPIBackend::req_type req = get_request<Al::MPIBackend>();
+    double start = get_time();
+    Al::NonblockingAllreduce<Al::MPIBackend>(
+      small.data(), small.size(), Al::ReductionOperator::sum, comm, req,
+      Al::MPIAllreduceAlgorithm::mpi_recursive_doubling, priority);
+    Al::Wait<Al::MPIBackend>(req);
+    latencies.push_back(get_time() - start);
+    for (auto& background_req : background_reqs) {
+      Al::Wait<Al::MPIBackend>(background_req);
+    }
+  }
+  // Delete warmup trial.
+  latencies.erase(latencies.begin());
+  if (comm.rank() == 0) {
+    std::cout << "priority="
+              << (priority == Al::OpPriority::high ? "high" : "normal")
+              << " background_count=" << background_count << " ";
+    print_stats(latencies);
+    std::cout << "priority="
+              << (priority == Al::OpPriority::high ? "high" : "normal")
+              << " p50=" << percentile(latencies, 0.5)
+              << " p90=" << percentile(latencies, 0.9)
+              << " p99=" << percentile(latencies, 0.99) << std::endl;
+  }
+}
+
+int main(int argc, char** argv) {
+  Al::Initialize(argc, argv);
+  size_t background_count = 1<<20;
+  if (argc == 2) {
+    background_count = std::stoul(argv[1]);
+  }
+  Al::MPIBackend::comm_type comm(MPI_COMM_WORLD);
+  // Run more large allreduces than the engine's concurrency slots, which may
+  // be set at runtime, so some are left queued.
+  const size_t num_background =
+    Al::internal::get_progress_engine()->get_max_concurrent_ops() + 2;
+  for (const auto& priority : {Al::OpPriority::normal, Al::OpPriority::high}) {
+    time_priority(priority, num_background, background_count, comm);
+  }
+  Al::Finalize();
+  return 0;
+}
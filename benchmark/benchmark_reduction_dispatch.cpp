@@ -0,0 +1,108 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.  Produced at the
+// Lawrence Livermore National Laboratory in collaboration with University of
+// Illinois Urbana-Champaign.
+//
+// Written by the LBANN Research Team (N. Dryden, N. Maruyama, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-756777.
+// All rights reserved.
+//
+// This file is part of Aluminum GPU-aware Communication Library. For details, see
+// http://software.llnl.gov/Aluminum or https://github.com/LLNL/Aluminum.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <functional>
+#include <algorithm>
+#include <string>
+#include "test_utils.hpp"
+#include "reduction_kernels.hpp"
+
+/** Calls per timed trial and number of trials. */
+size_t num_calls = 1<<20;
+const size_t num_trials = 10;
+
+/** Inlined sum loop, the lower bound for a call. */
+void inline_sum(const float* src, float* dest, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    dest[i] += src[i];
+  }
+}
+
+/**
+ * Return the best time in ns of one call of reduce on count elements,
+ * calling it num_calls times per trial.
+ */
+template <typename F>
+double time_calls(F& reduce, size_t count) {
+  std::vector<float> src(count, 0.0f), dest(count, 1.0f);
+  double best = 0.0;
+  for (size_t trial = 0; trial < num_trials + 1; ++trial) {
+    double start = get_time();
+    for (size_t call = 0; call < num_calls; ++call) {
+      reduce(src.data(), dest.data(), count);
+    }
+    const double t = (get_time() - start) / num_calls * 1e9;
+    if (trial == 1 || (trial > 1 && t < best)) {  // Skip warmup.
+      best = t;
+    }
+  }
+  return best;
+}
+
+/**
+ * Time calls of a sum on count floats through the ways reductions have been
+ * dispatched: an inlined loop, a kernel pointer from the kernel table, the
+ * same pointer wrapped in a std::function, and a lookup in the table on
+ * every call.
+ */
+void time_dispatch(size_t count) {
+  const auto level = Al::internal::get_supported_simd_level();
+  auto inlined = [](const float* src, float* dest, size_t n) {
+    inline_sum(src, dest, n);
+  };
+  Al::internal::ReductionKernel<float> pointer =
+    Al::internal::get_reduction_kernel<float>(Al::ReductionOperator::sum,
+                                              level);
+  std::function<void(const float*, float*, size_t)> function = pointer;
+  auto lookup = [level](const float* src, float* dest, size_t n) {
+    Al::internal::get_reduction_kernel<float>(
+      Al::ReductionOperator::sum, level)(src, dest, n);
+  };
+  std::cout << "count=" << count
+            << " inline ns=" << time_calls(inlined, count)
+            << " pointer ns=" << time_calls(pointer, count)
+            << " function ns=" << time_calls(function, count)
+            << " lookup ns=" << time_calls(lookup, count) << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  size_t max_count = 256;
+  if (argc >= 2) {
+    max_count = std::stoul(argv[1]);
+  }
+  if (argc >= 3) {
+    num_calls = std::stoul(argv[2]);
+  }
+  std::cout << "level="
+            << Al::internal::simd_level_name(
+              Al::internal::get_supported_simd_level()) << std::endl;
+  for (size_t count = 1; count <= max_count; count *= 2) {
+    time_dispatch(count);
+  }
+  return 0;
+}
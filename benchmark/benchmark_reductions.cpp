@@ -28,11 +28,25 @@
 #include <iostream>
 #include <functional>
 #include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <thread>
 #include <mpi.h>
 #include "test_utils.hpp"
+#include "reduction_kernels.hpp"
 
-const size_t max_size = 1<<30;
+size_t max_size = 1<<30;
 const size_t num_trials = 100;
+/** Largest count and number of trials for timing the library's kernels. */
+size_t max_kernel_size = 1<<24;
+const size_t num_kernel_trials = 20;
+/**
+ * Bytes the kernel run alongside streaming reductions works on: more than a
+ * core's private caches, but within a shared last-level cache.
+ */
+const size_t compute_working_set = 8<<20;
 
 template <typename T>
 void sum_reduction(const T* src, T* dest, size_t count) {
@@ -140,12 +154,150 @@ void time_reduction(
   print_stats(multi_times);
 }
 
-int main(int, char*[]) {
+/**
+ * Return the best memory bandwidth, in GB/s, of copying count floats with
+ * memcpy, as in STREAM Copy. This bounds what kernels can reach once data no
+ * longer fits in cache.
+ */
+double copy_bandwidth(size_t count) {
+  std::vector<float> src(count, 1.0f), dest(count);
+  double best = 0.0;
+  for (size_t trial = 0; trial < num_kernel_trials + 1; ++trial) {
+    double start = get_time();
+    std::memcpy(dest.data(), src.data(), count * sizeof(float));
+    const double t = get_time() - start;
+    if (trial > 0) {  // Skip warmup.
+      best = std::max(best, 2.0 * count * sizeof(float) / t / 1e9);
+    }
+  }
+  return best;
+}
+
+/**
+ * Time the library's kernel for op on T at every level the CPU supports and
+ * report the best GB/s, counting the two reads and one write per element,
+ * against ceiling.
+ */
+template <typename T>
+void time_kernels(size_t count, Al::ReductionOperator op,
+                  const std::string& type_name, const std::string& op_name,
+                  double ceiling) {
+  std::vector<T> src(count), init(count), dest(count);
+  for (size_t i = 0; i < count; ++i) {
+    // Keep products from overflowing or going denormal.
+    src[i] = static_cast<T>(1 + i % 3);
+    init[i] = static_cast<T>(1 + i % 5);
+  }
+  const auto max_level =
+    static_cast<size_t>(Al::internal::get_supported_simd_level());
+  for (size_t level = 0; level <= max_level; ++level) {
+    const auto simd_level = static_cast<Al::internal::SIMDLevel>(level);
+    auto kernel = Al::internal::get_reduction_kernel<T>(op, simd_level);
+    double best = 0.0;
+    for (size_t trial = 0; trial < num_kernel_trials + 1; ++trial) {
+      dest = init;
+      double start = get_time();
+      kernel(src.data(), dest.data(), count);
+      const double t = get_time() - start;
+      if (trial > 0) {  // Skip warmup.
+        best = std::max(best, 3.0 * count * sizeof(T) / t / 1e9);
+      }
+    }
+    std::cout << "size=" << count << " type=" << type_name
+              << " algo=" << op_name
+              << " level=" << Al::internal::simd_level_name(simd_level)
+              << " GB/s=" << best
+              << " ceiling=" << 100.0 * best / ceiling << "%" << std::endl;
+  }
+}
+
+/**
+ * Time float sums of count elements with the library's kernel at the best
+ * level, with results written normally and streamed, while another thread
+ * repeatedly updates compute_working_set bytes. Report the reduction's best
+ * GB/s and the other thread's GB/s, which drops as reductions evict its data.
+ */
+void time_streaming(size_t count) {
+  std::vector<float> src(count, 1.0f), dest(count, 0.0f);
+  auto kernel = Al::internal::get_reduction_kernel<float>(
+    Al::ReductionOperator::sum, Al::internal::get_supported_simd_level());
+  const size_t saved_min_bytes = Al::internal::get_streaming_min_bytes();
+  for (const bool stream : {false, true}) {
+    Al::internal::set_streaming_min_bytes(
+      stream ? 0 : std::numeric_limits<size_t>::max());
+    std::atomic<bool> done(false);
+    double compute_bandwidth = 0.0;
+    std::thread compute([&] () {
+      std::vector<float> data(compute_working_set / sizeof(float), 1.0f);
+      size_t passes = 0;
+      double start = 0.0;
+      while (!done.load(std::memory_order_relaxed)) {
+        for (auto& x : data) {
+          x = x * 0.5f + 1.0f;
+        }
+        if (passes++ == 0) {  // Skip warmup.
+          start = get_time();
+        }
+      }
+      if (passes > 1) {
+        compute_bandwidth = 2.0 * (passes - 1) * compute_working_set
+          / (get_time() - start) / 1e9;
+      }
+    });
+    double best = 0.0;
+    for (size_t trial = 0; trial < num_kernel_trials + 1; ++trial) {
+      double start = get_time();
+      kernel(src.data(), dest.data(), count);
+      const double t = get_time() - start;
+      if (trial > 0) {  // Skip warmup.
+        best = std::max(best, 3.0 * count * sizeof(float) / t / 1e9);
+      }
+    }
+    done = true;
+    compute.join();
+    std::cout << "size=" << count << " type=float algo=sum"
+              << " stores=" << (stream ? "streaming" : "normal")
+              << " GB/s=" << best
+              << " corunning GB/s=" << compute_bandwidth << std::endl;
+  }
+  Al::internal::set_streaming_min_bytes(saved_min_bytes);
+}
+
+int main(int argc, char* argv[]) {
+  if (argc >= 2) {
+    max_size = std::stoul(argv[1]);
+    max_kernel_size = std::min(max_kernel_size, max_size);
+  }
   for (size_t size = 1; size <= max_size; size *= 2) {
     time_reduction(size, sum_reduction<float>, mt_sum_reduction<float>, "sum");
     time_reduction(size, prod_reduction<float>, mt_prod_reduction<float>, "prod");
     time_reduction(size, min_reduction<float>, mt_min_reduction<float>, "min");
     time_reduction(size, max_reduction<float>, mt_max_reduction<float>, "max");
   }
+  // The library's kernels, by instruction set.
+  for (size_t size = 1024; size <= max_kernel_size; size *= 4) {
+    const double ceiling = copy_bandwidth(size);
+    std::cout << "size=" << size << " copy GB/s=" << ceiling << std::endl;
+    time_kernels<float>(size, Al::ReductionOperator::sum, "float", "sum",
+                        ceiling);
+    time_kernels<float>(size, Al::ReductionOperator::prod, "float", "prod",
+                        ceiling);
+    time_kernels<float>(size, Al::ReductionOperator::min, "float", "min",
+                        ceiling);
+    time_kernels<float>(size, Al::ReductionOperator::max, "float", "max",
+                        ceiling);
+    time_kernels<double>(size, Al::ReductionOperator::sum, "double", "sum",
+                         ceiling);
+    time_kernels<int>(size, Al::ReductionOperator::sum, "int", "sum",
+                      ceiling);
+    time_kernels<int>(size, Al::ReductionOperator::bor, "int", "bor",
+                      ceiling);
+    time_kernels<int>(size, Al::ReductionOperator::lor, "int", "lor",
+                      ceiling);
+  }
+  // Streaming stores for reductions too large to stay in cache.
+  for (size_t size = 1<<20; size <= max_kernel_size; size *= 4) {
+    time_streaming(size);
+  }
   return 0;
 }
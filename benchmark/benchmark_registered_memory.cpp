@@ -0,0 +1,109 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.  Produced at the
+// Lawrence Livermore National Laboratory in collaboration with University of
+// Illinois Urbana-Champaign.
+//
+// Written by the LBANN Research Team (N. Dryden, N. Maruyama, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-756777.
+// All rights reserved.
+//
+// This file is part of Aluminum GPU-aware Communication Library. For details, see
+// http://software.llnl.gov/Aluminum or https://github.com/LLNL/Aluminum.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Al.hpp"
+#include "test_utils.hpp"
+
+const size_t num_trials = 20;
+
+/**
+ * Time ring allreduces of count floats from buf into recvbuf; return the
+ * mean seconds per allreduce. Scratch buffers come from MPI_Alloc_mem memory
+ * if registered_scratch is true.
+ */
+double time_ring(float* buf, float* recvbuf, size_t count,
+                 Al::MPIBackend::comm_type& comm, bool registered_scratch) {
+  Al::internal::use_mpi_mempool = registered_scratch;
+  double total = 0.0;
+  for (size_t trial = 0; trial < num_trials + 1; ++trial) {
+    MPI_Barrier(MPI_COMM_WORLD);
+    const double start = get_time();
+    Al::Allreduce<Al::MPIBackend>(buf, recvbuf, count,
+                                  Al::ReductionOperator::sum, comm,
+                                  Al::MPIAllreduceAlgorithm::mpi_ring);
+    if (trial > 0) {  // Skip warmup.
+      total += get_time() - start;
+    }
+  }
+  Al::internal::use_mpi_mempool = false;
+  return total / num_trials;
+}
+
+/** Print bandwidth for count floats reduced in t seconds over nprocs. */
+void print_result(const std::string& name, size_t count, int nprocs,
+                  double t) {
+  const double bytes = static_cast<double>(count * sizeof(float));
+  // Bus bandwidth is what each rank sends, independent of nprocs.
+  const double bus_bytes = bytes * 2.0 * (nprocs - 1) / nprocs;
+  std::cout << name << " bytes=" << count * sizeof(float)
+            << " time=" << t * 1e6 << "us"
+            << " algbw=" << bytes / t / 1e9 << "GB/s"
+            << " busbw=" << bus_bytes / t / 1e9 << "GB/s" << std::endl;
+}
+
+int main(int argc, char** argv) {
+  Al::Initialize(argc, argv);
+  size_t start_size = 1<<20;
+  size_t max_size = 1<<26;
+  if (argc >= 2) {
+    start_size = std::stoul(argv[1]);
+    max_size = start_size;
+  }
+  if (argc >= 3) {
+    max_size = std::stoul(argv[2]);
+  }
+  Al::MPIBackend::comm_type comm;  // Use COMM_WORLD.
+  for (size_t count = start_size; count <= max_size; count *= 4) {
+    // Plain buffers with plain scratch, plain buffers with registered scratch,
+    // and registered buffers with registered scratch.
+    std::vector<float> buf(count, 1.0f), recvbuf(count);
+    float* reg_buf = static_cast<float*>(
+      Al::AllocateRegisteredMemory(count * sizeof(float)));
+    float* reg_recvbuf = static_cast<float*>(
+      Al::AllocateRegisteredMemory(count * sizeof(float)));
+    std::fill(reg_buf, reg_buf + count, 1.0f);
+    const double plain_time = time_ring(buf.data(), recvbuf.data(), count,
+                                        comm, false);
+    const double scratch_time = time_ring(buf.data(), recvbuf.data(), count,
+                                          comm, true);
+    const double reg_time = time_ring(reg_buf, reg_recvbuf, count, comm, true);
+    Al::ReleaseRegisteredMemory(reg_buf);
+    Al::ReleaseRegisteredMemory(reg_recvbuf);
+    if (comm.rank() == 0) {
+      print_result("plain", count, comm.size(), plain_time);
+      print_result("registered-scratch", count, comm.size(), scratch_time);
+      print_result("registered", count, comm.size(), reg_time);
+    }
+  }
+  Al::Finalize();
+  return 0;
+}
@@ -0,0 +1,118 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.  Produced at the
+// Lawrence Livermore National Laboratory in collaboration with University of
+// Illinois Urbana-Champaign.
+//
+// Written by the LBANN Research Team (N. Dryden, N. Maruyama, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-756777.
+// All rights reserved.
+//
+// This file is part of Aluminum GPU-aware Communication Library. For details, see
+// http://software.llnl.gov/Aluminum or https://github.com/LLNL/Aluminum.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+#include <thread>
+#include <time.h>
+#include "Al.hpp"
+#include "test_utils.hpp"
+
+const size_t num_trials = 20;
+// Delays (in seconds) before non-root ranks join the allreduce.
+const std::vector<double> delays = {0.0, 0.0001, 0.001, 0.01};
+
+/** Return the CPU time used by the calling thread, in seconds. */
+double get_thread_cpu_time() {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+std::string policy_name(Al::internal::WaitPolicy policy) {
+  switch (policy) {
+  case Al::internal::WaitPolicy::spin:
+    return "spin";
+  case Al::internal::WaitPolicy::spin_yield:
+    return "yield";
+  case Al::internal::WaitPolicy::spin_block:
+    return "block";
+  default:
+    return "unknown";
+  }
+}
+
+/**
+ * Time Wait on rank 0 while the other ranks join the allreduce late.
+ * The wake-up latency is the time Wait takes beyond the delay.
+ */
+void time_wait_policy(Al::internal::WaitPolicy policy, double delay,
+                      Al::MPIBackend::comm_type& comm) {
+  std::vector<double> latencies, cpu_times;
+  std::vector<float> data(1);
+  for (size_t trial = 0; trial < num_trials + 1; ++trial) {
+    Al::MPIBackend::req_type req = get_request<Al::MPIBackend>();
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (comm.rank() == 0) {
+      double start = get_time();
+      Al::NonblockingAllreduce<Al::MPIBackend>(
+        data.data(), data.size(), Al::ReductionOperator::sum, comm, req,
+        Al::MPIAllreduceAlgorithm::mpi_recursive_doubling);
+      double cpu_start = get_thread_cpu_time();
+      Al::Wait<Al::MPIBackend>(req);
+      cpu_times.push_back(get_thread_cpu_time() - cpu_start);
+      latencies.push_back(get_time() - start - delay);
+    } else {
+      std::this_thread::sleep_for(std::chrono::duration<double>(delay));
+      Al::NonblockingAllreduce<Al::MPIBackend>(
+        data.data(), data.size(), Al::ReductionOperator::sum, comm, req,
+        Al::MPIAllreduceAlgorithm::mpi_recursive_doubling);
+      Al::Wait<Al::MPIBackend>(req);
+    }
+  }
+  if (comm.rank() == 0) {
+    // Delete warmup trial.
+    latencies.erase(latencies.begin());
+    cpu_times.erase(cpu_times.begin());
+    std::cout << "policy=" << policy_name(policy) << " delay=" << delay
+              << " wakeup ";
+    print_stats(latencies);
+    std::cout << "policy=" << policy_name(policy) << " delay=" << delay
+              << " cputime ";
+    print_stats(cpu_times);
+  }
+}
+
+int main(int argc, char** argv) {
+  Al::Initialize(argc, argv);
+  size_t spin_iters = AL_PE_WAIT_SPIN_ITERS;
+  if (argc == 2) {
+    spin_iters = std::stoul(argv[1]);
+  }
+  Al::MPIBackend::comm_type comm(MPI_COMM_WORLD);
+  Al::internal::ProgressEngine* pe = Al::internal::get_progress_engine();
+  for (const auto& policy : {Al::internal::WaitPolicy::spin,
+                             Al::internal::WaitPolicy::spin_yield,
+                             Al::internal::WaitPolicy::spin_block}) {
+    pe->set_wait_policy(policy, spin_iters);
+    for (const auto& delay : delays) {
+      time_wait_policy(policy, delay, comm);
+    }
+  }
+  Al::Finalize();
+  return 0;
+}
@@ -35,6 +35,8 @@
 #include "Al.hpp"
 #include "internal.hpp"
 #include "progress.hpp"
+#include "reduction_kernels.hpp"
+#include "reduction_team.hpp"
 #ifdef AL_HAS_CUDA
 #include "cuda.hpp"
 #endif
@@ -114,8 +116,16 @@ void Initialize(int& argc, char**& argv) {
     return;
   }
   internal::mpi::init(argc, argv);
+  internal::init_reduction_kernels();
   progress_engine = new internal::ProgressEngine();
   progress_engine->run();
+  internal::init_arena(progress_engine->get_numa_node());
+  // The reduction team takes the cores below the progress threads'.
+  internal::init_reduction_team(
+    progress_engine->get_numa_node(),
+    progress_engine->get_core()
+    - static_cast<int>(progress_engine->get_num_threads()));
+  internal::init_mpi_mempool();
   is_initialized = true;
 #ifdef AL_HAS_CUDA
   internal::cuda::init(argc, argv);
@@ -157,7 +167,9 @@ void Finalize() {
   progress_engine->stop();
   delete progress_engine;
   progress_engine = nullptr;
+  internal::finalize_reduction_team();
   is_initialized = false;
+  internal::finalize_mpi_mempool();
   internal::mpi::finalize();
   internal::trace::write_trace_to_file();
 }
@@ -166,6 +178,13 @@ bool Initialized() {
   return is_initialized;
 }
 
+void SetCompletionExecutor(CompletionExecutor executor) {
+  if (!is_initialized) {
+    throw_al_exception("Aluminum is not initialized");
+  }
+  progress_engine->set_completion_executor(std::move(executor));
+}
+
 namespace internal {
 
 // Note: This is declared in progress.hpp.
@@ -32,10 +32,12 @@
 #pragma once
 
 #include <iostream>
+#include <vector>
 #include <mpi.h>
 
 #include "Al_config.hpp"
 #include "base.hpp"
+#include "float16.hpp"
 #include "tuning_params.hpp"
 #include "utils.hpp"
 #include "profiling.hpp"
@@ -98,6 +100,43 @@ void Initialize(int& argc, char**& argv);
 void Finalize();
 /** Return true if Aluminum has been initialized. */
 bool Initialized();
+/**
+ * Hand completion callbacks to executor instead of running them on a
+ * progress thread. Pass an empty executor to restore the default.
+ * This should not be called while operations with callbacks are pending.
+ */
+void SetCompletionExecutor(CompletionExecutor executor);
+/**
+ * Return statistics on the host memory pools for temporary buffers, including
+ * the pool of MPI_Alloc_mem memory, combined. peak_bytes_held is the peak of
+ * their total, not the sum of each pool's peak.
+ */
+MemoryStats GetMemoryStats();
+/**
+ * Set a soft limit on the bytes the host memory pools hold together, including
+ * the pool of MPI_Alloc_mem memory, freeing idle memory to meet it; 0 removes
+ * the limit. This overrides AL_MEMPOOL_MAX_BYTES. The pools exceed the limit
+ * rather than fail when all their memory is in use.
+ */
+void SetMemoryLimit(size_t bytes);
+/**
+ * Free idle host memory pool memory until the pools, including the pool of
+ * MPI_Alloc_mem memory, hold at most target_bytes together. The MPI_Alloc_mem
+ * pool is trimmed first, and each pool least recently used first. Memory in
+ * the scratch arena and small blocks cached by threads are kept. Return the
+ * number of bytes freed.
+ */
+size_t TrimMemory(size_t target_bytes = 0);
+/**
+ * Return at least bytes bytes of host memory, aligned to 64 bytes, allocated
+ * with MPI_Alloc_mem so the MPI library can register it once for transfers,
+ * e.g. for buffers that are repeatedly reduced. This comes from the same pool
+ * as scratch buffers do with AL_MEMPOOL_MPI_ALLOC, and counts towards the
+ * limit of SetMemoryLimit. Release it with ReleaseRegisteredMemory before Finalize.
+ */
+void* AllocateRegisteredMemory(size_t bytes);
+/** Release memory from AllocateRegisteredMemory; nullptr is ignored. */
+void ReleaseRegisteredMemory(void* mem);
 
 /**
  * Perform an allreduce.
@@ -171,6 +210,158 @@ void NonblockingAllreduce(
                                             comm, req, algo);
 }
 
+/**
+ * Version of NonblockingAllreduce with a scheduling priority.
+ * High-priority operations may start ahead of normal-priority operations
+ * already enqueued. This is only supported by backends with a progress
+ * engine (currently MPIBackend).
+ */
+template <typename Backend, typename T>
+void NonblockingAllreduce(
+  const T* sendbuf, T* recvbuf, size_t count,
+  ReductionOperator op,
+  typename Backend::comm_type& comm,
+  typename Backend::req_type& req,
+  typename Backend::allreduce_algo_type algo,
+  OpPriority priority) {
+  internal::trace::record_op<Backend, T>("nonblocking-allreduce", comm, sendbuf,
+                                         recvbuf, count);
+  Backend::template NonblockingAllreduce<T>(sendbuf, recvbuf, count, op,
+                                            comm, req, algo, priority);
+}
+/** In-place version of NonblockingAllreduce with a priority. */
+template <typename Backend, typename T>
+void NonblockingAllreduce(
+  T* recvbuf, size_t count,
+  ReductionOperator op,
+  typename Backend::comm_type& comm,
+  typename Backend::req_type& req,
+  typename Backend::allreduce_algo_type algo,
+  OpPriority priority) {
+  internal::trace::record_op<Backend, T>("nonblocking-allreduce", comm,
+                                         recvbuf, count);
+  Backend::template NonblockingAllreduce<T>(recvbuf, count, op,
+                                            comm, req, algo, priority);
+}
+
+/**
+ * Version of NonblockingAllreduce with a scheduling priority and progress
+ * mode. With ProgressMode::caller, the operation is run by threads that test
+ * or wait on req instead of by a progress thread, which avoids handing it off
+ * for small, latency-critical operations, but it only progresses while req is
+ * being tested or waited on. ProgressMode::automatic uses the communicator's
+ * mode. This is only supported by backends with a progress engine (currently
+ * MPIBackend).
+ */
+template <typename Backend, typename T>
+void NonblockingAllreduce(
+  const T* sendbuf, T* recvbuf, size_t count,
+  ReductionOperator op,
+  typename Backend::comm_type& comm,
+  typename Backend::req_type& req,
+  typename Backend::allreduce_algo_type algo,
+  OpPriority priority,
+  ProgressMode mode) {
+  internal::trace::record_op<Backend, T>("nonblocking-allreduce", comm, sendbuf,
+                                         recvbuf, count);
+  Backend::template NonblockingAllreduce<T>(sendbuf, recvbuf, count, op,
+                                            comm, req, algo, priority, mode);
+}
+/** In-place version of NonblockingAllreduce with a priority and mode. */
+template <typename Backend, typename T>
+void NonblockingAllreduce(
+  T* recvbuf, size_t count,
+  ReductionOperator op,
+  typename Backend::comm_type& comm,
+  typename Backend::req_type& req,
+  typename Backend::allreduce_algo_type algo,
+  OpPriority priority,
+  ProgressMode mode) {
+  internal::trace::record_op<Backend, T>("nonblocking-allreduce", comm,
+                                         recvbuf, count);
+  Backend::template NonblockingAllreduce<T>(recvbuf, count, op,
+                                            comm, req, algo, priority, mode);
+}
+
+/**
+ * Version of NonblockingAllreduce that runs once the operations of deps have
+ * completed, instead of in order with other operations on its stream.
+ * Operations that do not depend on each other may then run out of order.
+ * sendbuf is read only after deps complete, so it may be the output of one
+ * of them. This is only supported by backends with a progress engine
+ * (currently MPIBackend), and mpi_passthrough waits for deps in the caller.
+ */
+template <typename Backend, typename T>
+void NonblockingAllreduce(
+  const T* sendbuf, T* recvbuf, size_t count,
+  ReductionOperator op,
+  typename Backend::comm_type& comm,
+  typename Backend::req_type& req,
+  const std::vector<typename Backend::req_type>& deps,
+  typename Backend::allreduce_algo_type algo =
+  Backend::allreduce_algo_type::automatic) {
+  internal::trace::record_op<Backend, T>("nonblocking-allreduce", comm, sendbuf,
+                                         recvbuf, count);
+  Backend::template NonblockingAllreduce<T>(sendbuf, recvbuf, count, op,
+                                            comm, req, algo,
+                                            OpPriority::normal,
+                                            ProgressMode::automatic, &deps);
+}
+/** In-place version of NonblockingAllreduce with dependencies. */
+template <typename Backend, typename T>
+void NonblockingAllreduce(
+  T* recvbuf, size_t count,
+  ReductionOperator op,
+  typename Backend::comm_type& comm,
+  typename Backend::req_type& req,
+  const std::vector<typename Backend::req_type>& deps,
+  typename Backend::allreduce_algo_type algo =
+  Backend::allreduce_algo_type::automatic) {
+  internal::trace::record_op<Backend, T>("nonblocking-allreduce", comm,
+                                         recvbuf, count);
+  Backend::template NonblockingAllreduce<T>(recvbuf, count, op,
+                                            comm, req, algo,
+                                            OpPriority::normal,
+                                            ProgressMode::automatic, &deps);
+}
+
+/**
+ * Set up a persistent allreduce, to be run any number of times with Start.
+ * Each start reduces the current contents of sendbuf into recvbuf, as
+ * NonblockingAllreduce would. The schedule, temporary memory, and (where
+ * possible) MPI requests are set up once here, so the same allreduce can be
+ * repeated cheaply. Each start uses the communicator's progress mode at the
+ * time of this call. preq must be freed with RequestFree once no start is
+ * running. This is only supported by backends with a progress engine
+ * (currently MPIBackend).
+ */
+template <typename Backend, typename T>
+void AllreduceInit(
+  const T* sendbuf, T* recvbuf, size_t count,
+  ReductionOperator op,
+  typename Backend::comm_type& comm,
+  typename Backend::persistent_req_type& preq,
+  typename Backend::allreduce_algo_type algo =
+  Backend::allreduce_algo_type::automatic) {
+  internal::trace::record_op<Backend, T>("persistent-allreduce-init", comm,
+                                         sendbuf, recvbuf, count);
+  Backend::template AllreduceInit<T>(sendbuf, recvbuf, count, op, comm, preq,
+                                     algo);
+}
+/** In-place version of AllreduceInit; same semantics apply. */
+template <typename Backend, typename T>
+void AllreduceInit(
+  T* recvbuf, size_t count,
+  ReductionOperator op,
+  typename Backend::comm_type& comm,
+  typename Backend::persistent_req_type& preq,
+  typename Backend::allreduce_algo_type algo =
+  Backend::allreduce_algo_type::automatic) {
+  internal::trace::record_op<Backend, T>("persistent-allreduce-init", comm,
+                                         recvbuf, count);
+  Backend::template AllreduceInit<T>(recvbuf, count, op, comm, preq, algo);
+}
+
 /**
  * Perform a reduction.
  * @param sendbuf Input data.
@@ -741,6 +932,91 @@ bool Test(typename Backend::req_type& req);
 /** Wait until req has been completed. */
 template <typename Backend>
 void Wait(typename Backend::req_type& req);
+/**
+ * Start the persistent operation preq, setting req to a request for this run
+ * that is tested or waited on like any other. The previous run of preq must
+ * have completed.
+ */
+template <typename Backend>
+void Start(typename Backend::persistent_req_type& preq,
+           typename Backend::req_type& req);
+/**
+ * Free the persistent operation preq and set it to a null handle.
+ * No run of it may still be in progress.
+ */
+template <typename Backend>
+void RequestFree(typename Backend::persistent_req_type& preq);
+/**
+ * Test whether all count requests in reqs have completed, returning true if
+ * they have, in which case they are all released and nulled. Otherwise
+ * backends with a progress engine (MPIBackend) leave every request as it
+ * was, like MPI_Testall, but other backends release and null those that have
+ * completed, as Test does. Use TestSome to find which requests completed.
+ */
+template <typename Backend>
+bool TestAll(size_t count, typename Backend::req_type* reqs) {
+  // Test has no way to check a request without releasing it when complete,
+  // so completed requests are released even when others are pending.
+  bool all_done = true;
+  for (size_t i = 0; i < count; ++i) {
+    all_done &= Test<Backend>(reqs[i]);
+  }
+  return all_done;
+}
+/**
+ * Test each of the count requests in reqs, writing the indices of completed
+ * ones to indices (which must have room for count entries). Null requests
+ * are ignored.
+ * @return The number of completed requests.
+ */
+template <typename Backend>
+size_t TestSome(size_t count, typename Backend::req_type* reqs,
+                size_t* indices) {
+  size_t num_completed = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (reqs[i] != Backend::null_req && Test<Backend>(reqs[i])) {
+      indices[num_completed++] = i;
+    }
+  }
+  return num_completed;
+}
+/** Wait until all count requests in reqs have been completed. */
+template <typename Backend>
+void WaitAll(size_t count, typename Backend::req_type* reqs) {
+  for (size_t i = 0; i < count; ++i) {
+    Wait<Backend>(reqs[i]);
+  }
+}
+/**
+ * Wait until any of the count requests in reqs has been completed.
+ * Null requests are ignored.
+ * @return The index of the completed request, or count if all are null.
+ */
+template <typename Backend>
+size_t WaitAny(size_t count, typename Backend::req_type* reqs) {
+  while (true) {
+    bool any_active = false;
+    for (size_t i = 0; i < count; ++i) {
+      if (reqs[i] != Backend::null_req) {
+        any_active = true;
+        if (Test<Backend>(reqs[i])) {
+          return i;
+        }
+      }
+    }
+    if (!any_active) {
+      return count;
+    }
+  }
+}
+/**
+ * Run callback once req has completed.
+ * req is set to a null request and should not be tested or waited on. If req
+ * has already completed, callback runs immediately in the calling thread;
+ * otherwise it runs on a progress thread (see SetCompletionExecutor).
+ */
+template <typename Backend>
+void OnComplete(typename Backend::req_type& req, CompletionCallback callback);
 
 namespace ext {
 
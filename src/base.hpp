@@ -27,7 +27,10 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <exception>
+#include <functional>
 #include <string>
 
 namespace Al {
@@ -61,4 +64,56 @@ enum class ReductionOperator {
   sum, prod, min, max, lor, land, lxor, bor, band, bxor
 };
 
+/**
+ * Scheduling priority for non-blocking operations.
+ * High-priority operations are started ahead of normal ones queued on the
+ * same stream and may use concurrency slots reserved for them. Ordering is
+ * only guaranteed among operations of the same priority.
+ */
+enum class OpPriority {
+  normal, high
+};
+
+/**
+ * Who drives a non-blocking operation to completion.
+ * With caller-driven progress, the operation never goes through the progress
+ * engine: the thread that tests or waits on its request runs its steps, so it
+ * only makes progress while its request is being tested or waited on. It
+ * still counts against the engine's concurrency and in-flight limits, and the
+ * engine runs it instead when those are full.
+ */
+enum class ProgressMode {
+  /** Use the communicator's progress mode. */
+  automatic,
+  /** Run the operation on a progress thread. */
+  engine,
+  /** Run the operation in threads that test or wait on its request. */
+  caller
+};
+
+/** Callback run when a non-blocking operation completes. */
+using CompletionCallback = std::function<void()>;
+/**
+ * Runs completion callbacks on behalf of the progress engine.
+ * The executor is called from a progress thread and should hand the callback
+ * off quickly (e.g. to a thread pool) rather than run long work itself.
+ */
+using CompletionExecutor = std::function<void(CompletionCallback)>;
+
+/** Statistics on the host memory Aluminum uses for temporary buffers. */
+struct MemoryStats {
+  /** Bytes currently allocated from the system, in use or idle. */
+  size_t bytes_held;
+  /** Bytes currently handed out to operations. */
+  size_t bytes_in_use;
+  /** Largest value bytes_held has reached. */
+  size_t peak_bytes_held;
+  /** Total bytes returned to the system by trimming. */
+  size_t bytes_trimmed;
+  /** Requests served from idle memory. */
+  uint64_t num_hits;
+  /** Requests that needed new memory from the system. */
+  uint64_t num_misses;
+};
+
 } // namespace Al
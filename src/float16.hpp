@@ -0,0 +1,137 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.  Produced at the
+// Lawrence Livermore National Laboratory in collaboration with University of
+// Illinois Urbana-Champaign.
+//
+// Written by the LBANN Research Team (N. Dryden, N. Maruyama, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-756777.
+// All rights reserved.
+//
+// This file is part of Aluminum GPU-aware Communication Library. For details, see
+// http://software.llnl.gov/Aluminum or https://github.com/LLNL/Aluminum.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace Al {
+
+/**
+ * IEEE 754 half-precision (binary16) floating point value.
+ * This only stores the value: arithmetic converts it to float, and
+ * assigning a float rounds it to nearest even.
+ */
+struct float16 {
+  /** Bit pattern of the value. */
+  uint16_t bits;
+
+  float16() = default;
+  float16(float f) : bits(from_float(f)) {}
+  operator float() const { return to_float(bits); }
+
+  /** Return the binary16 bit pattern nearest f. */
+  static uint16_t from_float(float f) {
+    uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+    const uint32_t sign = (x >> 16) & 0x8000;
+    x &= 0x7fffffff;
+    if (x >= 0x47800000) {
+      // Too large (or rounds to infinity), infinity, or NaN.
+      return sign | (x > 0x7f800000 ? 0x7e00 : 0x7c00);
+    }
+    if (x < 0x38800000) {
+      // Subnormal or zero: adding 0.5 lines the value up with the float
+      // mantissa such that the hardware does the rounding.
+      float tmp;
+      std::memcpy(&tmp, &x, sizeof(tmp));
+      tmp += 0.5f;
+      std::memcpy(&x, &tmp, sizeof(x));
+      return sign | (x - 0x3f000000);
+    }
+    // Normal: rebias the exponent and round to nearest even.
+    x += 0xc8000fff + ((x >> 13) & 1);
+    return sign | (x >> 13);
+  }
+  /** Return the float with binary16 bit pattern h. */
+  static float to_float(uint16_t h) {
+    uint32_t x = static_cast<uint32_t>(h & 0x7fff) << 13;
+    const uint32_t exp = x & 0x0f800000;
+    x += 0x38000000;  // Rebias the exponent.
+    if (exp == 0x0f800000) {
+      x += 0x38000000;  // Infinity or NaN.
+    } else if (exp == 0) {
+      // Subnormal: renormalize by letting the hardware subtract the implicit
+      // leading one.
+      x += 0x00800000;
+      float tmp;
+      std::memcpy(&tmp, &x, sizeof(tmp));
+      tmp -= 6.103515625e-05f;  // 2^-14
+      std::memcpy(&x, &tmp, sizeof(x));
+    }
+    x |= static_cast<uint32_t>(h & 0x8000) << 16;
+    float f;
+    std::memcpy(&f, &x, sizeof(f));
+    return f;
+  }
+};
+
+/**
+ * bfloat16 floating point value: the upper 16 bits of a float.
+ * This only stores the value: arithmetic converts it to float, and
+ * assigning a float rounds it to nearest even.
+ */
+struct bfloat16 {
+  /** Bit pattern of the value. */
+  uint16_t bits;
+
+  bfloat16() = default;
+  bfloat16(float f) : bits(from_float(f)) {}
+  operator float() const { return to_float(bits); }
+
+  /** Return the bfloat16 bit pattern nearest f. */
+  static uint16_t from_float(float f) {
+    uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+    if ((x & 0x7fffffff) > 0x7f800000) {
+      // Keep NaNs quiet instead of letting rounding turn them into infinity.
+      return (x >> 16) | 0x40;
+    }
+    return (x + 0x7fff + ((x >> 16) & 1)) >> 16;
+  }
+  /** Return the float with bfloat16 bit pattern h. */
+  static float to_float(uint16_t h) {
+    const uint32_t x = static_cast<uint32_t>(h) << 16;
+    float f;
+    std::memcpy(&f, &x, sizeof(f));
+    return f;
+  }
+};
+
+/**
+ * Whether T is a 16-bit floating point type, which is reduced by converting
+ * to float.
+ */
+template <typename T>
+struct is_half_float : std::false_type {};
+template <> struct is_half_float<float16> : std::true_type {};
+template <> struct is_half_float<bfloat16> : std::true_type {};
+
+}  // namespace Al
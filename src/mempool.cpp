@@ -0,0 +1,277 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.  Produced at the
+// Lawrence Livermore National Laboratory in collaboration with University of
+// Illinois Urbana-Champaign.
+//
+// Written by the LBANN Research Team (N. Dryden, N. Maruyama, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-756777.
+// All rights reserved.
+//
+// This file is part of Aluminum GPU-aware Communication Library. For details, see
+// http://software.llnl.gov/Aluminum or https://github.com/LLNL/Aluminum.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <hwloc.h>
+#include <mpi.h>
+#include <atomic>
+#include <cstdlib>
+#include <string>
+#include "Al.hpp"
+#include "mempool.hpp"
+
+namespace Al {
+namespace internal {
+
+namespace {
+
+/** Huge page size that arena memory is aligned to. */
+constexpr size_t huge_page_size = 2*1024*1024;
+
+/** Scratch memory for the host memory pool. */
+struct Arena {
+  /** Start of the arena, or nullptr if there is none. */
+  std::atomic<char*> base{nullptr};
+  /** Size of the arena. */
+  size_t size = 0;
+  /** Bytes handed out so far. */
+  std::atomic<size_t> used{0};
+  /** Huge page mode; see AL_MEMPOOL_HUGE_PAGES. */
+  size_t huge_pages = AL_MEMPOOL_HUGE_PAGES;
+  /** Topology for memory binding, if binding. */
+  hwloc_topology_t topo = nullptr;
+  /** NUMA node to bind memory to, or nullptr to not bind. */
+  hwloc_nodeset_t nodeset = nullptr;
+};
+
+Arena& get_arena() {
+  static Arena arena;
+  return arena;
+}
+
+/** Round n up to a multiple of align, which must be a power of 2. */
+size_t round_up(size_t n, size_t align) {
+  return (n + align - 1) & ~(align - 1);
+}
+
+/**
+ * Map len bytes, a multiple of huge_page_size, using huge pages as configured,
+ * and bind them to the arena's NUMA node. Return nullptr on failure.
+ */
+char* map_memory(Arena& arena, size_t len) {
+  void* mem = MAP_FAILED;
+#ifdef MAP_HUGETLB
+  if (arena.huge_pages == 2) {
+    mem = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  }
+#endif
+  if (mem == MAP_FAILED) {
+    // Over-map so the region can be aligned for transparent huge pages.
+    const size_t map_len = len + huge_page_size;
+    void* raw = mmap(nullptr, map_len, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+      return nullptr;
+    }
+    char* start = reinterpret_cast<char*>(
+      round_up(reinterpret_cast<size_t>(raw), huge_page_size));
+    const size_t head = start - static_cast<char*>(raw);
+    if (head > 0) {
+      munmap(raw, head);
+    }
+    if (map_len - head > len) {
+      munmap(start + len, map_len - head - len);
+    }
+    mem = start;
+#ifdef MADV_HUGEPAGE
+    if (arena.huge_pages != 0) {
+      madvise(mem, len, MADV_HUGEPAGE);
+    }
+#endif
+  }
+  if (arena.nodeset != nullptr) {
+    // Best effort: binding is not supported everywhere.
+    hwloc_set_area_membind(arena.topo, mem, len, arena.nodeset,
+                           HWLOC_MEMBIND_BIND, HWLOC_MEMBIND_BYNODESET);
+  }
+  return static_cast<char*>(mem);
+}
+
+}  // namespace
+
+void* HostAllocator::allocate(size_t bytes) {
+  Arena& arena = get_arena();
+  char* base = arena.base.load(std::memory_order_acquire);
+  if (base != nullptr) {
+    // Align large blocks to huge pages so they span as few as possible.
+    const size_t align = bytes >= huge_page_size ? huge_page_size : 64;
+    size_t used = arena.used.load(std::memory_order_relaxed);
+    size_t start = round_up(used, align);
+    while (start + bytes <= arena.size) {
+      if (arena.used.compare_exchange_weak(used, start + bytes,
+                                           std::memory_order_relaxed)) {
+        return base + start;
+      }
+      start = round_up(used, align);
+    }
+  }
+  void* mem = nullptr;
+  if (bytes >= huge_page_size) {
+    // deallocate relies on large blocks always being mapped.
+    mem = map_memory(arena, round_up(bytes, huge_page_size));
+    if (mem == nullptr) {
+      throw_al_exception("Could not map memory for the memory pool");
+    }
+  } else if (posix_memalign(&mem, 64, bytes) != 0) {
+    throw_al_exception("Could not allocate memory for the memory pool");
+  }
+  return mem;
+}
+
+void HostAllocator::deallocate(void* mem, size_t bytes) {
+  if (bytes >= huge_page_size) {
+    munmap(mem, round_up(bytes, huge_page_size));
+  } else {
+    std::free(mem);
+  }
+}
+
+bool HostAllocator::can_deallocate(void* mem) {
+  Arena& arena = get_arena();
+  char* base = arena.base.load(std::memory_order_acquire);
+  char* p = static_cast<char*>(mem);
+  return base == nullptr || p < base || p >= base + arena.size;
+}
+
+void* MPIAllocator::allocate(size_t bytes) {
+  // MPI_Alloc_mem need not align to 64 bytes, so over-allocate and keep the
+  // original pointer just before the aligned memory.
+  void* raw = nullptr;
+  if (MPI_Alloc_mem(static_cast<MPI_Aint>(bytes + 64 + sizeof(void*)),
+                    MPI_INFO_NULL, &raw) != MPI_SUCCESS) {
+    throw_al_exception("Could not allocate memory with MPI_Alloc_mem");
+  }
+  void** mem = reinterpret_cast<void**>(
+    round_up(reinterpret_cast<size_t>(raw) + sizeof(void*), 64));
+  mem[-1] = raw;
+  return mem;
+}
+
+void MPIAllocator::deallocate(void* mem, size_t) {
+  int finalized;
+  MPI_Finalized(&finalized);
+  if (!finalized) {
+    MPI_Free_mem(static_cast<void**>(mem)[-1]);
+  }
+}
+
+std::atomic<bool> use_mpi_mempool(false);
+
+void init_mpi_mempool() {
+  use_mpi_mempool = get_env_size("AL_MEMPOOL_MPI_ALLOC",
+                                 AL_MEMPOOL_MPI_ALLOC) != 0;
+}
+
+void finalize_mpi_mempool() {
+  use_mpi_mempool = false;
+  // Blocks still in thread caches or in use are left; after this they are
+  // never freed.
+  get_mpi_mempool().trim(0);
+}
+
+size_t trim_host_mempools(size_t target_bytes) {
+  // Registered memory is the scarcer resource, so it goes first.
+  auto& host = get_mempool();
+  auto& mpi = get_mpi_mempool();
+  const size_t host_held = host.get_bytes_held();
+  size_t freed = mpi.trim(target_bytes > host_held ?
+                          target_bytes - host_held : 0);
+  const size_t mpi_held = mpi.get_bytes_held();
+  freed += host.trim(target_bytes > mpi_held ? target_bytes - mpi_held : 0);
+  return freed;
+}
+
+void init_arena(int numa_node) {
+  Arena& arena = get_arena();
+  if (arena.base.load(std::memory_order_acquire) != nullptr) {
+    return;
+  }
+  arena.huge_pages = get_env_size("AL_MEMPOOL_HUGE_PAGES",
+                                  AL_MEMPOOL_HUGE_PAGES);
+  if (numa_node >= 0 && arena.nodeset == nullptr) {
+    hwloc_topology_init(&arena.topo);
+    hwloc_topology_load(arena.topo);
+    arena.nodeset = hwloc_bitmap_alloc();
+    hwloc_bitmap_only(arena.nodeset, static_cast<unsigned>(numa_node));
+  }
+  const size_t size = round_up(
+    get_env_size("AL_MEMPOOL_ARENA_BYTES", AL_MEMPOOL_ARENA_BYTES),
+    huge_page_size);
+  if (size == 0) {
+    return;
+  }
+  char* base = map_memory(arena, size);
+  if (base == nullptr) {
+    throw_al_exception("Could not map memory pool arena");
+  }
+  // Touch every page now so the first operations do not fault them in.
+  const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  for (size_t offset = 0; offset < size; offset += page_size) {
+    base[offset] = 0;
+  }
+  arena.size = size;
+  arena.base.store(base, std::memory_order_release);
+}
+
+}  // namespace internal
+
+MemoryStats GetMemoryStats() {
+  MemoryStats stats = internal::get_mempool().get_stats();
+  const MemoryStats mpi_stats = internal::get_mpi_mempool().get_stats();
+  stats.bytes_held += mpi_stats.bytes_held;
+  stats.bytes_in_use += mpi_stats.bytes_in_use;
+  // Each pool's peak may be at a different time, so use the combined one.
+  stats.peak_bytes_held = internal::get_host_memory_budget()
+    .peak_bytes_held.load(std::memory_order_relaxed);
+  stats.bytes_trimmed += mpi_stats.bytes_trimmed;
+  stats.num_hits += mpi_stats.num_hits;
+  stats.num_misses += mpi_stats.num_misses;
+  return stats;
+}
+
+void SetMemoryLimit(size_t bytes) {
+  internal::get_host_memory_budget().set_max_bytes(bytes);
+}
+
+size_t TrimMemory(size_t target_bytes) {
+  return internal::trim_host_mempools(target_bytes);
+}
+
+void* AllocateRegisteredMemory(size_t bytes) {
+  if (!Initialized()) {
+    throw_al_exception("Aluminum is not initialized");
+  }
+  return internal::get_mpi_mempool().allocate(bytes);
+}
+
+void ReleaseRegisteredMemory(void* mem) {
+  internal::get_mpi_mempool().release(mem);
+}
+
+}  // namespace Al
@@ -27,10 +27,16 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
 #include <mutex>
-#include <vector>
-#include <unordered_map>
-#include <utility>
+#include <new>
+#include <string>
+#include "base.hpp"
+#include "tuning_params.hpp"
+#include "utils.hpp"
 #ifdef AL_HAS_CUDA
 #include "cuda.hpp"
 #endif
@@ -38,145 +44,674 @@
 namespace Al {
 namespace internal {
 
-/** An entry in a simple memory pool. */
-template <typename T>
-using MempoolEntry = std::pair<T*, bool>;
-/** A list for a particular size of allocation. */
-template <typename T>
-using MempoolSizeList = std::vector<MempoolEntry<T>>;
-/** For actually mapping sizes to entries. */
-template <typename T>
-using MempoolMap = std::unordered_map<size_t, MempoolSizeList<T>>;
-/** A memory pool. */
-template <typename T>
-struct Mempool {
-  /** The actual memory. */
-  MempoolMap<T> memmap;
-  /** Used to find allocated memory for freeing. */
-  std::unordered_map<T*, size_t> allocated;
-#if AL_LOCK_MEMPOOL
-  /** Mutex to protect concurrent access. */
-  std::mutex lock;
+/**
+ * Allocates ordinary host memory for a SizeClassMempool.
+ * Memory comes from the scratch arena while it has room, and otherwise from
+ * the system, with large allocations mapped like the arena.
+ */
+struct HostAllocator {
+  static void* allocate(size_t bytes);
+  static void deallocate(void* mem, size_t bytes);
+  /** Return false for arena memory, which is never freed. */
+  static bool can_deallocate(void* mem);
+};
+
+/**
+ * Set up the scratch arena for the host memory pool.
+ * This maps AL_MEMPOOL_ARENA_BYTES of memory, backed by huge pages as
+ * AL_MEMPOOL_HUGE_PAGES selects, binds it to NUMA node numa_node (unless it
+ * is -1), and pre-faults it, so the first operations using it do not pay for
+ * page faults. Later large allocations are bound to the same node. This is
+ * called by Initialize; memory got before then comes from the system.
+ */
+void init_arena(int numa_node);
+
+/**
+ * Allocates host memory with MPI_Alloc_mem for a SizeClassMempool.
+ * MPI libraries can register such memory with the network once, rather than
+ * on every large transfer, or can avoid copying through bounce buffers.
+ * MPI must be initialized.
+ */
+struct MPIAllocator {
+  static void* allocate(size_t bytes);
+  static void deallocate(void* mem, size_t bytes);
+  static bool can_deallocate(void*) { return true; }
+};
+
+#ifdef AL_HAS_CUDA
+/** Allocates CUDA-registered pinned host memory for a SizeClassMempool. */
+struct PinnedHostAllocator {
+  static void* allocate(size_t bytes) {
+    void* mem = nullptr;
+    AL_CHECK_CUDA(cudaMallocHost(&mem, bytes));
+    return mem;
+  }
+  static void deallocate(void* mem, size_t) {
+    AL_CHECK_CUDA(cudaFreeHost(mem));
+  }
+  static bool can_deallocate(void*) { return true; }
+};
 #endif
+
+/**
+ * A soft limit on the bytes one or more SizeClassMempools hold together, and
+ * their combined usage.
+ */
+struct MemoryBudget {
+  /**
+   * trim_ frees idle memory in the pools sharing the budget until they hold
+   * at most the bytes given, and returns the number of bytes freed.
+   */
+  explicit MemoryBudget(size_t (*trim_)(size_t)) : trim(trim_) {
+    max_bytes = get_env_size("AL_MEMPOOL_MAX_BYTES", AL_MEMPOOL_MAX_BYTES);
+  }
+  /** Set the limit (0 for none), trimming to it. */
+  void set_max_bytes(size_t bytes) {
+    max_bytes.store(bytes, std::memory_order_relaxed);
+    if (bytes > 0) {
+      trim(bytes);
+    }
+  }
+  /** Record that a pool got bytes more from its allocator. */
+  void add_held(size_t bytes) {
+    const size_t held =
+      bytes_held.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    size_t peak = peak_bytes_held.load(std::memory_order_relaxed);
+    while (held > peak
+           && !peak_bytes_held.compare_exchange_weak(
+             peak, held, std::memory_order_relaxed)) {}
+  }
+  /** Record that a pool returned bytes to its allocator. */
+  void sub_held(size_t bytes) {
+    bytes_held.fetch_sub(bytes, std::memory_order_relaxed);
+  }
+
+  /** Frees idle memory in the pools; see the constructor. */
+  size_t (*const trim)(size_t);
+  /** Soft limit on bytes held by all the pools; 0 for none. */
+  std::atomic<size_t> max_bytes;
+  /** Bytes held by all the pools. */
+  std::atomic<size_t> bytes_held{0};
+  /** Largest value of bytes_held. */
+  std::atomic<size_t> peak_bytes_held{0};
 };
-/** Get the memory pool for type T. */
-template <typename T>
-Mempool<T>& get_mempool() {
-  static Mempool<T> mempool;
-  return mempool;
+
+/**
+ * A memory pool that hands out raw memory in size classes.
+ *
+ * Requests are rounded up to a size class: 64 bytes, then four classes per
+ * power of two, so at most a quarter of a block is wasted. Each block has a
+ * header recording its class, and free blocks of a class are kept on an
+ * intrusive list threaded through their headers, so getting and releasing
+ * memory are both O(1). Blocks are shared by all element types.
+ *
+ * Blocks up to AL_MEMPOOL_CACHE_MAX_BYTES are served from per-thread caches
+ * of up to AL_MEMPOOL_CACHE_BLOCKS blocks per class, which need no locking.
+ * Such a block belongs to the cache of the thread that got it. If another
+ * thread releases it, it is pushed onto the owner's lock-free remote-free
+ * stack, which the owner drains when it runs out of blocks of a class; this
+ * handles memory got by a user thread and released by the progress engine.
+ * Caches exchange blocks with mutex-protected shared lists in batches, and
+ * larger blocks use the shared lists directly. When a thread exits its cache
+ * is emptied into the shared lists and kept for reuse by a later thread.
+ *
+ * Free blocks in the shared lists are also kept in least-recently-released
+ * order, and are returned to Allocator, oldest first, by trim, or when
+ * getting a new block would take the pools sharing its MemoryBudget over the
+ * budget's limit, which trims all of them. The limit is soft: the pool still
+ * grows past it when every block is in use or cached by a thread. Allocator must provide `static void* allocate(size_t bytes)`,
+ * returning 64-byte-aligned memory, `static void deallocate(void* mem,
+ * size_t bytes)`, and `static bool can_deallocate(void* mem)`, which is
+ * false for memory that must stay in the pool.
+ *
+ * There must be only one pool for each Allocator.
+ */
+template <typename Allocator>
+class SizeClassMempool {
+ public:
+  explicit SizeClassMempool(MemoryBudget& budget_) : budget(budget_) {
+    cache_blocks = get_env_size("AL_MEMPOOL_CACHE_BLOCKS",
+                                AL_MEMPOOL_CACHE_BLOCKS);
+    const size_t cache_max_bytes = get_env_size("AL_MEMPOOL_CACHE_MAX_BYTES",
+                                                AL_MEMPOOL_CACHE_MAX_BYTES);
+    num_cached_classes = 0;
+    if (cache_blocks > 0) {
+      while (num_cached_classes < num_classes
+             && get_class_bytes(num_cached_classes) <= cache_max_bytes) {
+        ++num_cached_classes;
+      }
+    }
+  }
+  /** Return memory for at least bytes bytes, aligned to 64 bytes. */
+  void* allocate(size_t bytes) {
+    const size_t size_class = get_size_class(bytes);
+    if (size_class >= num_cached_classes) {
+      return allocate_shared(size_class) + 1;
+    }
+    ThreadCache& cache = get_cache();
+    if (cache.free_lists[size_class] == nullptr) {
+      // Reclaim blocks other threads released before going to the shared
+      // lists.
+      drain_remote(cache);
+      if (cache.free_lists[size_class] == nullptr) {
+        refill(cache, size_class);
+      }
+    }
+    BlockHeader* block = cache.free_lists[size_class];
+    cache.free_lists[size_class] = block->next;
+    --cache.counts[size_class];
+    add_owned(cache.num_allocations, uint64_t(1));
+    add_owned(cache.bytes_in_use,
+              static_cast<int64_t>(get_class_bytes(size_class)));
+    return block + 1;
+  }
+  /**
+   * Return mem, which must have come from allocate, to the pool.
+   * Releasing nullptr does nothing.
+   */
+  void release(void* mem) {
+    if (mem == nullptr) {
+      return;
+    }
+    BlockHeader* block = static_cast<BlockHeader*>(mem) - 1;
+    ThreadCache* owner = block->owner;
+    if (owner == nullptr) {
+      shared_bytes_in_use.fetch_sub(get_class_bytes(block->size_class),
+                                    std::memory_order_relaxed);
+      std::lock_guard<std::mutex> lock(mutex);
+      push_shared(block);
+      return;
+    }
+    ThreadCache& cache = get_cache();
+    add_owned(cache.bytes_in_use,
+              -static_cast<int64_t>(get_class_bytes(block->size_class)));
+    if (owner == &cache) {
+      push_local(cache, block);
+    } else {
+      // Hand the block back to its owner without locking.
+      BlockHeader* head = owner->remote_free.load(std::memory_order_relaxed);
+      do {
+        block->next = head;
+      } while (!owner->remote_free.compare_exchange_weak(
+                 head, block,
+                 std::memory_order_release, std::memory_order_relaxed));
+    }
+  }
+  /**
+   * Return free blocks in the shared lists to Allocator, least recently
+   * released first, until the pool holds at most target_bytes. Return the
+   * number of bytes freed.
+   */
+  size_t trim(size_t target_bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    drain_orphans();
+    return trim_locked(target_bytes);
+  }
+  /** Return the bytes of blocks got from Allocator, in use or idle. */
+  size_t get_bytes_held() const {
+    return bytes_held.load(std::memory_order_relaxed);
+  }
+  /**
+   * Return whether mem, which must have come from the allocate of some
+   * SizeClassMempool, came from this one. Every pool has the same block
+   * header layout.
+   */
+  bool owns(const void* mem) const {
+    return (static_cast<const BlockHeader*>(mem) - 1)->pool == this;
+  }
+  /** Return usage statistics; these are approximate while in use. */
+  MemoryStats get_stats() {
+    MemoryStats stats;
+    int64_t in_use = 0;
+    uint64_t allocations = 0;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (ThreadCache* cache = all_caches; cache != nullptr;
+           cache = cache->next_cache) {
+        in_use += cache->bytes_in_use.load(std::memory_order_relaxed);
+        allocations += cache->num_allocations.load(std::memory_order_relaxed);
+      }
+    }
+    in_use += static_cast<int64_t>(
+      shared_bytes_in_use.load(std::memory_order_relaxed));
+    allocations += shared_allocations.load(std::memory_order_relaxed);
+    stats.bytes_held = bytes_held.load(std::memory_order_relaxed);
+    stats.peak_bytes_held = peak_bytes_held.load(std::memory_order_relaxed);
+    stats.bytes_in_use = in_use > 0 ? static_cast<size_t>(in_use) : 0;
+    stats.num_misses = num_misses.load(std::memory_order_relaxed);
+    stats.num_hits = allocations > stats.num_misses ?
+      allocations - stats.num_misses : 0;
+    stats.bytes_trimmed = bytes_trimmed.load(std::memory_order_relaxed);
+    return stats;
+  }
+
+  /** Return the size class used for an allocation of bytes bytes. */
+  static size_t get_size_class(size_t bytes) {
+    if (bytes <= min_class_bytes) {
+      return 0;
+    }
+    // With b in [2^o, 2^(o+1)), the class is the quarter of that range b
+    // falls in.
+    const size_t b = bytes - 1;
+    const size_t o = 8*sizeof(unsigned long long) - 1 - __builtin_clzll(b);
+    return 1 + (o - min_class_log2)*classes_per_doubling
+      + ((b >> (o - 2)) & (classes_per_doubling - 1));
+  }
+  /** Return the number of bytes in blocks of size_class. */
+  static size_t get_class_bytes(size_t size_class) {
+    if (size_class == 0) {
+      return min_class_bytes;
+    }
+    const size_t o = min_class_log2 + (size_class - 1) / classes_per_doubling;
+    const size_t k = (size_class - 1) % classes_per_doubling;
+    return (size_t(1) << o) + ((k + 1) << (o - 2));
+  }
+
+ private:
+  struct ThreadCache;
+  /** Header in front of each block; this keeps the data cache-aligned. */
+  struct alignas(64) BlockHeader {
+    /** Next block in whatever free list or stack this is on. */
+    BlockHeader* next = nullptr;
+    /** Previous block, while in a shared free list. */
+    BlockHeader* prev = nullptr;
+    /** Neighbors in release order, while trimmable and in a shared list. */
+    BlockHeader* lru_prev = nullptr;
+    BlockHeader* lru_next = nullptr;
+    /** Size class of the block. */
+    size_t size_class = 0;
+    /** Cache the block was got from, or nullptr if it is not cached. */
+    ThreadCache* owner = nullptr;
+    /** Pool the block belongs to. */
+    const void* pool = nullptr;
+    /** Whether the block can be returned to Allocator. */
+    bool trimmable = false;
+  };
+  static constexpr size_t min_class_log2 = 6;
+  static constexpr size_t min_class_bytes = size_t(1) << min_class_log2;
+  static constexpr size_t classes_per_doubling = 4;
+  /** Enough classes for any size_t request. */
+  static constexpr size_t num_classes =
+    1 + (8*sizeof(size_t) - min_class_log2)*classes_per_doubling;
+  /** Free blocks kept by one thread. */
+  struct ThreadCache {
+    /** Free blocks of each class. */
+    BlockHeader* free_lists[num_classes] = {};
+    /** Number of blocks in each free list. */
+    size_t counts[num_classes] = {};
+    /** Blocks of this cache released by other threads. */
+    std::atomic<BlockHeader*> remote_free{nullptr};
+    /** Next cache with no thread, while this has none. */
+    ThreadCache* next_orphan = nullptr;
+    /** Next cache in the list of all caches. */
+    ThreadCache* next_cache = nullptr;
+    /**
+     * Bytes got minus bytes released by the cache's thread, and the number
+     * of allocations it made. Only that thread writes these.
+     */
+    std::atomic<int64_t> bytes_in_use{0};
+    std::atomic<uint64_t> num_allocations{0};
+  };
+  /** Gives a thread a cache, and gives it up when the thread exits. */
+  struct CacheHandle {
+    SizeClassMempool& pool;
+    ThreadCache* cache;
+    CacheHandle(SizeClassMempool& pool_) :
+      pool(pool_), cache(pool_.adopt_cache()) {}
+    ~CacheHandle() { pool.orphan_cache(cache); }
+  };
+
+  /** Free blocks of each class not in any thread's cache. */
+  BlockHeader* free_lists[num_classes] = {};
+  /** Least and most recently released trimmable blocks in free_lists. */
+  BlockHeader* lru_head = nullptr;
+  BlockHeader* lru_tail = nullptr;
+  /** Caches of exited threads, available to new threads. */
+  ThreadCache* orphans = nullptr;
+  /** Every cache ever created, for statistics. */
+  ThreadCache* all_caches = nullptr;
+  /** Protects the shared free lists, the LRU list, and the cache lists. */
+  std::mutex mutex;
+  /** Maximum number of blocks of one class kept in a thread's cache. */
+  size_t cache_blocks;
+  /** Classes below this are cached. */
+  size_t num_cached_classes;
+  /** Limit shared with other pools, which this pool reports to. */
+  MemoryBudget& budget;
+  /** Bytes of blocks got from Allocator and not yet returned. */
+  std::atomic<size_t> bytes_held{0};
+  /** Largest value of bytes_held. */
+  std::atomic<size_t> peak_bytes_held{0};
+  /** Bytes returned to Allocator. */
+  std::atomic<size_t> bytes_trimmed{0};
+  /** Allocations that needed a new block. */
+  std::atomic<uint64_t> num_misses{0};
+  /** Bytes in use and allocations of blocks that are not cached. */
+  std::atomic<size_t> shared_bytes_in_use{0};
+  std::atomic<uint64_t> shared_allocations{0};
+
+  /** Add v to a counter that only the calling thread writes. */
+  template <typename T>
+  static void add_owned(std::atomic<T>& counter, T v) {
+    counter.store(counter.load(std::memory_order_relaxed) + v,
+                  std::memory_order_relaxed);
+  }
+  /** Return the calling thread's cache. */
+  ThreadCache& get_cache() {
+    static thread_local CacheHandle handle(*this);
+    return *handle.cache;
+  }
+  /** Return an orphaned cache, or a new one if there are none. */
+  ThreadCache* adopt_cache() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (orphans == nullptr) {
+      ThreadCache* cache = new ThreadCache();
+      cache->next_cache = all_caches;
+      all_caches = cache;
+      return cache;
+    }
+    ThreadCache* cache = orphans;
+    orphans = cache->next_orphan;
+    return cache;
+  }
+  /** Empty cache into the shared lists and make it available for reuse. */
+  void orphan_cache(ThreadCache* cache) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t size_class = 0; size_class < num_cached_classes; ++size_class) {
+      while (cache->free_lists[size_class] != nullptr) {
+        BlockHeader* block = cache->free_lists[size_class];
+        cache->free_lists[size_class] = block->next;
+        push_shared(block);
+      }
+      cache->counts[size_class] = 0;
+    }
+    // Blocks released to it from now on are reclaimed by drain_orphans or
+    // by the next thread to adopt it.
+    drain_remote_shared(cache);
+    cache->next_orphan = orphans;
+    orphans = cache;
+  }
+  /** Move blocks released by other threads into cache. */
+  void drain_remote(ThreadCache& cache) {
+    BlockHeader* block = cache.remote_free.exchange(nullptr,
+                                                    std::memory_order_acquire);
+    while (block != nullptr) {
+      BlockHeader* next = block->next;
+      push_local(cache, block);
+      block = next;
+    }
+  }
+  /** Add block to cache, spilling to the shared lists if it is full. */
+  void push_local(ThreadCache& cache, BlockHeader* block) {
+    const size_t size_class = block->size_class;
+    block->next = cache.free_lists[size_class];
+    cache.free_lists[size_class] = block;
+    if (++cache.counts[size_class] > cache_blocks) {
+      // Keep half so a thread that alternates does not spill every time.
+      std::lock_guard<std::mutex> lock(mutex);
+      while (cache.counts[size_class] > cache_blocks / 2) {
+        BlockHeader* spilled = cache.free_lists[size_class];
+        cache.free_lists[size_class] = spilled->next;
+        --cache.counts[size_class];
+        push_shared(spilled);
+      }
+    }
+  }
+  /** Add at least one block of size_class to the empty list in cache. */
+  void refill(ThreadCache& cache, size_t size_class) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (free_lists[size_class] == nullptr) {
+        drain_orphans();
+      }
+      const size_t batch = std::max<size_t>(cache_blocks / 2, 1);
+      while (free_lists[size_class] != nullptr
+             && cache.counts[size_class] < batch) {
+        BlockHeader* block = pop_shared(size_class);
+        block->owner = &cache;
+        block->next = cache.free_lists[size_class];
+        cache.free_lists[size_class] = block;
+        ++cache.counts[size_class];
+      }
+    }
+    if (cache.free_lists[size_class] == nullptr) {
+      BlockHeader* block = new_block(size_class);
+      block->owner = &cache;
+      cache.free_lists[size_class] = block;
+      cache.counts[size_class] = 1;
+    }
+  }
+  /** Return a block of an uncached size_class. */
+  BlockHeader* allocate_shared(size_t size_class) {
+    shared_allocations.fetch_add(1, std::memory_order_relaxed);
+    shared_bytes_in_use.fetch_add(get_class_bytes(size_class),
+                                  std::memory_order_relaxed);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (free_lists[size_class] == nullptr) {
+        drain_orphans();
+      }
+      if (free_lists[size_class] != nullptr) {
+        return pop_shared(size_class);
+      }
+    }
+    return new_block(size_class);
+  }
+  /**
+   * Get a new block of size_class from Allocator, first trimming idle blocks
+   * of the pools sharing the budget if it would take them over its limit.
+   * mutex must not be held.
+   */
+  BlockHeader* new_block(size_t size_class) {
+    const size_t bytes = get_class_bytes(size_class);
+    const size_t limit = budget.max_bytes.load(std::memory_order_relaxed);
+    if (limit > 0
+        && budget.bytes_held.load(std::memory_order_relaxed) + bytes > limit) {
+      budget.trim(limit > bytes ? limit - bytes : 0);
+    }
+    void* mem = Allocator::allocate(sizeof(BlockHeader) + bytes);
+    BlockHeader* block = new (mem) BlockHeader();
+    block->size_class = size_class;
+    block->pool = this;
+    block->trimmable = Allocator::can_deallocate(mem);
+    num_misses.fetch_add(1, std::memory_order_relaxed);
+    const size_t held =
+      bytes_held.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    size_t peak = peak_bytes_held.load(std::memory_order_relaxed);
+    while (held > peak
+           && !peak_bytes_held.compare_exchange_weak(
+             peak, held, std::memory_order_relaxed)) {}
+    budget.add_held(bytes);
+    return block;
+  }
+  /** Add block to the shared lists; mutex must be held. */
+  void push_shared(BlockHeader* block) {
+    block->owner = nullptr;
+    BlockHeader*& head = free_lists[block->size_class];
+    block->prev = nullptr;
+    block->next = head;
+    if (head != nullptr) {
+      head->prev = block;
+    }
+    head = block;
+    if (block->trimmable) {
+      block->lru_next = nullptr;
+      block->lru_prev = lru_tail;
+      if (lru_tail != nullptr) {
+        lru_tail->lru_next = block;
+      } else {
+        lru_head = block;
+      }
+      lru_tail = block;
+    }
+  }
+  /** Remove block from the shared lists; mutex must be held. */
+  void remove_shared(BlockHeader* block) {
+    if (block->prev != nullptr) {
+      block->prev->next = block->next;
+    } else {
+      free_lists[block->size_class] = block->next;
+    }
+    if (block->next != nullptr) {
+      block->next->prev = block->prev;
+    }
+    if (block->trimmable) {
+      if (block->lru_prev != nullptr) {
+        block->lru_prev->lru_next = block->lru_next;
+      } else {
+        lru_head = block->lru_next;
+      }
+      if (block->lru_next != nullptr) {
+        block->lru_next->lru_prev = block->lru_prev;
+      } else {
+        lru_tail = block->lru_prev;
+      }
+    }
+  }
+  /** Take the most recently released block of size_class; mutex held. */
+  BlockHeader* pop_shared(size_t size_class) {
+    BlockHeader* block = free_lists[size_class];
+    remove_shared(block);
+    return block;
+  }
+  /** Free idle blocks, oldest first, down to target_bytes; mutex held. */
+  size_t trim_locked(size_t target_bytes) {
+    size_t freed = 0;
+    while (lru_head != nullptr
+           && bytes_held.load(std::memory_order_relaxed) > target_bytes) {
+      BlockHeader* block = lru_head;
+      remove_shared(block);
+      const size_t bytes = get_class_bytes(block->size_class);
+      Allocator::deallocate(block, sizeof(BlockHeader) + bytes);
+      bytes_held.fetch_sub(bytes, std::memory_order_relaxed);
+      budget.sub_held(bytes);
+      freed += bytes;
+    }
+    bytes_trimmed.fetch_add(freed, std::memory_order_relaxed);
+    return freed;
+  }
+  /**
+   * Move blocks released to cache by other threads to the shared lists;
+   * mutex must be held.
+   */
+  void drain_remote_shared(ThreadCache* cache) {
+    BlockHeader* block = cache->remote_free.exchange(nullptr,
+                                                     std::memory_order_acquire);
+    while (block != nullptr) {
+      BlockHeader* next = block->next;
+      push_shared(block);
+      block = next;
+    }
+  }
+  /** Reclaim blocks released to orphaned caches; mutex must be held. */
+  void drain_orphans() {
+    for (ThreadCache* cache = orphans; cache != nullptr;
+         cache = cache->next_orphan) {
+      drain_remote_shared(cache);
+    }
+  }
+};
+
+/**
+ * Free idle memory in the memory pool and the MPI_Alloc_mem pool until they
+ * hold at most target_bytes together, trimming the MPI_Alloc_mem pool first.
+ * Return the number of bytes freed.
+ */
+size_t trim_host_mempools(size_t target_bytes);
+
+/**
+ * Get the budget shared by the memory pool and the MPI_Alloc_mem pool.
+ * Like the pools, this is never destroyed.
+ */
+inline MemoryBudget& get_host_memory_budget() {
+  static MemoryBudget* budget = new MemoryBudget(trim_host_mempools);
+  return *budget;
+}
+
+/**
+ * Get the memory pool.
+ * This is never destroyed, since thread caches may refer to it while threads
+ * exit.
+ */
+inline SizeClassMempool<HostAllocator>& get_mempool() {
+  static SizeClassMempool<HostAllocator>* mempool =
+    new SizeClassMempool<HostAllocator>(get_host_memory_budget());
+  return *mempool;
 }
 
+/**
+ * Get the pool of memory allocated with MPI_Alloc_mem.
+ * Like the memory pool, this is never destroyed.
+ */
+inline SizeClassMempool<MPIAllocator>& get_mpi_mempool() {
+  static SizeClassMempool<MPIAllocator>* mempool =
+    new SizeClassMempool<MPIAllocator>(get_host_memory_budget());
+  return *mempool;
+}
+
+/**
+ * Whether get_memory takes memory from the MPI_Alloc_mem pool instead of the
+ * memory pool. Initialize sets this from AL_MEMPOOL_MPI_ALLOC.
+ */
+extern std::atomic<bool> use_mpi_mempool;
+
 /** Get memory of type T with count elements. */
 template <typename T>
 T* get_memory(size_t count) {
-  auto& pool = get_mempool<T>();
-#if AL_LOCK_MEMPOOL
-  std::lock_guard<std::mutex> lock(pool.lock);
-#endif
-  // Try to find free memory.
-  if (pool.memmap.count(count)) {
-    // See if any memory of this size is free.
-    for (auto&& entry : pool.memmap[count]) {
-      if (!entry.second) {
-        entry.second = true;
-        pool.allocated[entry.first] = count;
-        return entry.first;
-      }
-    }
-    // No memory free, allocate some.
-    T* mem = new T[count];
-    pool.memmap[count].emplace_back(mem, true);
-    pool.allocated[mem] = count;
-    return mem;
-  } else {
-    // No entry for this size; so no free memory.
-    pool.memmap.emplace(count, MempoolSizeList<T>());
-    T* mem = new T[count];
-    pool.memmap[count].emplace_back(mem, true);
-    pool.allocated[mem] = count;
-    return mem;
+  if (use_mpi_mempool.load(std::memory_order_relaxed)) {
+    return static_cast<T*>(get_mpi_mempool().allocate(count*sizeof(T)));
   }
+  return static_cast<T*>(get_mempool().allocate(count*sizeof(T)));
 }
 
-/** Release memory that you got with get_memory. */
+/**
+ * Release memory that you got with get_memory.
+ * This goes to whichever pool the memory came from, so use_mpi_mempool may
+ * change while memory is in use.
+ */
 template <typename T>
 void release_memory(T* mem) {
-  auto& pool = get_mempool<T>();
-#if AL_LOCK_MEMPOOL
-  std::lock_guard<std::mutex> lock(pool.lock);
-#endif
-  size_t count = pool.allocated[mem];
-  pool.allocated.erase(mem);
-  // Find the entry.
-  for (auto&& entry : pool.memmap[count]) {
-    if (entry.first == mem) {
-      entry.second = false;
-      return;
-    }
+  if (mem == nullptr || get_mempool().owns(mem)) {
+    get_mempool().release(mem);
+  } else {
+    get_mpi_mempool().release(mem);
   }
 }
 
+/**
+ * Set up the MPI_Alloc_mem pool from AL_MEMPOOL_MPI_ALLOC. This is called by
+ * Initialize.
+ */
+void init_mpi_mempool();
+/**
+ * Free what memory of the MPI_Alloc_mem pool can be freed while MPI is still
+ * initialized. This is called by Finalize.
+ */
+void finalize_mpi_mempool();
+
 #ifdef AL_HAS_CUDA
-// Separate pools for CUDA-registered pinned memory.
-// It would be nice to unify these pools.
+// Pinned memory uses the same pool structure, with its own blocks.
 
-/** Get the pinned memory pool for type T. */
-template <typename T>
-Mempool<T>& get_pinned_mempool() {
-  static Mempool<T> mempool;
-  return mempool;
+/** Get the pinned memory pool, which has its own budget. */
+inline SizeClassMempool<PinnedHostAllocator>& get_pinned_mempool() {
+  static MemoryBudget* budget = new MemoryBudget([](size_t target_bytes) {
+      return get_pinned_mempool().trim(target_bytes);
+    });
+  static SizeClassMempool<PinnedHostAllocator>* mempool =
+    new SizeClassMempool<PinnedHostAllocator>(*budget);
+  return *mempool;
 }
 
-/** Get pinned memory of type T. */
+/** Get pinned memory of type T with count elements. */
 template <typename T>
 T* get_pinned_memory(size_t count) {
-  auto& pool = get_pinned_mempool<T>();
-#if AL_LOCK_MEMPOOL
-  std::lock_guard<std::mutex> lock(pool.lock);
-#endif
-  // Try to find free memory.
-  if (pool.memmap.count(count)) {
-    // See if any memory of this size is free.
-    for (auto&& entry : pool.memmap[count]) {
-      if (!entry.second) {
-        entry.second = true;
-        pool.allocated[entry.first] = count;
-        return entry.first;
-      }
-    }
-    // No memory free, allocate some.
-    T* mem;
-    AL_CHECK_CUDA(cudaMallocHost(&mem, count*sizeof(T)));
-    pool.memmap[count].emplace_back(mem, true);
-    pool.allocated[mem] = count;
-    return mem;
-  } else {
-    // No entry for this size; so no free memory.
-    pool.memmap.emplace(count, MempoolSizeList<T>());
-    T* mem;
-    AL_CHECK_CUDA(cudaMallocHost(&mem, count*sizeof(T)));
-    pool.memmap[count].emplace_back(mem, true);
-    pool.allocated[mem] = count;
-    return mem;
-  }
+  return static_cast<T*>(get_pinned_mempool().allocate(count*sizeof(T)));
 }
 
 /** Release memory that you got with get_pinned_memory. */
 template <typename T>
 void release_pinned_memory(T* mem) {
-  auto& pool = get_pinned_mempool<T>();
-#if AL_LOCK_MEMPOOL
-  std::lock_guard<std::mutex> lock(pool.lock);
-#endif
-  size_t count = pool.allocated[mem];
-  pool.allocated.erase(mem);
-  // Find the entry.
-  for (auto&& entry : pool.memmap[count]) {
-    if (entry.first == mem) {
-      entry.second = false;
-      return;
-    }
-  }
+  get_pinned_mempool().release(mem);
 }
 
 #endif  // AL_HAS_CUDA
@@ -50,14 +50,14 @@ class HostTransferState : public AlState {
     compute_stream(comm.get_stream()) {
 #ifdef AL_HT_USE_PASSTHROUGH
     host_ar = new mpi::MPIPassthroughAlState<T>(
-      IN_PLACE<T>(), host_mem, count, op, comm, get_free_request());
+      IN_PLACE<T>(), host_mem, count, op, comm, NULL_REQUEST);
 #else
     if (count <= 1<<9) {
       host_ar = new mpi::MPIRecursiveDoublingAlState<T>(
-        IN_PLACE<T>(), host_mem, count, op, comm, get_free_request());
+        IN_PLACE<T>(), host_mem, count, op, comm, NULL_REQUEST);
     } else {
       host_ar = new mpi::MPIRabenseifnerAlState<T>(
-        IN_PLACE<T>(), host_mem, count, op, comm, get_free_request());
+        IN_PLACE<T>(), host_mem, count, op, comm, NULL_REQUEST);
     }
 #endif
 
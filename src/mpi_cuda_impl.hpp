@@ -583,7 +583,7 @@ class MPICUDABackend {
     }
 #endif // 0
     internal::mpi_cuda::HostTransferState<T>* state = new internal::mpi_cuda::HostTransferState<T>(
-      sendbuf, recvbuf, count, op, comm, internal_stream, internal::get_free_request());
+      sendbuf, recvbuf, count, op, comm, internal_stream, internal::NULL_REQUEST);
     internal::get_progress_engine()->enqueue(state);
   }
 
@@ -25,6 +25,8 @@
 // permissions and limitations under the license.
 ////////////////////////////////////////////////////////////////////////////////
 
+#include <cstdlib>
+#include <string>
 #include "Al.hpp"
 
 namespace Al {
@@ -36,6 +38,32 @@ namespace {
 bool initialized_mpi = false;
 // Maximum tag value in MPI.
 int max_tag = 0;
+// MPI datatypes for 16-bit floating point types.
+MPI_Datatype float16_type = MPI_DATATYPE_NULL;
+MPI_Datatype bfloat16_type = MPI_DATATYPE_NULL;
+// Number of reduction operators supported on floating point types; these
+// come first in ReductionOperator.
+constexpr size_t num_half_float_ops = 7;
+// MPI operators for 16-bit floating point types, by ReductionOperator.
+MPI_Op half_float_ops[num_half_float_ops];
+// Whether ring allreduces of 16-bit floating point types keep partial
+// results in float.
+bool fp32_partials = false;
+
+/** MPI user function applying Op to 16-bit floating point types. */
+template <ReductionOperator Op>
+void half_float_op(void* invec, void* inoutvec, int* len,
+                   MPI_Datatype* type) {
+  if (*type == float16_type) {
+    get_reduction_kernel<float16>(Op)(
+      static_cast<const float16*>(invec), static_cast<float16*>(inoutvec),
+      *len);
+  } else {
+    get_reduction_kernel<bfloat16>(Op)(
+      static_cast<const bfloat16*>(invec), static_cast<bfloat16*>(inoutvec),
+      *len);
+  }
+}
 }
 
 void init(int& argc, char**& argv) {
@@ -60,11 +88,38 @@ void init(int& argc, char**& argv) {
   int* p;
   MPI_Comm_get_attr(MPI_COMM_WORLD, MPI_TAG_UB, &p, &flag);
   max_tag = *p;
+  // MPI does not know 16-bit floating point types, so send them as bytes and
+  // reduce them with our own kernels.
+  MPI_Type_contiguous(sizeof(float16), MPI_BYTE, &float16_type);
+  MPI_Type_commit(&float16_type);
+  MPI_Type_contiguous(sizeof(bfloat16), MPI_BYTE, &bfloat16_type);
+  MPI_Type_commit(&bfloat16_type);
+  MPI_User_function* half_float_fns[num_half_float_ops] = {
+    &half_float_op<ReductionOperator::sum>,
+    &half_float_op<ReductionOperator::prod>,
+    &half_float_op<ReductionOperator::min>,
+    &half_float_op<ReductionOperator::max>,
+    &half_float_op<ReductionOperator::lor>,
+    &half_float_op<ReductionOperator::land>,
+    &half_float_op<ReductionOperator::lxor>
+  };
+  for (size_t i = 0; i < num_half_float_ops; ++i) {
+    MPI_Op_create(half_float_fns[i], 1, &half_float_ops[i]);
+  }
+  fp32_partials = get_env_size("AL_MPI_HALF_FP32_PARTIALS",
+                               AL_MPI_HALF_FP32_PARTIALS);
 }
 
 void finalize() {
   int flag;
   MPI_Finalized(&flag);
+  if (!flag) {
+    for (size_t i = 0; i < num_half_float_ops; ++i) {
+      MPI_Op_free(&half_float_ops[i]);
+    }
+    MPI_Type_free(&float16_type);
+    MPI_Type_free(&bfloat16_type);
+  }
   if (!flag && initialized_mpi) {
     MPI_Finalize();
   }
@@ -72,6 +127,20 @@ void finalize() {
 
 int get_max_tag() { return max_tag; }
 
+MPI_Datatype get_float16_type() { return float16_type; }
+MPI_Datatype get_bfloat16_type() { return bfloat16_type; }
+
+MPI_Op get_half_float_op(ReductionOperator op) {
+  const size_t i = static_cast<size_t>(op);
+  if (i >= num_half_float_ops) {
+    throw_al_exception("Reduction operator not supported for floating point "
+                       "types");
+  }
+  return half_float_ops[i];
+}
+
+bool use_fp32_partials() { return fp32_partials; }
+
 }  // namespace mpi
 }  // namespace internal
 }  // namespace Al
@@ -34,6 +34,7 @@
 #include "internal.hpp"
 #include "progress.hpp"
 #include "mempool.hpp"
+#include "reduction_kernels.hpp"
 
 namespace Al {
 
@@ -70,7 +71,11 @@ class MPICommunicator : public Communicator {
       //MPI_Comm_free(&local_comm);
     }
   }
-  Communicator* copy() const override { return new MPICommunicator(comm); }
+  Communicator* copy() const override {
+    MPICommunicator* c = new MPICommunicator(comm);
+    c->set_progress_mode(progress_mode);
+    return c;
+  }
   int rank() const override { return rank_in_comm; }
   int size() const override { return size_of_comm; }
   MPI_Comm get_comm() const { return comm; }
@@ -85,6 +90,13 @@ class MPICommunicator : public Communicator {
     }
     return tag;
   }
+  /** Return the progress mode used by non-blocking operations by default. */
+  ProgressMode get_progress_mode() const { return progress_mode; }
+  /**
+   * Set the progress mode used by non-blocking operations that do not specify
+   * one. automatic is treated as engine.
+   */
+  void set_progress_mode(ProgressMode mode) { progress_mode = mode; }
 
  private:
   /** Associated MPI communicator. */
@@ -106,6 +118,8 @@ class MPICommunicator : public Communicator {
   static constexpr int starting_free_tag = 10;
   /** Free tag for communication. */
   int free_tag = starting_free_tag;
+  /** Default progress mode for non-blocking operations. */
+  ProgressMode progress_mode = ProgressMode::engine;
 };
 
 namespace internal {
@@ -116,6 +130,21 @@ void init(int& argc, char**& argv);
 /** MPI finalization. */
 void finalize();
 
+/**
+ * Return the MPI datatypes for 16-bit floating point types, created by init.
+ * MPI has no reductions on these, so they are only usable with operators from
+ * get_half_float_op.
+ */
+MPI_Datatype get_float16_type();
+MPI_Datatype get_bfloat16_type();
+/** Return an MPI operator applying op to 16-bit floating point types. */
+MPI_Op get_half_float_op(ReductionOperator op);
+/**
+ * Whether ring allreduces of 16-bit floating point types keep partial results
+ * in float. This is set from AL_MPI_HALF_FP32_PARTIALS by init.
+ */
+bool use_fp32_partials();
+
 /** Used to map types to the associated MPI datatype. */
 template <typename T>
 inline MPI_Datatype TypeMap();
@@ -133,6 +162,8 @@ template <> inline MPI_Datatype TypeMap<unsigned long long int>() { return MPI_U
 template <> inline MPI_Datatype TypeMap<float>() { return MPI_FLOAT; }
 template <> inline MPI_Datatype TypeMap<double>() { return MPI_DOUBLE; }
 template <> inline MPI_Datatype TypeMap<long double>() { return MPI_LONG_DOUBLE; }
+template <> inline MPI_Datatype TypeMap<float16>() { return get_float16_type(); }
+template <> inline MPI_Datatype TypeMap<bfloat16>() { return get_bfloat16_type(); }
 
 /** True if count elements can be sent by MPI. */
 inline bool check_count_fits_mpi(size_t count) {
@@ -145,260 +176,24 @@ inline void assert_count_fits_mpi(size_t count) {
   }
 }
 
-/** Basic sum reduction. */
-template <typename T>
-void sum_reduction(const T* src, T* dest, size_t count) {
-#if AL_MPI_USE_OPENMP
-  if (count >= AL_MPI_MULTITHREAD_SUM_THRESH) {
-    #pragma omp parallel for
-    for (size_t i = 0; i < count; ++i) {
-      dest[i] += src[i];
-    }
-  } else {
-    for (size_t i = 0; i < count; ++i) {
-      dest[i] += src[i];
-    }
-  }
-#else
-  for (size_t i = 0; i < count; ++i) {
-    dest[i] += src[i];
-  }
-#endif
-}
-/** Basic prod reduction. */
-template <typename T>
-void prod_reduction(const T* src, T* dest, size_t count) {
-#if AL_MPI_USE_OPENMP
-  if (count >= AL_MPI_MULTITHREAD_PROD_THRESH) {
-    #pragma omp parallel for
-    for (size_t i = 0; i < count; ++i) {
-      dest[i] *= src[i];
-    }
-  } else {
-    for (size_t i = 0; i < count; ++i) {
-      dest[i] *= src[i];
-    }
-  }
-#else
-  for (size_t i = 0; i < count; ++i) {
-    dest[i] *= src[i];
-  }
-#endif
-}
-/** Basic min reduction. */
-template <typename T>
-void min_reduction(const T* src, T* dest, size_t count) {
-#if AL_MPI_USE_OPENMP
-  if (count >= AL_MPI_MULTITHREAD_MINMAX_THRESH) {
-    #pragma omp parallel for
-    for (size_t i = 0; i < count; ++i) {
-      dest[i] = std::min(dest[i], src[i]);
-    }
-  } else {
-    for (size_t i = 0; i < count; ++i) {
-      dest[i] = std::min(dest[i], src[i]);
-    }
-  }
-#else
-  for (size_t i = 0; i < count; ++i) {
-    dest[i] = std::min(dest[i], src[i]);
-  }
-#endif
-}
-/** Basic max reduction. */
-template <typename T>
-void max_reduction(const T* src, T* dest, size_t count) {
-#if AL_MPI_USE_OPENMP
-  if (count >= AL_MPI_MULTITHREAD_MINMAX_THRESH) {
-    #pragma omp parallel for
-    for (size_t i = 0; i < count; ++i) {
-      dest[i] = std::max(dest[i], src[i]);
-    }
-  } else {
-    for (size_t i = 0; i < count; ++i) {
-      dest[i] = std::max(dest[i], src[i]);
-    }
-  }
-#else
-  for (size_t i = 0; i < count; ++i) {
-    dest[i] = std::max(dest[i], src[i]);
-  }
-#endif
-}
-/** Basic logical OR reduction. */
-template <typename T>
-void lor_reduction(const T* src, T* dest, size_t count) {
-#if AL_MPI_USE_OPENMP
-  if (count >= AL_MPI_MULTITHREAD_LOGICAL_THRESH) {
-    #pragma omp parallel for
-    for (size_t i = 0; i < count; ++i) {
-      dest[i] = src[i] || dest[i];
-    }
-  } else {
-    for (size_t i = 0; i < count; ++i) {
-      dest[i] = src[i] || dest[i];
-    }
-  }
-#else
-  for (size_t i = 0; i < count; ++i) {
-    dest[i] = src[i] || dest[i];
-  }
-#endif
-}
-/** Basic logical AND reduction. */
-template <typename T>
-void land_reduction(const T* src, T* dest, size_t count) {
-#if AL_MPI_USE_OPENMP
-  if (count >= AL_MPI_MULTITHREAD_LOGICAL_THRESH) {
-    #pragma omp parallel for
-    for (size_t i = 0; i < count; ++i) {
-      dest[i] = src[i] && dest[i];
-    }
-  } else {
-    for (size_t i = 0; i < count; ++i) {
-      dest[i] = src[i] && dest[i];
-    }
-  }
-#else
-  for (size_t i = 0; i < count; ++i) {
-    dest[i] = src[i] && dest[i];
-  }
-#endif
-}
-/** Basic logical XOR reduction. */
-template <typename T>
-void lxor_reduction(const T* src, T* dest, size_t count) {
-#if AL_MPI_USE_OPENMP
-  if (count >= AL_MPI_MULTITHREAD_LOGICAL_THRESH) {
-    #pragma omp parallel for
-    for (size_t i = 0; i < count; ++i) {
-      dest[i] = !src[i] != !dest[i];
-    }
-  } else {
-    for (size_t i = 0; i < count; ++i) {
-      dest[i] = !src[i] != !dest[i];
-    }
-  }
-#else
-  for (size_t i = 0; i < count; ++i) {
-    dest[i] = !src[i] != !dest[i];
-  }
-#endif
-}
-/** Basic bitwise OR reduction. */
-template <typename T>
-void bor_reduction(const T* src, T* dest, size_t count) {
-#if AL_MPI_USE_OPENMP
-  if (count >= AL_MPI_MULTITHREAD_BITWISE_THRESH) {
-    #pragma omp parallel for
-    for (size_t i = 0; i < count; ++i) {
-      dest[i] = src[i] | dest[i];
-    }
-  } else {
-    for (size_t i = 0; i < count; ++i) {
-      dest[i] = src[i] | dest[i];
-    }
-  }
-#else
-  for (size_t i = 0; i < count; ++i) {
-    dest[i] = src[i] | dest[i];
-  }
-#endif
-}
-/** Basic bitwise AND reduction. */
-template <typename T>
-void band_reduction(const T* src, T* dest, size_t count) {
-#if AL_MPI_USE_OPENMP
-  if (count >= AL_MPI_MULTITHREAD_BITWISE_THRESH) {
-    #pragma omp parallel for
-    for (size_t i = 0; i < count; ++i) {
-      dest[i] = src[i] & dest[i];
-    }
-  } else {
-    for (size_t i = 0; i < count; ++i) {
-      dest[i] = src[i] & dest[i];
-    }
-  }
-#else
-  for (size_t i = 0; i < count; ++i) {
-    dest[i] = src[i] & dest[i];
-  }
-#endif
-}
-/** Basic bitwise XOR reduction. */
+/**
+ * Return the associated reduction function for an operator.
+ * This uses the vectorized kernel selected for the CPU at initialization.
+ * The result is a plain function pointer, so calls on small slices do not
+ * pay for a std::function indirection.
+ */
 template <typename T>
-void bxor_reduction(const T* src, T* dest, size_t count) {
-#if AL_MPI_USE_OPENMP
-  if (count >= AL_MPI_MULTITHREAD_BITWISE_THRESH) {
-    #pragma omp parallel for
-    for (size_t i = 0; i < count; ++i) {
-      dest[i] = src[i] ^ dest[i];
-    }
-  } else {
-    for (size_t i = 0; i < count; ++i) {
-      dest[i] = src[i] ^ dest[i];
-    }
-  }
-#else
-  for (size_t i = 0; i < count; ++i) {
-    dest[i] = src[i] ^ dest[i];
-  }
-#endif
-}
-// Binary operations are not supported on floating point types.
-template <>
-inline void bor_reduction<float>(const float*, float*, size_t) {
-  throw_al_exception("BOR not supported for float");
-}
-template <>
-inline void band_reduction<float>(const float*, float*, size_t) {
-  throw_al_exception("BAND not supported for float");
-}
-template <>
-inline void bxor_reduction<float>(const float*, float*, size_t) {
-  throw_al_exception("BXOR not supported for float");
-}
-template <>
-inline void bor_reduction<double>(const double*, double*, size_t) {
-  throw_al_exception("BOR not supported for double");
-}
-template <>
-inline void band_reduction<double>(const double*, double*, size_t) {
-  throw_al_exception("BAND not supported for double");
-}
-template <>
-inline void bxor_reduction<double>(const double*, double*, size_t) {
-  throw_al_exception("BXOR not supported for double");
+inline ReductionKernel<T> ReductionMap(ReductionOperator op) {
+  return get_reduction_kernel<T>(op);
 }
 
-/** Return the associated reduction function for an operator. */
+/**
+ * Return the function that sets dest to in reduced with src for an operator,
+ * used to reduce and copy input in one pass: (src, in, dest, count).
+ */
 template <typename T>
-inline std::function<void(const T*, T*, size_t)> ReductionMap(
-  ReductionOperator op) {
-  switch (op) {
-  case ReductionOperator::sum:
-    return sum_reduction<T>;
-  case ReductionOperator::prod:
-    return prod_reduction<T>;
-  case ReductionOperator::min:
-    return min_reduction<T>;
-  case ReductionOperator::max:
-    return max_reduction<T>;
-  case ReductionOperator::lor:
-    return lor_reduction<T>;
-  case ReductionOperator::land:
-    return land_reduction<T>;
-  case ReductionOperator::lxor:
-    return lxor_reduction<T>;
-  case ReductionOperator::bor:
-    return bor_reduction<T>;
-  case ReductionOperator::band:
-    return band_reduction<T>;
-  case ReductionOperator::bxor:
-    return bxor_reduction<T>;
-  default:
-    throw_al_exception("Reduction operator not supported");
-  }
+inline CopyReductionKernel<T> CopyReductionMap(ReductionOperator op) {
+  return get_copy_reduction_kernel<T>(op);
 }
 
 /** Convert a ReductionOperator to the corresponding MPI_Op. */
@@ -429,9 +224,34 @@ inline MPI_Op ReductionOperator2MPI_Op(ReductionOperator op) {
   }
 }
 
+/** Return the MPI_Op for op on T. */
+template <typename T>
+inline MPI_Op MPIOpMap(ReductionOperator op) {
+  return ReductionOperator2MPI_Op(op);
+}
+template <> inline MPI_Op MPIOpMap<float16>(ReductionOperator op) {
+  return get_half_float_op(op);
+}
+template <> inline MPI_Op MPIOpMap<bfloat16>(ReductionOperator op) {
+  return get_half_float_op(op);
+}
+
 /** Default tag for blocking operations. */
 constexpr int default_tag = 0;
 
+/**
+ * Hand a non-blocking operation's state to the progress engine, or start it
+ * in the calling thread if mode is caller.
+ */
+inline void submit_state(AlState* state, ProgressMode mode) {
+  ProgressEngine* pe = get_progress_engine();
+  if (mode == ProgressMode::caller) {
+    pe->run_inline(state);
+  } else {
+    pe->enqueue(state);
+  }
+}
+
 /** Base state class for MPI allreduces. */
 template <typename T>
 class MPIAlState : public AlState {
@@ -440,10 +260,11 @@ class MPIAlState : public AlState {
              ReductionOperator op_, Communicator& comm_,
              AlRequest req_) :
     AlState(req_), sendbuf(sendbuf_), recvbuf(recvbuf_), recv_to(nullptr),
-    count(count_) {
+    count(count_), quota_key(&comm_) {
     comm = dynamic_cast<MPICommunicator&>(comm_).get_comm();
     type = TypeMap<T>();
     reduction_op = ReductionMap<T>(op_);
+    copy_reduction_op = CopyReductionMap<T>(op_);
     rank = comm_.rank();
     nprocs = comm_.size();
     tag = dynamic_cast<MPICommunicator&>(comm_).get_free_tag();
@@ -456,17 +277,18 @@ class MPIAlState : public AlState {
   /**
    * Performs generic setup and checks.
    * If the allreduce is completed immediately, returns true.
+   * sendbuf is not copied to recvbuf: algorithms send from input() until
+   * they have reduced into recvbuf, and copy with their first reductions.
    */
   virtual bool setup() {
     if (count == 0) {
       return true;  // Nothing to do.
     }
     assert_count_fits_mpi(count);
-    if (sendbuf != IN_PLACE<T>()) {
-      // Copy data to the receive buffer.
-      std::copy_n(sendbuf, count, recvbuf);
-    }
     if (nprocs == 1) {
+      if (sendbuf != IN_PLACE<T>()) {
+        std::copy_n(sendbuf, count, recvbuf);
+      }
       return true;  // Only needed to copy data.
     }
     return false;
@@ -478,6 +300,23 @@ class MPIAlState : public AlState {
       + std::to_string(count) + " "
       + std::to_string(tag);
   }
+  /**
+   * Run setup when the progress engine starts the operation instead of when
+   * it is submitted, so it sees its dependencies' results.
+   */
+  void defer_setup() { setup_deferred = true; }
+  void start() override {
+    AlState::start();
+    if (setup_deferred) {
+      finished_in_setup = setup();
+    }
+  }
+  size_t get_bytes() const override { return count * sizeof(T); }
+  const void* get_quota_key() const override { return quota_key; }
+  MPI_Request* get_mpi_requests(size_t& num_reqs) override {
+    num_reqs = 2;
+    return send_recv_reqs;
+  }
  protected:
   /** Local rank. */
   int rank;
@@ -493,10 +332,14 @@ class MPIAlState : public AlState {
   size_t count;
   /** Communicator for the allreduce. */
   MPI_Comm comm;
+  /** Identifies the communicator for per-communicator admission quotas. */
+  const void* quota_key;
   /** MPI datatype for T. */
   MPI_Datatype type;
   /** Reduction operator to use. */
-  std::function<void(const T*, T*, size_t)> reduction_op;
+  ReductionKernel<T> reduction_op;
+  /** Reduction operator that also copies its input; see reduce_recv. */
+  CopyReductionKernel<T> copy_reduction_op;
   /**
    * Tag to use for MPI operations.
    * This is selected to avoid interference with other allreduces.
@@ -504,23 +347,80 @@ class MPIAlState : public AlState {
   int tag;
   /** Requests for send_recv. */
   MPI_Request send_recv_reqs[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+  /** Base number of elements per slice, when split into slices. */
+  size_t slice_size = 0;
+  /** Number of leading slices that get one extra element. */
+  size_t slice_remainder = 0;
+  /** Whether setup is run by start. */
+  bool setup_deferred = false;
+  /** Set if a deferred setup completed the allreduce; step just completes. */
+  bool finished_in_setup = false;
 #ifdef AL_DEBUG_HANG_CHECK
   bool hang_reported = false;
   double send_recv_start = std::numeric_limits<double>::max();
 #endif
 
+  /**
+   * Split the data into num_slices slices as evenly as possible.
+   * The remainder goes to the first slices. Slice boundaries are computed on
+   * demand rather than stored, to avoid allocating per operation.
+   */
+  void init_slices(size_t num_slices) {
+    slice_size = count / num_slices;
+    slice_remainder = count % num_slices;
+  }
+  /** Return the number of elements in slice i. */
+  size_t slice_len(size_t i) const {
+    return slice_size + (i < slice_remainder ? 1 : 0);
+  }
+  /** Return the index one past the end of slice i. */
+  size_t slice_end(size_t i) const {
+    return (i + 1)*slice_size + std::min(i + 1, slice_remainder);
+  }
+  /** Return the index of the start of slice i. */
+  size_t slice_start(size_t i) const {
+    return i*slice_size + std::min(i, slice_remainder);
+  }
+  /** Return the local data, before any of it is reduced into recvbuf. */
+  const T* input() const {
+    return sendbuf == IN_PLACE<T>() ? recvbuf : sendbuf;
+  }
+  /**
+   * Reduce n elements of recv_to into recvbuf + offset. If first, nothing
+   * has been reduced into that range yet, so the local data is read from
+   * input(), copying it to recvbuf in the same pass.
+   */
+  void reduce_recv(size_t offset, size_t n, bool first) {
+    if (first) {
+      copy_reduction_op(recv_to, input() + offset, recvbuf + offset, n);
+    } else {
+      reduction_op(recv_to, recvbuf + offset, n);
+    }
+  }
+
   /** Start a send/recv. */
   void start_send_recv(
     const void* send, int send_count, int dest,
     void* recv, int recv_count, int source) {
-    MPI_Irecv(recv, recv_count, type, source, tag, comm, &(send_recv_reqs[0]));
-    MPI_Isend(send, send_count, type, dest, tag, comm, &(send_recv_reqs[1]));
+    start_send_recv(send, send_count, dest, recv, recv_count, source, type);
+  }
+  /** Start a send/recv of elements of datatype dt instead of T. */
+  void start_send_recv(
+    const void* send, int send_count, int dest,
+    void* recv, int recv_count, int source, MPI_Datatype dt) {
+    MPI_Irecv(recv, recv_count, dt, source, tag, comm, &(send_recv_reqs[0]));
+    MPI_Isend(send, send_count, dt, dest, tag, comm, &(send_recv_reqs[1]));
 #ifdef AL_DEBUG_HANG_CHECK
     send_recv_start = get_time();
 #endif
   }
   /** Return true if the outstanding send/recv has completed. */
   bool test_send_recv() {
+    // The progress engine may have already completed them.
+    if (send_recv_reqs[0] == MPI_REQUEST_NULL
+        && send_recv_reqs[1] == MPI_REQUEST_NULL) {
+      return true;
+    }
     int flag;
     MPI_Testall(2, send_recv_reqs, &flag, MPI_STATUSES_IGNORE);
 #ifdef AL_DEBUG_HANG_CHECK
@@ -538,13 +438,32 @@ class MPIAlState : public AlState {
   }
 };
 
+/**
+ * Set up state and submit it for execution. If deps is not null, setup is
+ * deferred until the operations of deps have completed.
+ */
+template <typename T>
+void submit_allreduce(MPIAlState<T>* state, AlRequest& req,
+                      OpPriority priority, ProgressMode mode,
+                      const std::vector<AlRequest>* deps) {
+  state->set_priority(priority);
+  if (deps != nullptr) {
+    state->set_dependencies(*deps);
+    state->defer_setup();
+  } else if (state->setup()) {
+    release_request(req);
+    return;
+  }
+  submit_state(state, mode);
+}
+
 /** Just call MPI_Allreduce directly. */
 template <typename T>
 void passthrough_allreduce(const T* sendbuf, T* recvbuf, size_t count,
                            ReductionOperator op, Communicator& comm) {
   MPI_Comm mpi_comm = dynamic_cast<MPICommunicator&>(comm).get_comm();
   MPI_Datatype type = TypeMap<T>();
-  MPI_Op mpi_op = ReductionOperator2MPI_Op(op);
+  MPI_Op mpi_op = MPIOpMap<T>(op);
   if (sendbuf == IN_PLACE<T>()) {
     MPI_Allreduce(MPI_IN_PLACE, recvbuf, count, type, mpi_op, mpi_comm);
   } else {
@@ -559,7 +478,7 @@ class MPIPassthroughAlState : public MPIAlState<T> {
     const T* sendbuf_, T* recvbuf_, size_t count_,
     ReductionOperator op_, Communicator& comm_, AlRequest req_) :
     MPIAlState<T>(sendbuf_, recvbuf_, count_, op_, comm_, req_) {
-    mpi_op = ReductionOperator2MPI_Op(op_);
+    mpi_op = MPIOpMap<T>(op_);
   }
   bool setup() override {
     // Don't need to call the parent. Just start the MPI allreduce.
@@ -581,6 +500,10 @@ class MPIPassthroughAlState : public MPIAlState<T> {
     return PEAction::cont;
   }
   std::string get_name() const override { return "MPIPassthrough"; }
+  MPI_Request* get_mpi_requests(size_t& num_reqs) override {
+    num_reqs = 1;
+    return &mpi_req;
+  }
  private:
   MPI_Op mpi_op;
   MPI_Request mpi_req;
@@ -590,14 +513,25 @@ class MPIPassthroughAlState : public MPIAlState<T> {
 template <typename T>
 void nb_passthrough_allreduce(const T* sendbuf, T* recvbuf, size_t count,
                               ReductionOperator op, Communicator& comm,
-                              AlRequest& req) {
+                              AlRequest& req,
+                              OpPriority priority = OpPriority::normal,
+                              ProgressMode mode = ProgressMode::engine,
+                              const std::vector<AlRequest>* deps = nullptr) {
+  if (deps != nullptr) {
+    // Every rank must call MPI_Iallreduce in the same order, so wait for the
+    // dependencies here instead of deferring the call.
+    ProgressEngine* pe = get_progress_engine();
+    for (AlRequest dep : *deps) {
+      pe->wait_for_completion(dep);
+    }
+  }
   req = get_free_request();
   MPIPassthroughAlState<T>* state =
     new MPIPassthroughAlState<T>(
       sendbuf, recvbuf, count, op, comm, req);
+  state->set_priority(priority);
   state->setup();
-  ProgressEngine* pe = get_progress_engine();
-  pe->enqueue(state);
+  submit_state(state, mode);
 }
 
 /** Use a recursive-doubling algorithm to perform the allreduce. */
@@ -610,16 +544,21 @@ void recursive_doubling_allreduce(const T* sendbuf, T* recvbuf, size_t count,
   int rank = comm.rank();
   int nprocs = comm.size();
   MPI_Comm mpi_comm = dynamic_cast<MPICommunicator&>(comm).get_comm();
-  if (sendbuf != IN_PLACE<T>()) {
-    // Copy our data into the receive buffer.
-    std::copy_n(sendbuf, count, recvbuf);
+  if (nprocs == 1) {
+    if (sendbuf != IN_PLACE<T>()) {
+      std::copy_n(sendbuf, count, recvbuf);
+    }
+    return;  // Only needed to copy data.
   }
-  if (nprocs == 1) return;  // Only needed to copy data.
+  // Our data is not copied to recvbuf; the first reduction does that.
+  const T* input = sendbuf == IN_PLACE<T>() ? recvbuf : sendbuf;
+  bool reduced = false;
   // TODO: Shared memory optimization.
   MPI_Datatype type = TypeMap<T>();
   unsigned int mask = 1;
   T* recv_to = get_memory<T>(count);
   auto reduction_op = ReductionMap<T>(op);
+  auto copy_reduction_op = CopyReductionMap<T>(op);
   // Check if we are in a non-power-of-2 case.
   // First find the nearest power-of-2 <= nprocs.
   int pow2 = 1;
@@ -634,11 +573,12 @@ void recursive_doubling_allreduce(const T* sendbuf, T* recvbuf, size_t count,
     // The even processes will not participate until the end.
     // There is a power-of-2 number of remaining processes.
     if (rank % 2 == 0) {
-      MPI_Send(recvbuf, count, type, rank + 1, tag, mpi_comm);
+      MPI_Send(input, count, type, rank + 1, tag, mpi_comm);
       rank = -1;  // Don't participate.
     } else {
       MPI_Recv(recv_to, count, type, rank - 1, tag, mpi_comm, MPI_STATUS_IGNORE);
-      reduction_op(recv_to, recvbuf, count);
+      copy_reduction_op(recv_to, input, recvbuf, count);
+      reduced = true;
       rank /= 2;  // Change our rank.
     }
   } else {
@@ -650,10 +590,15 @@ void recursive_doubling_allreduce(const T* sendbuf, T* recvbuf, size_t count,
     int partner = (adjusted_partner < pow2_remainder) ?
       adjusted_partner * 2 + 1 :
       adjusted_partner + pow2_remainder;
-    MPI_Sendrecv(recvbuf, count, type, partner, tag,
+    MPI_Sendrecv(reduced ? recvbuf : input, count, type, partner, tag,
                  recv_to, count, type, partner, tag,
                  mpi_comm, MPI_STATUS_IGNORE);
-    reduction_op(recv_to, recvbuf, count);
+    if (reduced) {
+      reduction_op(recv_to, recvbuf, count);
+    } else {
+      copy_reduction_op(recv_to, input, recvbuf, count);
+      reduced = true;
+    }
     mask <<= 1;
   }
   // In the non-power-of-2 case, the even ranks need to get their data.
@@ -687,7 +632,7 @@ class MPIRecursiveDoublingAlState : public MPIAlState<T> {
       // Adjust rank and start a send/recv for the data if needed.
       if (this->rank < 2 * pow2_remainder) {
         if (this->rank % 2 == 0) {
-          MPI_Isend(this->recvbuf, this->count, this->type, this->rank + 1,
+          MPI_Isend(this->input(), this->count, this->type, this->rank + 1,
                     this->tag, this->comm, &(this->send_recv_reqs[0]));
           adjusted_rank = -1;  // Don't participate.
         } else {
@@ -703,13 +648,17 @@ class MPIRecursiveDoublingAlState : public MPIAlState<T> {
     return r;
   }
   PEAction step() override {
+    if (this->finished_in_setup) {
+      return PEAction::complete;
+    }
     // Check the send/recv from setup, if any.
     if (!setup_comm_done) {
       if (this->test_send_recv()) {
         setup_comm_done = true;
         if (this->rank % 2) {
           // We received, need to reduce the data into our local buffer.
-          this->reduction_op(this->recv_to, this->recvbuf, this->count);
+          this->reduce_recv(0, this->count, true);
+          reduced = true;
         }
       } else {
         return PEAction::cont;
@@ -729,7 +678,8 @@ class MPIRecursiveDoublingAlState : public MPIAlState<T> {
     bool test = this->test_send_recv();
     if (started && test) {
       // Send completed, reduce and update state.
-      this->reduction_op(this->recv_to, this->recvbuf, this->count);
+      this->reduce_recv(0, this->count, !reduced);
+      reduced = true;
       mask <<= 1;
       if (mask >= static_cast<unsigned int>(pow2)) {
         // Done, but in the non-power-of-2 case we need to send to our partner.
@@ -749,7 +699,8 @@ class MPIRecursiveDoublingAlState : public MPIAlState<T> {
       const int partner = (adjusted_partner < pow2_remainder) ?
         adjusted_partner * 2 + 1 :
         adjusted_partner + pow2_remainder;
-      this->start_send_recv(this->recvbuf, this->count, partner,
+      this->start_send_recv(reduced ? this->recvbuf : this->input(),
+                            this->count, partner,
                             this->recv_to, this->count, partner);
       started = true;
     }
@@ -761,6 +712,8 @@ class MPIRecursiveDoublingAlState : public MPIAlState<T> {
   unsigned int mask = 1;
   /** Whether communication has started. */
   bool started = false;
+  /** Whether received data has been reduced into recvbuf. */
+  bool reduced = false;
   /** Whether the send/recv from non-power-of-2 setup has completed. */
   bool setup_comm_done = false;
   /** Whether the final send/recv from the non-power-of-2 case has started. */
@@ -780,17 +733,123 @@ class MPIRecursiveDoublingAlState : public MPIAlState<T> {
 template <typename T>
 void nb_recursive_doubling_allreduce(const T* sendbuf, T* recvbuf, size_t count,
                                      ReductionOperator op, Communicator& comm,
-                                     AlRequest& req) {
+                                     AlRequest& req,
+                                     OpPriority priority = OpPriority::normal,
+                                     ProgressMode mode = ProgressMode::engine,
+                                     const std::vector<AlRequest>* deps = nullptr) {
   req = get_free_request();
   MPIRecursiveDoublingAlState<T>* state =
     new MPIRecursiveDoublingAlState<T>(
       sendbuf, recvbuf, count, op, comm, req);
-  if (state->setup()) {
-    req = NULL_REQUEST;
-    return;
+  submit_allreduce(state, req, priority, mode, deps);
+}
+
+/**
+ * Ring allreduce of a 16-bit floating point type that keeps partial results
+ * in float: the reduce-scatter sends float partial results after the first
+ * step, and only each final result is rounded to T before the allgather.
+ * This is the single-ring ring_allreduce, with twice the reduce-scatter
+ * traffic in exchange for rounding once instead of at every step.
+ * This requires nprocs > 1.
+ */
+template <typename T>
+void wide_ring_allreduce(const T* sendbuf, T* recvbuf, size_t count,
+                         ReductionOperator op, Communicator& comm,
+                         const int tag) {
+  int rank = comm.rank();
+  int nprocs = comm.size();
+  MPI_Comm mpi_comm = dynamic_cast<MPICommunicator&>(comm).get_comm();
+  // As in ring_allreduce, our data is not copied to recvbuf.
+  const T* input = sendbuf == IN_PLACE<T>() ? recvbuf : sendbuf;
+  // Compute the slices of data to be moved.
+  const size_t size_per_rank = count / nprocs;
+  const size_t remainder = count % nprocs;
+  std::vector<size_t> slice_lengths(nprocs, size_per_rank);
+  // Add in the remainder as evenly as possible.
+  for (size_t i = 0; i < remainder; ++i) {
+    slice_lengths[i] += 1;
+  }
+  std::vector<size_t> slice_ends(nprocs);
+  std::partial_sum(slice_lengths.begin(), slice_lengths.end(),
+                   slice_ends.begin());
+  MPI_Datatype type = TypeMap<T>();
+  // The first step exchanges input, later ones float partial results.
+  T* recv_input = get_memory<T>(slice_lengths[0]);
+  float* recv_partial = get_memory<float>(slice_lengths[0]);
+  float* partial = get_memory<float>(slice_lengths[0]);
+  auto first_op = get_wide_reduction_kernel<T, T, float>(op);
+  auto partial_op = get_wide_reduction_kernel<T, float, float>(op);
+  auto last_op = get_wide_reduction_kernel<T, float, T>(op);
+  const int src = (rank - 1 + nprocs) % nprocs;
+  const int dst = (rank + 1) % nprocs;
+  // Ring reduce-scatter.
+  for (int step = 0; step < nprocs - 1; ++step) {
+    const int send_idx = (rank - step + nprocs) % nprocs;
+    const int recv_idx = (rank - step - 1 + nprocs) % nprocs;
+    const size_t recv_start = slice_ends[recv_idx] - slice_lengths[recv_idx];
+    const size_t recv_len = slice_lengths[recv_idx];
+    if (step == 0) {
+      MPI_Sendrecv(input + (slice_ends[send_idx] - slice_lengths[send_idx]),
+                   slice_lengths[send_idx], type, dst, tag,
+                   recv_input, recv_len, type, src, tag,
+                   mpi_comm, MPI_STATUS_IGNORE);
+    } else {
+      // The send completes before partial is overwritten below.
+      MPI_Sendrecv(partial, slice_lengths[send_idx], MPI_FLOAT, dst, tag,
+                   recv_partial, recv_len, MPI_FLOAT, src, tag,
+                   mpi_comm, MPI_STATUS_IGNORE);
+    }
+    if (step < nprocs - 2) {
+      if (step == 0) {
+        first_op(recv_input, input + recv_start, partial, recv_len);
+      } else {
+        partial_op(recv_partial, input + recv_start, partial, recv_len);
+      }
+    } else if (step == 0) {
+      // Two processes: there are no partial results.
+      get_copy_reduction_kernel<T>(op)(recv_input, input + recv_start,
+                                       recvbuf + recv_start, recv_len);
+    } else {
+      last_op(recv_partial, input + recv_start, recvbuf + recv_start,
+              recv_len);
+    }
+  }
+  release_memory(recv_input);
+  release_memory(recv_partial);
+  release_memory(partial);
+  // Ring allgather.
+  int send_idx = (rank + 1) % nprocs;  // We hold the result of this slice.
+  for (int step = 0; step < nprocs - 1; ++step) {
+    const int recv_idx = (rank - step + nprocs) % nprocs;
+    MPI_Sendrecv(recvbuf + (slice_ends[send_idx] - slice_lengths[send_idx]),
+                 slice_lengths[send_idx], type, dst, tag,
+                 recvbuf + (slice_ends[recv_idx] - slice_lengths[recv_idx]),
+                 slice_lengths[recv_idx], type, src, tag,
+                 mpi_comm, MPI_STATUS_IGNORE);
+    send_idx = recv_idx;  // Forward the data received.
   }
-  ProgressEngine* pe = get_progress_engine();
-  pe->enqueue(state);
+}
+
+/**
+ * Run wide_ring_allreduce if T is a 16-bit floating point type and partial
+ * results are kept in float, and return whether it was run.
+ */
+template <typename T>
+typename std::enable_if<is_half_float<T>::value, bool>::type
+try_wide_ring_allreduce(const T* sendbuf, T* recvbuf, size_t count,
+                        ReductionOperator op, Communicator& comm,
+                        const int tag) {
+  if (!use_fp32_partials()) {
+    return false;
+  }
+  wide_ring_allreduce(sendbuf, recvbuf, count, op, comm, tag);
+  return true;
+}
+template <typename T>
+typename std::enable_if<!is_half_float<T>::value, bool>::type
+try_wide_ring_allreduce(const T*, T*, size_t, ReductionOperator,
+                        Communicator&, const int) {
+  return false;
 }
 
 /** Use a ring-based reduce-scatter then allgather to perform the allreduce. */
@@ -807,11 +866,20 @@ void ring_allreduce(const T* sendbuf, T* recvbuf, size_t count,
   int rank = comm.rank();
   int nprocs = comm.size();
   MPI_Comm mpi_comm = dynamic_cast<MPICommunicator&>(comm).get_comm();
-  if (sendbuf != IN_PLACE<T>()) {
-    // Copy our data into the receive buffer.
-    std::copy_n(sendbuf, count, recvbuf);
+  if (nprocs == 1) {
+    if (sendbuf != IN_PLACE<T>()) {
+      std::copy_n(sendbuf, count, recvbuf);
+    }
+    return;  // Only needed to copy data.
+  }
+  if (!bidir && try_wide_ring_allreduce(sendbuf, recvbuf, count, op, comm,
+                                        tag)) {
+    return;
   }
-  if (nprocs == 1) return;  // Only needed to copy data.
+  // Our data is not copied to recvbuf: each slice is reduced once in the
+  // reduce-scatter, which copies it, except our own, which the allgather
+  // overwrites.
+  const T* input = sendbuf == IN_PLACE<T>() ? recvbuf : sendbuf;
   // Compute the slices of data to be moved in each ring.
   const size_t num_slices = nprocs * num_rings * bidir_cnt;
   const size_t size_per_msg = count / num_slices;
@@ -864,7 +932,7 @@ void ring_allreduce(const T* sendbuf, T* recvbuf, size_t count,
   // direction and step.
   const int step_direction[2] = {-1, 1};
   MPI_Datatype type = TypeMap<T>();
-  auto reduction_op = ReductionMap<T>(op);
+  auto copy_reduction_op = CopyReductionMap<T>(op);
   // TODO: Merge RS/AG steps so the RS doesn't have to complete on every ring
   // before the AG starts.
   // Ring reduce-scatter.
@@ -882,8 +950,8 @@ void ring_allreduce(const T* sendbuf, T* recvbuf, size_t count,
       // Determine the slices being sent and received.
       const int send_idx = rank;
       const int recv_idx = (rank + step_direction[dir] + nprocs) % nprocs;
-      const T* to_send = recvbuf + (slice_ends[ring][dir][send_idx] -
-                                    slice_lengths[ring][dir][send_idx]);
+      const T* to_send = input + (slice_ends[ring][dir][send_idx] -
+                                  slice_lengths[ring][dir][send_idx]);
       MPI_Irecv(recv_to[ring][dir], slice_lengths[ring][dir][recv_idx],
                 type, srcs[ring][dir], tag, mpi_comm, &(reqs[req_idx]));
       MPI_Isend(to_send, slice_lengths[ring][dir][send_idx], type,
@@ -902,10 +970,10 @@ void ring_allreduce(const T* sendbuf, T* recvbuf, size_t count,
       // Recv completed.
       const int recv_idx =
         (rank + step_direction[dir]*(steps[ring][dir] + 1) + nprocs) % nprocs;
-      reduction_op(recv_to[ring][dir], recvbuf +
-                   (slice_ends[ring][dir][recv_idx] -
-                    slice_lengths[ring][dir][recv_idx]),
-                   slice_lengths[ring][dir][recv_idx]);
+      const size_t offset = slice_ends[ring][dir][recv_idx] -
+        slice_lengths[ring][dir][recv_idx];
+      copy_reduction_op(recv_to[ring][dir], input + offset, recvbuf + offset,
+                        slice_lengths[ring][dir][recv_idx]);
     }
     // Check if this step is done.
     if (reqs[req_idx] == MPI_REQUEST_NULL &&
@@ -1003,17 +1071,8 @@ class MPIRingAlState : public MPIAlState<T> {
     bool r = MPIAlState<T>::setup();
     if (!r) {
       // Compute slices of data to be moved.
-      const size_t size_per_rank = this->count / this->nprocs;
-      const size_t remainder = this->count % this->nprocs;
-      slice_lengths.resize(this->nprocs, size_per_rank);
-      // Add in the remainder as evenly as possible.
-      for (size_t i = 0; i < remainder; ++i) {
-        slice_lengths[i] += 1;
-      }
-      slice_ends.resize(this->nprocs);
-      std::partial_sum(slice_lengths.begin(), slice_lengths.end(),
-                       slice_ends.begin());
-      this->recv_to = get_memory<T>(slice_lengths[0]);
+      this->init_slices(this->nprocs);
+      this->recv_to = get_memory<T>(this->slice_len(0));
       src = (this->rank - 1 + this->nprocs) % this->nprocs;
       dst = (this->rank + 1) % this->nprocs;
       ag_send_idx = (this->rank + 1) % this->nprocs;
@@ -1021,6 +1080,9 @@ class MPIRingAlState : public MPIAlState<T> {
     return r;
   }
   PEAction step() override {
+    if (this->finished_in_setup) {
+      return PEAction::complete;
+    }
     if (phase == 0) {
       if (rs_step()) {
         // Switch to allgather for next step.
@@ -1034,7 +1096,7 @@ class MPIRingAlState : public MPIAlState<T> {
     }
   }
   std::string get_name() const override { return "MPIRing"; }
- private:
+ protected:
   /** 0 == reduce-scatter, 1 == allgather. */
   int phase = 0;
   /** Whether communication has started. */
@@ -1047,21 +1109,16 @@ class MPIRingAlState : public MPIAlState<T> {
   int dst;
   /** Send index for the allgather. */
   int ag_send_idx;
-  /** Lengths of each slice of data to be sent. */
-  std::vector<size_t> slice_lengths;
-  /** End of each slice of data to be send. */
-  std::vector<size_t> slice_ends;
-  bool rs_step() {
+  /** Run a reduce-scatter step; return true when it is done. */
+  virtual bool rs_step() {
     bool test = this->test_send_recv();
     if (started && test) {
       // Send completed, reduce and update state.
       const int old_recv_idx = (this->rank - cur_step - 1 + this->nprocs) %
         this->nprocs;
-      this->reduction_op(
-        this->recv_to,
-        this->recvbuf +
-          (slice_ends[old_recv_idx] - slice_lengths[old_recv_idx]),
-        slice_lengths[old_recv_idx]);
+      // Each slice is reduced once, so this also copies our data.
+      this->reduce_recv(this->slice_start(old_recv_idx),
+                        this->slice_len(old_recv_idx), true);
       ++cur_step;
       if (cur_step >= this->nprocs - 1) {
         return true;
@@ -1072,10 +1129,11 @@ class MPIRingAlState : public MPIAlState<T> {
         this->nprocs;
       const int recv_idx = (this->rank - cur_step - 1 + this->nprocs) %
         this->nprocs;
-      const T* to_send = this->recvbuf +
-        (slice_ends[send_idx] - slice_lengths[send_idx]);
-      this->start_send_recv(to_send, slice_lengths[send_idx], dst,
-                            this->recv_to, slice_lengths[recv_idx], src);
+      // Our own slice is sent first, before anything is in recvbuf.
+      const T* to_send = (cur_step == 0 ? this->input() : this->recvbuf) +
+        this->slice_start(send_idx);
+      this->start_send_recv(to_send, this->slice_len(send_idx), dst,
+                            this->recv_to, this->slice_len(recv_idx), src);
       started = true;
     }
     return false;
@@ -1094,32 +1152,137 @@ class MPIRingAlState : public MPIAlState<T> {
     if (test) {
       const int recv_idx = (this->rank - cur_step + this->nprocs) % this->nprocs;
       const T* to_send =
-        this->recvbuf + (slice_ends[ag_send_idx] - slice_lengths[ag_send_idx]);
+        this->recvbuf + this->slice_start(ag_send_idx);
       this->start_send_recv(
-        to_send, slice_lengths[ag_send_idx], dst,
-        this->recvbuf + (slice_ends[recv_idx] - slice_lengths[recv_idx]),
-        slice_lengths[recv_idx], src);
+        to_send, this->slice_len(ag_send_idx), dst,
+        this->recvbuf + this->slice_start(recv_idx),
+        this->slice_len(recv_idx), src);
       started = true;
     }
     return false;
   }
 };
 
+/**
+ * Non-blocking ring allreduce that keeps partial results in float, as in
+ * wide_ring_allreduce. Only the reduce-scatter differs from MPIRingAlState.
+ */
+template <typename T>
+class MPIWideRingAlState : public MPIRingAlState<T> {
+ public:
+  MPIWideRingAlState(
+    const T* sendbuf_, T* recvbuf_, size_t count_,
+    ReductionOperator op_, Communicator& comm_, AlRequest req_) :
+    MPIRingAlState<T>(sendbuf_, recvbuf_, count_, op_, comm_, req_),
+    first_op(get_wide_reduction_kernel<T, T, float>(op_)),
+    partial_op(get_wide_reduction_kernel<T, float, float>(op_)),
+    last_op(get_wide_reduction_kernel<T, float, T>(op_)) {}
+  ~MPIWideRingAlState() override {
+    if (recv_partial != nullptr) {
+      release_memory(recv_partial);
+      release_memory(partial);
+    }
+  }
+  bool setup() override {
+    bool r = MPIRingAlState<T>::setup();
+    if (!r) {
+      // recv_to receives input in the first step, these the partial results.
+      recv_partial = get_memory<float>(this->slice_len(0));
+      partial = get_memory<float>(this->slice_len(0));
+    }
+    return r;
+  }
+  std::string get_name() const override { return "MPIWideRing"; }
+ private:
+  /** Buffer float partial results are received to. */
+  float* recv_partial = nullptr;
+  /** Our partial result, sent in the next step. */
+  float* partial = nullptr;
+  /** Reduces received input into a partial result. */
+  WideReductionKernel<T, T, float> first_op;
+  /** Reduces a received partial result into a partial result. */
+  WideReductionKernel<T, float, float> partial_op;
+  /** Reduces a received partial result into a final result. */
+  WideReductionKernel<T, float, T> last_op;
+
+  bool rs_step() override {
+    bool test = this->test_send_recv();
+    const int nprocs = this->nprocs;
+    if (this->started && test) {
+      // Send completed, so partial can be overwritten.
+      const int old_recv_idx = (this->rank - this->cur_step - 1 + nprocs) %
+        nprocs;
+      const size_t start = this->slice_start(old_recv_idx);
+      const size_t len = this->slice_len(old_recv_idx);
+      const T* in = this->input() + start;
+      if (this->cur_step < nprocs - 2) {
+        if (this->cur_step == 0) {
+          first_op(this->recv_to, in, partial, len);
+        } else {
+          partial_op(recv_partial, in, partial, len);
+        }
+      } else if (this->cur_step == 0) {
+        // Two processes: there are no partial results.
+        this->copy_reduction_op(this->recv_to, in, this->recvbuf + start, len);
+      } else {
+        last_op(recv_partial, in, this->recvbuf + start, len);
+      }
+      ++this->cur_step;
+      if (this->cur_step >= nprocs - 1) {
+        return true;
+      }
+    }
+    if (test) {
+      const int send_idx = (this->rank - this->cur_step + nprocs) % nprocs;
+      const int recv_idx = (this->rank - this->cur_step - 1 + nprocs) % nprocs;
+      if (this->cur_step == 0) {
+        this->start_send_recv(
+          this->input() + this->slice_start(send_idx),
+          this->slice_len(send_idx), this->dst,
+          this->recv_to, this->slice_len(recv_idx), this->src);
+      } else {
+        this->start_send_recv(
+          partial, this->slice_len(send_idx), this->dst,
+          recv_partial, this->slice_len(recv_idx), this->src, MPI_FLOAT);
+      }
+      this->started = true;
+    }
+    return false;
+  }
+};
+
+/**
+ * Return a new state for a non-blocking ring allreduce, keeping partial
+ * results in float if T is a 16-bit floating point type and that is enabled.
+ */
+template <typename T>
+typename std::enable_if<is_half_float<T>::value, MPIRingAlState<T>*>::type
+new_ring_state(const T* sendbuf, T* recvbuf, size_t count,
+               ReductionOperator op, Communicator& comm, AlRequest req) {
+  if (use_fp32_partials()) {
+    return new MPIWideRingAlState<T>(sendbuf, recvbuf, count, op, comm, req);
+  }
+  return new MPIRingAlState<T>(sendbuf, recvbuf, count, op, comm, req);
+}
+template <typename T>
+typename std::enable_if<!is_half_float<T>::value, MPIRingAlState<T>*>::type
+new_ring_state(const T* sendbuf, T* recvbuf, size_t count,
+               ReductionOperator op, Communicator& comm, AlRequest req) {
+  return new MPIRingAlState<T>(sendbuf, recvbuf, count, op, comm, req);
+}
+
 /** Non-blocking ring allreduce. */
 template <typename T>
 void nb_ring_allreduce(const T* sendbuf, T* recvbuf, size_t count,
                        ReductionOperator op, Communicator& comm,
-                       AlRequest& req) {
+                       AlRequest& req,
+                       OpPriority priority = OpPriority::normal,
+                       ProgressMode mode = ProgressMode::engine,
+                       const std::vector<AlRequest>* deps = nullptr) {
   req = get_free_request();
   MPIRingAlState<T>* state =
-    new MPIRingAlState<T>(
-      sendbuf, recvbuf, count, op, comm, req);
-  if (state->setup()) {
-    req = NULL_REQUEST;
-    return;
-  }
-  ProgressEngine* pe = get_progress_engine();
-  pe->enqueue(state);
+    new_ring_state(sendbuf, recvbuf, count, op, comm, req);
+  submit_allreduce(state, req, priority, mode, deps);
 }
 
 /**
@@ -1135,13 +1298,19 @@ void rabenseifner_allreduce(const T* sendbuf, T* recvbuf, size_t count,
   int rank = comm.rank();
   int nprocs = comm.size();
   MPI_Comm mpi_comm = dynamic_cast<MPICommunicator&>(comm).get_comm();
-  if (sendbuf != IN_PLACE<T>()) {
-    // Copy our data into the receive buffer.
-    std::copy_n(sendbuf, count, recvbuf);
+  if (nprocs == 1) {
+    if (sendbuf != IN_PLACE<T>()) {
+      std::copy_n(sendbuf, count, recvbuf);
+    }
+    return;  // Only needed to copy data.
   }
-  if (nprocs == 1) return;  // Only needed to copy data.
+  // Our data is not copied to recvbuf. The first reduction copies the half
+  // that is kept, and the allgather overwrites the rest.
+  const T* input = sendbuf == IN_PLACE<T>() ? recvbuf : sendbuf;
+  bool reduced = false;
   MPI_Datatype type = TypeMap<T>();
   auto reduction_op = ReductionMap<T>(op);
+  auto copy_reduction_op = CopyReductionMap<T>(op);
   // Check if we are in the non-power-of-2 case.
   // This works basically as with recursive-doubling.
   int pow2 = 1;
@@ -1154,12 +1323,13 @@ void rabenseifner_allreduce(const T* sendbuf, T* recvbuf, size_t count,
   T* recv_to = nullptr;
   if (rank < 2 * pow2_remainder) {
     if (rank % 2 == 0) {
-      MPI_Send(recvbuf, count, type, rank + 1, tag, mpi_comm);
+      MPI_Send(input, count, type, rank + 1, tag, mpi_comm);
       rank = -1;  // Don't participate.
     } else {
       recv_to = get_memory<T>(count);
       MPI_Recv(recv_to, count, type, rank - 1, tag, mpi_comm, MPI_STATUS_IGNORE);
-      reduction_op(recv_to, recvbuf, count);
+      copy_reduction_op(recv_to, input, recvbuf, count);
+      reduced = true;
       rank /= 2;
     }
   } else {
@@ -1210,10 +1380,17 @@ void rabenseifner_allreduce(const T* sendbuf, T* recvbuf, size_t count,
         recv_start = slice_ends[recv_idx] - slice_lengths[recv_idx];
         recv_end = slice_ends[last_idx - 1];
       }
-      MPI_Sendrecv(recvbuf + send_start, send_end - send_start, type, partner, tag,
+      MPI_Sendrecv((reduced ? recvbuf : input) + send_start,
+                   send_end - send_start, type, partner, tag,
                    recv_to, recv_end - recv_start, type, partner, tag,
                    mpi_comm, MPI_STATUS_IGNORE);
-      reduction_op(recv_to, recvbuf + recv_start, recv_end - recv_start);
+      if (reduced) {
+        reduction_op(recv_to, recvbuf + recv_start, recv_end - recv_start);
+      } else {
+        copy_reduction_op(recv_to, input + recv_start, recvbuf + recv_start,
+                          recv_end - recv_start);
+        reduced = true;
+      }
       // Update for the next iteration, except last_idx, which is needed by the
       // allgather.
       send_idx = recv_idx;
@@ -1294,7 +1471,7 @@ class MPIRabenseifnerAlState : public MPIAlState<T> {
       // Adjust rank and start a send/recv for data if needed.
       if (this->rank < 2 * pow2_remainder) {
         if (this->rank % 2 == 0) {
-          MPI_Isend(this->recvbuf, this->count, this->type, this->rank + 1,
+          MPI_Isend(this->input(), this->count, this->type, this->rank + 1,
                     this->tag, this->comm, &(this->send_recv_reqs[0]));
           adjusted_rank = -1;  // Don't participate.
         } else {
@@ -1310,19 +1487,10 @@ class MPIRabenseifnerAlState : public MPIAlState<T> {
       }
       if (adjusted_rank != -1) {
         // Compute slices of data to be moved.
-        const size_t size_per_rank = this->count / pow2;
-        const size_t remainder = this->count % pow2;
-        slice_lengths.resize(pow2, size_per_rank);
-        // Add in the remainder as evenly as possible.
-        for (size_t i = 0; i < remainder; ++i) {
-          slice_lengths[i] += 1;
-        }
-        slice_ends.resize(pow2);
-        std::partial_sum(slice_lengths.begin(), slice_lengths.end(),
-                         slice_ends.begin());
+        this->init_slices(pow2);
         // Receive at most half the data.
         if (this->recv_to == nullptr) {
-          this->recv_to = get_memory<T>(slice_ends[pow2 / 2]);
+          this->recv_to = get_memory<T>(this->slice_end(pow2 / 2));
         }
         partner_mask = pow2 >> 1;
         last_idx = pow2;
@@ -1331,13 +1499,17 @@ class MPIRabenseifnerAlState : public MPIAlState<T> {
     return r;
   }
   PEAction step() override {
+    if (this->finished_in_setup) {
+      return PEAction::complete;
+    }
     // Complete setup communication, if any.
     if (!setup_comm_done) {
       if (this->test_send_recv()) {
         setup_comm_done = true;
         if (this->rank % 2) {
           // Received data, need to reduce it.
-          this->reduction_op(this->recv_to, this->recvbuf, this->count);
+          this->reduce_recv(0, this->count, true);
+          reduced = true;
         }
       } else {
         return PEAction::cont;
@@ -1385,6 +1557,8 @@ class MPIRabenseifnerAlState : public MPIAlState<T> {
   int phase = 0;
   /** Whether communication has started. */
   bool started = false;
+  /** Whether received data has been reduced into recvbuf. */
+  bool reduced = false;
   /** Whether the send/recv from non-power-of-2 setup has completed. */
   bool setup_comm_done = false;
   /** Whether the final send/recv from the non-power-of-2 case has started. */
@@ -1408,23 +1582,20 @@ class MPIRabenseifnerAlState : public MPIAlState<T> {
   int recv_idx = 0;
   /** End of the right-most chunks sent. */
   int last_idx;
-  /** Lengths of each slice of data to be sent. */
-  std::vector<size_t> slice_lengths;
-  /** End of each slice of data to be send. */
-  std::vector<size_t> slice_ends;
   bool rs_step() {
     bool test = this->test_send_recv();
     if (started && test) {
       const int adjusted_old_partner = this->adjusted_rank ^ partner_mask;
-      size_t old_recv_start = slice_ends[recv_idx] - slice_lengths[recv_idx];
+      size_t old_recv_start = this->slice_start(recv_idx);
       size_t old_recv_end;
       if (adjusted_rank < adjusted_old_partner) {
-        old_recv_end = slice_ends[send_idx - 1];
+        old_recv_end = this->slice_end(send_idx - 1);
       } else {
-        old_recv_end = slice_ends[last_idx - 1];
+        old_recv_end = this->slice_end(last_idx - 1);
       }
-      this->reduction_op(this->recv_to, this->recvbuf + old_recv_start,
-                         old_recv_end - old_recv_start);
+      this->reduce_recv(old_recv_start, old_recv_end - old_recv_start,
+                        !reduced);
+      reduced = true;
       send_idx = recv_idx;
       partner_mask >>= 1;
       slice_mask <<= 1;
@@ -1443,19 +1614,20 @@ class MPIRabenseifnerAlState : public MPIAlState<T> {
       size_t send_start, send_end, recv_start, recv_end;
       if (adjusted_rank < adjusted_partner) {
         send_idx = recv_idx + pow2 / (slice_mask*2);
-        send_start = slice_ends[send_idx] - slice_lengths[send_idx];
-        send_end = slice_ends[last_idx - 1];
-        recv_start = slice_ends[recv_idx] - slice_lengths[recv_idx];
-        recv_end = slice_ends[send_idx - 1];
+        send_start = this->slice_start(send_idx);
+        send_end = this->slice_end(last_idx - 1);
+        recv_start = this->slice_start(recv_idx);
+        recv_end = this->slice_end(send_idx - 1);
       } else {
         recv_idx = send_idx + pow2 / (slice_mask*2);
-        send_start = slice_ends[send_idx] - slice_lengths[send_idx];
-        send_end = slice_ends[recv_idx - 1];
-        recv_start = slice_ends[recv_idx] - slice_lengths[recv_idx];
-        recv_end = slice_ends[last_idx - 1];
+        send_start = this->slice_start(send_idx);
+        send_end = this->slice_end(recv_idx - 1);
+        recv_start = this->slice_start(recv_idx);
+        recv_end = this->slice_end(last_idx - 1);
       }
       this->start_send_recv(
-        this->recvbuf + send_start, send_end - send_start, partner,
+        (reduced ? this->recvbuf : this->input()) + send_start,
+        send_end - send_start, partner,
         this->recv_to, recv_end - recv_start, partner);
       started = true;
     }
@@ -1488,16 +1660,16 @@ class MPIRabenseifnerAlState : public MPIAlState<T> {
           last_idx += pow2 / (slice_mask*2);
         }
         recv_idx = send_idx + pow2 / (slice_mask*2);
-        send_start = slice_ends[send_idx] - slice_lengths[send_idx];
-        send_end = slice_ends[recv_idx - 1];
-        recv_start = slice_ends[recv_idx] - slice_lengths[recv_idx];
-        recv_end = slice_ends[last_idx - 1];
+        send_start = this->slice_start(send_idx);
+        send_end = this->slice_end(recv_idx - 1);
+        recv_start = this->slice_start(recv_idx);
+        recv_end = this->slice_end(last_idx - 1);
       } else {
         recv_idx = send_idx - pow2 / (slice_mask*2);
-        send_start = slice_ends[send_idx] - slice_lengths[send_idx];
-        send_end = slice_ends[last_idx - 1];
-        recv_start = slice_ends[recv_idx] - slice_lengths[recv_idx];
-        recv_end = slice_ends[send_idx - 1];
+        send_start = this->slice_start(send_idx);
+        send_end = this->slice_end(last_idx - 1);
+        recv_start = this->slice_start(recv_idx);
+        recv_end = this->slice_end(send_idx - 1);
       }
       this->start_send_recv(
         this->recvbuf + send_start, send_end - send_start, partner,
@@ -1512,17 +1684,15 @@ class MPIRabenseifnerAlState : public MPIAlState<T> {
 template <typename T>
 void nb_rabenseifner_allreduce(const T* sendbuf, T* recvbuf, size_t count,
                                ReductionOperator op, Communicator& comm,
-                               AlRequest& req) {
+                               AlRequest& req,
+                               OpPriority priority = OpPriority::normal,
+                               ProgressMode mode = ProgressMode::engine,
+                               const std::vector<AlRequest>* deps = nullptr) {
   req = get_free_request();
   MPIRabenseifnerAlState<T>* state =
     new MPIRabenseifnerAlState<T>(
       sendbuf, recvbuf, count, op, comm, req);
-  if (state->setup()) {
-    req = NULL_REQUEST;
-    return;
-  }
-  ProgressEngine* pe = get_progress_engine();
-  pe->enqueue(state);
+  submit_allreduce(state, req, priority, mode, deps);
 }
 
 /**
@@ -1538,11 +1708,16 @@ void pe_ring_allreduce(const T* sendbuf, T* recvbuf, size_t count,
   int rank = comm.rank();
   int nprocs = comm.size();
   MPI_Comm mpi_comm = dynamic_cast<MPICommunicator&>(comm).get_comm();
-  if (sendbuf != IN_PLACE<T>()) {
-    // Copy our data into the receive buffer.
-    std::copy_n(sendbuf, count, recvbuf);
+  if (nprocs == 1) {
+    if (sendbuf != IN_PLACE<T>()) {
+      std::copy_n(sendbuf, count, recvbuf);
+    }
+    return;  // Only needed to copy data.
   }
-  if (nprocs == 1) return;  // Only needed to copy data.
+  // Our data is not copied to recvbuf: the reduce-scatter sends other slices
+  // straight from our input and copies our slice with its first reduction,
+  // and the allgather overwrites the rest.
+  const T* input = sendbuf == IN_PLACE<T>() ? recvbuf : sendbuf;
   // Compute the slices of data to be moved.
   const size_t size_per_rank = count / nprocs;
   const size_t remainder = count % nprocs;
@@ -1558,18 +1733,24 @@ void pe_ring_allreduce(const T* sendbuf, T* recvbuf, size_t count,
   T* recv_to = get_memory<T>(slice_lengths[0]);
   MPI_Datatype type = TypeMap<T>();
   auto reduction_op = ReductionMap<T>(op);
+  auto copy_reduction_op = CopyReductionMap<T>(op);
   // Do a pairwise-exchange reduce-scatter.
+  const size_t local_start = slice_ends[rank] - slice_lengths[rank];
   for (int step = 1; step < nprocs; ++step) {
     // Compute source and destination for this step.
     const int src = (rank - step + nprocs) % nprocs;
     const int dst = (rank + step) % nprocs;
-    const T* to_send = recvbuf + (slice_ends[dst] - slice_lengths[dst]);
+    const T* to_send = input + (slice_ends[dst] - slice_lengths[dst]);
     // Note: We always receive to our local chunk.
     MPI_Sendrecv(to_send, slice_lengths[dst], type, dst, tag,
                  recv_to, slice_lengths[rank], type, src, tag,
                  mpi_comm, MPI_STATUS_IGNORE);
-    reduction_op(recv_to, recvbuf + (slice_ends[rank] - slice_lengths[rank]),
-                 slice_lengths[rank]);
+    if (step == 1) {
+      copy_reduction_op(recv_to, input + local_start, recvbuf + local_start,
+                        slice_lengths[rank]);
+    } else {
+      reduction_op(recv_to, recvbuf + local_start, slice_lengths[rank]);
+    }
   }
   // Ring allgather.
   // No temporary buffer is needed here: Receive directly into recvbuf.
@@ -1590,6 +1771,481 @@ void pe_ring_allreduce(const T* sendbuf, T* recvbuf, size_t count,
   release_memory(recv_to);
 }
 
+/** Handle for a persistent operation. */
+struct PersistentOp {
+  /** State run by each start; the progress engine never deletes it. */
+  AlState* state;
+  /** How each start is driven to completion. */
+  ProgressMode mode;
+};
+
+/**
+ * Persistent allreduce.
+ * The communication schedule is built once, as a list of steps backed by MPI
+ * persistent requests (MPI_Send_init/MPI_Recv_init), and the tag, slice
+ * layout, and temporary buffer are kept for the lifetime of the state. Each
+ * start only walks the schedule: as in the blocking algorithms, the input is
+ * copied by the first reduction rather than up front.
+ * The schedules mirror the blocking algorithms. There is no persistent
+ * MPI_Allreduce before MPI-4, so passthrough starts an MPI_Iallreduce
+ * each time instead.
+ */
+template <typename T>
+class MPIPersistentAllreduceAlState : public MPIAlState<T> {
+ public:
+  MPIPersistentAllreduceAlState(
+    const T* sendbuf_, T* recvbuf_, size_t count_,
+    ReductionOperator op_, Communicator& comm_) :
+    MPIAlState<T>(sendbuf_, recvbuf_, count_, op_, comm_, NULL_REQUEST) {
+    assert_count_fits_mpi(this->count);
+    mpi_op = MPIOpMap<T>(op_);
+    this->set_persistent();
+  }
+  ~MPIPersistentAllreduceAlState() override {
+    for (auto&& s : schedule) {
+      for (int i = 0; i < s.num_reqs; ++i) {
+        MPI_Request_free(&(s.reqs[i]));
+      }
+    }
+    if (recv_partial != nullptr) {
+      release_memory(recv_partial);
+      release_memory(partial);
+    }
+  }
+  /** Start an MPI_Iallreduce on each start instead of using a schedule. */
+  void use_passthrough() { passthrough = true; }
+  /** Build the schedule of recursive_doubling_allreduce. */
+  void build_recursive_doubling() {
+    if (!needs_schedule()) return;
+    this->recv_to = get_memory<T>(this->count);
+    int rank = this->rank;
+    int pow2 = 1;
+    while (pow2 <= this->nprocs) pow2 <<= 1;
+    pow2 >>= 1;
+    const int pow2_remainder = this->nprocs - pow2;
+    add_pre_steps(rank, pow2_remainder);
+    bool reduced = this->rank < 2 * pow2_remainder;
+    unsigned int mask = 1;
+    while (rank != -1 && mask < static_cast<unsigned int>(pow2)) {
+      int adjusted_partner = rank ^ mask;
+      int partner = (adjusted_partner < pow2_remainder) ?
+        adjusted_partner * 2 + 1 :
+        adjusted_partner + pow2_remainder;
+      add_step(reduced ? this->recvbuf : this->input(), this->count, partner,
+               this->recv_to, this->count, partner);
+      add_reduction(0, this->count, !reduced);
+      reduced = true;
+      mask <<= 1;
+    }
+    add_post_steps(pow2_remainder);
+  }
+  /** Build the schedule of the single-ring ring_allreduce. */
+  void build_ring() {
+    if (!needs_schedule()) return;
+    const int rank = this->rank;
+    const int nprocs = this->nprocs;
+    this->init_slices(nprocs);
+    this->recv_to = get_memory<T>(this->slice_len(0));
+    const int src = (rank - 1 + nprocs) % nprocs;
+    const int dst = (rank + 1) % nprocs;
+    // Reduce-scatter.
+    for (int step = 0; step < nprocs - 1; ++step) {
+      const int send_idx = (rank - step + nprocs) % nprocs;
+      const int recv_idx = (rank - step - 1 + nprocs) % nprocs;
+      add_step((step == 0 ? this->input() : this->recvbuf)
+               + this->slice_start(send_idx),
+               this->slice_len(send_idx), dst,
+               this->recv_to, this->slice_len(recv_idx), src);
+      // Each slice is reduced once, so this is always the first reduction.
+      add_reduction(this->slice_start(recv_idx), this->slice_len(recv_idx),
+                    true);
+    }
+    // Allgather.
+    int send_idx = (rank + 1) % nprocs;
+    for (int step = 0; step < nprocs - 1; ++step) {
+      const int recv_idx = (rank - step + nprocs) % nprocs;
+      add_step(this->recvbuf + this->slice_start(send_idx),
+               this->slice_len(send_idx), dst,
+               this->recvbuf + this->slice_start(recv_idx),
+               this->slice_len(recv_idx), src);
+      send_idx = recv_idx;
+    }
+  }
+  /**
+   * Build the schedule of wide_ring_allreduce, keeping partial results in
+   * float. This is only instantiated for 16-bit floating point types.
+   */
+  void build_wide_ring(ReductionOperator op) {
+    if (!needs_schedule()) return;
+    const int rank = this->rank;
+    const int nprocs = this->nprocs;
+    this->init_slices(nprocs);
+    this->recv_to = get_memory<T>(this->slice_len(0));
+    recv_partial = get_memory<float>(this->slice_len(0));
+    partial = get_memory<float>(this->slice_len(0));
+    first_op = get_wide_reduction_kernel<T, T, float>(op);
+    partial_op = get_wide_reduction_kernel<T, float, float>(op);
+    last_op = get_wide_reduction_kernel<T, float, T>(op);
+    const int src = (rank - 1 + nprocs) % nprocs;
+    const int dst = (rank + 1) % nprocs;
+    // Reduce-scatter: input first, then float partial results.
+    for (int step = 0; step < nprocs - 1; ++step) {
+      const int send_idx = (rank - step + nprocs) % nprocs;
+      const int recv_idx = (rank - step - 1 + nprocs) % nprocs;
+      if (step == 0) {
+        add_step(this->input() + this->slice_start(send_idx),
+                 this->slice_len(send_idx), dst,
+                 this->recv_to, this->slice_len(recv_idx), src);
+      } else {
+        add_step(partial, this->slice_len(send_idx), dst,
+                 recv_partial, this->slice_len(recv_idx), src, MPI_FLOAT);
+      }
+      add_reduction(this->slice_start(recv_idx), this->slice_len(recv_idx),
+                    true);
+      if (step < nprocs - 2) {
+        schedule.back().wide = step == 0 ? WideReduction::first
+                                         : WideReduction::partial;
+      } else if (step > 0) {
+        schedule.back().wide = WideReduction::last;
+      }  // Otherwise two processes: there are no partial results.
+    }
+    // Allgather.
+    int send_idx = (rank + 1) % nprocs;
+    for (int step = 0; step < nprocs - 1; ++step) {
+      const int recv_idx = (rank - step + nprocs) % nprocs;
+      add_step(this->recvbuf + this->slice_start(send_idx),
+               this->slice_len(send_idx), dst,
+               this->recvbuf + this->slice_start(recv_idx),
+               this->slice_len(recv_idx), src);
+      send_idx = recv_idx;
+    }
+  }
+  /** Build the schedule of rabenseifner_allreduce. */
+  void build_rabenseifner() {
+    if (!needs_schedule()) return;
+    int rank = this->rank;
+    int pow2 = 1;
+    while (pow2 <= this->nprocs) pow2 <<= 1;
+    pow2 >>= 1;
+    const int pow2_remainder = this->nprocs - pow2;
+    this->init_slices(pow2);
+    // Excluded ranks only send and receive the whole buffer.
+    if (rank < 2 * pow2_remainder) {
+      if (rank % 2 == 1) {
+        this->recv_to = get_memory<T>(this->count);
+      }
+    } else {
+      this->recv_to = get_memory<T>(this->slice_end(pow2 / 2));
+    }
+    add_pre_steps(rank, pow2_remainder);
+    bool reduced = this->rank < 2 * pow2_remainder;
+    if (rank != -1) {
+      // Recursive-halving reduce-scatter.
+      unsigned int partner_mask = pow2 >> 1;
+      unsigned int slice_mask = 1;
+      int send_idx = 0;
+      int recv_idx = 0;
+      int last_idx = pow2;
+      while (partner_mask > 0) {
+        int adjusted_partner = rank ^ partner_mask;
+        int partner = (adjusted_partner < pow2_remainder) ?
+          adjusted_partner * 2 + 1 :
+          adjusted_partner + pow2_remainder;
+        size_t send_start, send_end, recv_start, recv_end;
+        if (rank < adjusted_partner) {
+          send_idx = recv_idx + pow2 / (slice_mask*2);
+          send_start = this->slice_start(send_idx);
+          send_end = this->slice_end(last_idx - 1);
+          recv_start = this->slice_start(recv_idx);
+          recv_end = this->slice_end(send_idx - 1);
+        } else {
+          recv_idx = send_idx + pow2 / (slice_mask*2);
+          send_start = this->slice_start(send_idx);
+          send_end = this->slice_end(recv_idx - 1);
+          recv_start = this->slice_start(recv_idx);
+          recv_end = this->slice_end(last_idx - 1);
+        }
+        add_step((reduced ? this->recvbuf : this->input()) + send_start,
+                 send_end - send_start, partner,
+                 this->recv_to, recv_end - recv_start, partner);
+        add_reduction(recv_start, recv_end - recv_start, !reduced);
+        reduced = true;
+        send_idx = recv_idx;
+        partner_mask >>= 1;
+        slice_mask <<= 1;
+        if (partner_mask > 0) {
+          last_idx = recv_idx + pow2 / slice_mask;
+        }
+      }
+      // Recursive-doubling allgather.
+      slice_mask >>= 1;
+      partner_mask = 1;
+      while (partner_mask < static_cast<unsigned int>(pow2)) {
+        int adjusted_partner = rank ^ partner_mask;
+        int partner = (adjusted_partner < pow2_remainder) ?
+          adjusted_partner * 2 + 1 :
+          adjusted_partner + pow2_remainder;
+        size_t send_start, send_end, recv_start, recv_end;
+        if (rank < adjusted_partner) {
+          if (slice_mask != static_cast<unsigned int>(pow2) / 2) {
+            last_idx += pow2 / (slice_mask*2);
+          }
+          recv_idx = send_idx + pow2 / (slice_mask*2);
+          send_start = this->slice_start(send_idx);
+          send_end = this->slice_end(recv_idx - 1);
+          recv_start = this->slice_start(recv_idx);
+          recv_end = this->slice_end(last_idx - 1);
+        } else {
+          recv_idx = send_idx - pow2 / (slice_mask*2);
+          send_start = this->slice_start(send_idx);
+          send_end = this->slice_end(last_idx - 1);
+          recv_start = this->slice_start(recv_idx);
+          recv_end = this->slice_end(send_idx - 1);
+        }
+        add_step(this->recvbuf + send_start, send_end - send_start, partner,
+                 this->recvbuf + recv_start, recv_end - recv_start, partner);
+        if (rank > adjusted_partner) {
+          send_idx = recv_idx;
+        }
+        partner_mask <<= 1;
+        slice_mask >>= 1;
+      }
+    }
+    add_post_steps(pow2_remainder);
+  }
+  /** Build the schedule of pe_ring_allreduce. */
+  void build_pe_ring() {
+    if (!needs_schedule()) return;
+    const int rank = this->rank;
+    const int nprocs = this->nprocs;
+    this->init_slices(nprocs);
+    this->recv_to = get_memory<T>(this->slice_len(0));
+    // Pairwise-exchange reduce-scatter.
+    for (int step = 1; step < nprocs; ++step) {
+      const int src = (rank - step + nprocs) % nprocs;
+      const int dst = (rank + step) % nprocs;
+      add_step(this->input() + this->slice_start(dst), this->slice_len(dst),
+               dst, this->recv_to, this->slice_len(rank), src);
+      add_reduction(this->slice_start(rank), this->slice_len(rank),
+                    step == 1);
+    }
+    // Ring allgather.
+    const int src = (rank - 1 + nprocs) % nprocs;
+    const int dst = (rank + 1) % nprocs;
+    int send_idx = rank;
+    for (int step = 0; step < nprocs - 1; ++step) {
+      const int recv_idx = (rank - step - 1 + nprocs) % nprocs;
+      add_step(this->recvbuf + this->slice_start(send_idx),
+               this->slice_len(send_idx), dst,
+               this->recvbuf + this->slice_start(recv_idx),
+               this->slice_len(recv_idx), src);
+      send_idx = recv_idx;
+    }
+  }
+
+  void start() override {
+    AlState::start();
+    if (passthrough) {
+      if (this->sendbuf == IN_PLACE<T>()) {
+        MPI_Iallreduce(MPI_IN_PLACE, this->recvbuf, this->count, this->type,
+                       mpi_op, this->comm, &mpi_req);
+      } else {
+        MPI_Iallreduce(this->sendbuf, this->recvbuf, this->count, this->type,
+                       mpi_op, this->comm, &mpi_req);
+      }
+      return;
+    }
+    if (!needs_schedule() && this->sendbuf != IN_PLACE<T>()) {
+      std::copy_n(this->sendbuf, this->count, this->recvbuf);
+    }
+    cur_step = 0;
+    if (!schedule.empty()) {
+      MPI_Startall(schedule[0].num_reqs, schedule[0].reqs);
+    }
+  }
+  PEAction step() override {
+    int flag;
+    if (passthrough) {
+      MPI_Test(&mpi_req, &flag, MPI_STATUS_IGNORE);
+      return flag ? PEAction::complete : PEAction::cont;
+    }
+    if (cur_step == schedule.size()) {
+      return PEAction::complete;
+    }
+    Step& s = schedule[cur_step];
+    MPI_Testall(s.num_reqs, s.reqs, &flag, MPI_STATUSES_IGNORE);
+    if (!flag) {
+      return PEAction::cont;
+    }
+    if (s.wide != WideReduction::none) {
+      reduce_wide(s);
+    } else if (s.reduce_count > 0) {
+      this->reduce_recv(s.reduce_offset, s.reduce_count, s.reduce_first);
+    }
+    if (++cur_step == schedule.size()) {
+      return PEAction::complete;
+    }
+    MPI_Startall(schedule[cur_step].num_reqs, schedule[cur_step].reqs);
+    return PEAction::cont;
+  }
+  std::string get_name() const override { return "MPIPersistentAllreduce"; }
+  /**
+   * Inactive persistent requests are not MPI_REQUEST_NULL, so they cannot be
+   * polled by the progress engine; step tests them itself.
+   */
+  MPI_Request* get_mpi_requests(size_t& num_reqs) override {
+    num_reqs = 0;
+    return nullptr;
+  }
+ private:
+  /** Which reduction of a schedule from build_wide_ring a step does. */
+  enum class WideReduction { none, first, partial, last };
+  /** One communication step of the schedule. */
+  struct Step {
+    /** Persistent requests for the step (receive first). */
+    MPI_Request reqs[2];
+    /** Number of requests used. */
+    int num_reqs = 0;
+    /** Offset in recvbuf to reduce the received data into. */
+    size_t reduce_offset = 0;
+    /** Number of elements received into recv_to to reduce; 0 for none. */
+    size_t reduce_count = 0;
+    /** Whether to combine with the input instead of recvbuf. */
+    bool reduce_first = false;
+    /** Reduction keeping partial results in float, instead of the above. */
+    WideReduction wide = WideReduction::none;
+  };
+  /** Steps to run, in order. */
+  std::vector<Step> schedule;
+  /** Buffer float partial results are received to, for build_wide_ring. */
+  float* recv_partial = nullptr;
+  /** Our float partial result, sent in the next step. */
+  float* partial = nullptr;
+  /** Kernels for the reductions of build_wide_ring. */
+  WideReductionKernel<T, T, float> first_op = nullptr;
+  WideReductionKernel<T, float, float> partial_op = nullptr;
+  WideReductionKernel<T, float, T> last_op = nullptr;
+  /** Index of the step in progress. */
+  size_t cur_step = 0;
+  /** Whether to use MPI_Iallreduce. */
+  bool passthrough = false;
+  /** MPI reduction operator, for passthrough. */
+  MPI_Op mpi_op;
+  /** Request for passthrough. */
+  MPI_Request mpi_req = MPI_REQUEST_NULL;
+
+  /** Return true if there is any communication to schedule. */
+  bool needs_schedule() const {
+    return this->count > 0 && this->nprocs > 1;
+  }
+  /**
+   * Add a step sending send_count elements of send to dest and receiving
+   * recv_count elements to recv from source. A negative rank means no send
+   * or receive.
+   */
+  void add_step(const T* send, size_t send_count, int dest,
+                T* recv, size_t recv_count, int source) {
+    add_step(send, send_count, dest, recv, recv_count, source, this->type);
+  }
+  /** Add a step sending and receiving elements of datatype dt instead. */
+  void add_step(const void* send, size_t send_count, int dest,
+                void* recv, size_t recv_count, int source, MPI_Datatype dt) {
+    schedule.emplace_back();
+    Step& s = schedule.back();
+    if (source >= 0) {
+      MPI_Recv_init(recv, recv_count, dt, source, this->tag,
+                    this->comm, &(s.reqs[s.num_reqs++]));
+    }
+    if (dest >= 0) {
+      MPI_Send_init(send, send_count, dt, dest, this->tag,
+                    this->comm, &(s.reqs[s.num_reqs++]));
+    }
+  }
+  /**
+   * Reduce after the last step, from recv_to into recvbuf + offset. If first,
+   * that part of recvbuf does not hold our data yet and the input is used.
+   */
+  void add_reduction(size_t offset, size_t n, bool first) {
+    schedule.back().reduce_offset = offset;
+    schedule.back().reduce_count = n;
+    schedule.back().reduce_first = first;
+  }
+  /** Run the reduction of a step from build_wide_ring. */
+  void reduce_wide(const Step& s) {
+    const T* in = this->input() + s.reduce_offset;
+    switch (s.wide) {
+      case WideReduction::first:
+        first_op(this->recv_to, in, partial, s.reduce_count);
+        break;
+      case WideReduction::partial:
+        partial_op(recv_partial, in, partial, s.reduce_count);
+        break;
+      case WideReduction::last:
+        last_op(recv_partial, in, this->recvbuf + s.reduce_offset,
+                s.reduce_count);
+        break;
+      case WideReduction::none:
+        break;
+    }
+  }
+  /**
+   * Add the steps that fold the excess ranks into a power-of-2 number of
+   * processes, and update rank to the adjusted rank (-1 if excluded).
+   */
+  void add_pre_steps(int& rank, int pow2_remainder) {
+    if (rank < 2 * pow2_remainder) {
+      if (rank % 2 == 0) {
+        add_step(this->input(), this->count, rank + 1, nullptr, 0, -1);
+        rank = -1;
+      } else {
+        add_step(nullptr, 0, -1, this->recv_to, this->count, rank - 1);
+        add_reduction(0, this->count, true);
+        rank /= 2;
+      }
+    } else {
+      rank -= pow2_remainder;
+    }
+  }
+  /** Add the steps that send the excluded ranks the result. */
+  void add_post_steps(int pow2_remainder) {
+    if (this->rank < 2 * pow2_remainder) {
+      if (this->rank % 2 == 0) {
+        add_step(nullptr, 0, -1, this->recvbuf, this->count, this->rank + 1);
+      } else {
+        add_step(this->recvbuf, this->count, this->rank - 1, nullptr, 0, -1);
+      }
+    }
+  }
+};
+
+/**
+ * Build the schedule of a persistent ring allreduce, keeping partial results
+ * in float if T is a 16-bit floating point type and that is enabled.
+ */
+template <typename T>
+typename std::enable_if<is_half_float<T>::value>::type
+build_persistent_ring(MPIPersistentAllreduceAlState<T>* state,
+                      ReductionOperator op) {
+  if (use_fp32_partials()) {
+    state->build_wide_ring(op);
+  } else {
+    state->build_ring();
+  }
+}
+template <typename T>
+typename std::enable_if<!is_half_float<T>::value>::type
+build_persistent_ring(MPIPersistentAllreduceAlState<T>* state,
+                      ReductionOperator) {
+  state->build_ring();
+}
+
+/** Start a persistent operation, setting req to its request. */
+inline void start_persistent(PersistentOp* op, AlRequest& req) {
+  req = get_free_request();
+  op->state->restart(req);
+  submit_state(op->state, op->mode);
+}
+
 }  // namespace mpi
 }  // namespace internal
 
@@ -1636,6 +2292,8 @@ class MPIBackend {
   using comm_type = MPICommunicator;
   using req_type = internal::AlRequest;
   static constexpr std::nullptr_t null_req = nullptr;
+  using persistent_req_type = internal::mpi::PersistentOp*;
+  static constexpr std::nullptr_t null_persistent_req = nullptr;
 
   template <typename T>
   static void Allreduce(const T* sendbuf, T* recvbuf, size_t count,
@@ -1647,6 +2305,10 @@ class MPIBackend {
       // TODO: Make tuneable.
       if (count <= 1<<9) {
         algo = MPIAllreduceAlgorithm::mpi_recursive_doubling;
+      } else if (is_half_float<T>::value
+                 && internal::mpi::use_fp32_partials()) {
+        // Only the ring keeps partial results in float.
+        algo = MPIAllreduceAlgorithm::mpi_ring;
       } else {
         algo = MPIAllreduceAlgorithm::mpi_rabenseifner;
       }
@@ -1669,6 +2331,10 @@ class MPIBackend {
         internal::mpi::pe_ring_allreduce(sendbuf, recvbuf, count, op, comm, tag);
         break;
       case MPIAllreduceAlgorithm::mpi_biring:
+        if (is_half_float<T>::value && internal::mpi::use_fp32_partials()) {
+          throw_al_exception(
+            "MPI biring does not keep partial results in float; use MPI ring");
+        }
         internal::mpi::ring_allreduce(sendbuf, recvbuf, count, op, comm, true, 1, tag);
         break;
       default:
@@ -1689,12 +2355,22 @@ class MPIBackend {
       ReductionOperator op,
       comm_type& comm,
       req_type& req,
-      allreduce_algo_type algo) {
+      allreduce_algo_type algo,
+      OpPriority priority = OpPriority::normal,
+      ProgressMode mode = ProgressMode::automatic,
+      const std::vector<req_type>* deps = nullptr) {
+    if (mode == ProgressMode::automatic) {
+      mode = comm.get_progress_mode();
+    }
     if (algo == MPIAllreduceAlgorithm::automatic) {
       // TODO: Better algorithm selection/performance model.
       // TODO: Make tuneable.
       if (count <= 1<<9) {
         algo = MPIAllreduceAlgorithm::mpi_recursive_doubling;
+      } else if (is_half_float<T>::value
+                 && internal::mpi::use_fp32_partials()) {
+        // Only the ring keeps partial results in float.
+        algo = MPIAllreduceAlgorithm::mpi_ring;
       } else {
         algo = MPIAllreduceAlgorithm::mpi_rabenseifner;
       }
@@ -1702,18 +2378,19 @@ class MPIBackend {
     switch (algo) {
       case MPIAllreduceAlgorithm::mpi_passthrough:
         internal::mpi::nb_passthrough_allreduce(sendbuf, recvbuf, count, op, comm,
-                                                req);
+                                                req, priority, mode, deps);
         break;
       case MPIAllreduceAlgorithm::mpi_recursive_doubling:
         internal::mpi::nb_recursive_doubling_allreduce(
-            sendbuf, recvbuf, count, op, comm, req);
+            sendbuf, recvbuf, count, op, comm, req, priority, mode, deps);
         break;
       case MPIAllreduceAlgorithm::mpi_ring:
-        internal::mpi::nb_ring_allreduce(sendbuf, recvbuf, count, op, comm, req);
+        internal::mpi::nb_ring_allreduce(sendbuf, recvbuf, count, op, comm, req,
+                                         priority, mode, deps);
         break;
       case MPIAllreduceAlgorithm::mpi_rabenseifner:
         internal::mpi::nb_rabenseifner_allreduce(sendbuf, recvbuf, count, op, comm,
-                                                 req);
+                                                 req, priority, mode, deps);
         break;
         /*case MPIAllreduceAlgorithm::mpi_pe_ring:
           internal::mpi::nb_pe_ring_allreduce(sendbuf, recvbuf, count, op, comm, req);
@@ -1728,9 +2405,65 @@ class MPIBackend {
       T* recvbuf, size_t count,
       ReductionOperator op, comm_type& comm,
       req_type& req,
-      allreduce_algo_type algo) {
+      allreduce_algo_type algo,
+      OpPriority priority = OpPriority::normal,
+      ProgressMode mode = ProgressMode::automatic,
+      const std::vector<req_type>* deps = nullptr) {
     NonblockingAllreduce(internal::IN_PLACE<T>(), recvbuf, count, op, comm,
-                         req, algo);
+                         req, algo, priority, mode, deps);
+  }
+
+  template <typename T>
+  static void AllreduceInit(
+      const T* sendbuf, T* recvbuf, size_t count,
+      ReductionOperator op,
+      comm_type& comm,
+      persistent_req_type& preq,
+      allreduce_algo_type algo) {
+    if (algo == MPIAllreduceAlgorithm::automatic) {
+      // Same selection as NonblockingAllreduce.
+      if (count <= 1<<9) {
+        algo = MPIAllreduceAlgorithm::mpi_recursive_doubling;
+      } else if (is_half_float<T>::value
+                 && internal::mpi::use_fp32_partials()) {
+        algo = MPIAllreduceAlgorithm::mpi_ring;
+      } else {
+        algo = MPIAllreduceAlgorithm::mpi_rabenseifner;
+      }
+    }
+    auto state = new internal::mpi::MPIPersistentAllreduceAlState<T>(
+      sendbuf, recvbuf, count, op, comm);
+    switch (algo) {
+      case MPIAllreduceAlgorithm::mpi_passthrough:
+        state->use_passthrough();
+        break;
+      case MPIAllreduceAlgorithm::mpi_recursive_doubling:
+        state->build_recursive_doubling();
+        break;
+      case MPIAllreduceAlgorithm::mpi_ring:
+        internal::mpi::build_persistent_ring(state, op);
+        break;
+      case MPIAllreduceAlgorithm::mpi_rabenseifner:
+        state->build_rabenseifner();
+        break;
+      case MPIAllreduceAlgorithm::mpi_pe_ring:
+        state->build_pe_ring();
+        break;
+      default:
+        delete state;
+        throw_al_exception("Invalid algorithm for AllreduceInit");
+    }
+    preq = new internal::mpi::PersistentOp{state, comm.get_progress_mode()};
+  }
+
+  template <typename T>
+  static void AllreduceInit(
+      T* recvbuf, size_t count,
+      ReductionOperator op, comm_type& comm,
+      persistent_req_type& preq,
+      allreduce_algo_type algo) {
+    AllreduceInit(internal::IN_PLACE<T>(), recvbuf, count, op, comm, preq,
+                  algo);
   }
 
   static std::string Name() { return "MPIBackend"; }
@@ -1748,4 +2481,59 @@ inline void Wait<MPIBackend>(typename MPIBackend::req_type& req) {
   pe->wait_for_completion(req);
 }
 
+template <>
+inline bool TestAll<MPIBackend>(size_t count,
+                                typename MPIBackend::req_type* reqs) {
+  internal::ProgressEngine* pe = internal::get_progress_engine();
+  return pe->test_all(reqs, count);
+}
+
+template <>
+inline size_t TestSome<MPIBackend>(size_t count,
+                                   typename MPIBackend::req_type* reqs,
+                                   size_t* indices) {
+  internal::ProgressEngine* pe = internal::get_progress_engine();
+  return pe->test_some(reqs, count, indices);
+}
+
+template <>
+inline void WaitAll<MPIBackend>(size_t count,
+                                typename MPIBackend::req_type* reqs) {
+  internal::ProgressEngine* pe = internal::get_progress_engine();
+  pe->wait_all(reqs, count);
+}
+
+template <>
+inline size_t WaitAny<MPIBackend>(size_t count,
+                                  typename MPIBackend::req_type* reqs) {
+  internal::ProgressEngine* pe = internal::get_progress_engine();
+  return pe->wait_any(reqs, count);
+}
+
+template <>
+inline void OnComplete<MPIBackend>(typename MPIBackend::req_type& req,
+                                   CompletionCallback callback) {
+  internal::ProgressEngine* pe = internal::get_progress_engine();
+  pe->set_callback(req, std::move(callback));
+}
+
+template <>
+inline void Start<MPIBackend>(typename MPIBackend::persistent_req_type& preq,
+                              typename MPIBackend::req_type& req) {
+  if (preq == MPIBackend::null_persistent_req) {
+    throw_al_exception("Starting a null persistent request");
+  }
+  internal::mpi::start_persistent(preq, req);
+}
+
+template <>
+inline void RequestFree<MPIBackend>(
+  typename MPIBackend::persistent_req_type& preq) {
+  if (preq != MPIBackend::null_persistent_req) {
+    delete preq->state;
+    delete preq;
+    preq = MPIBackend::null_persistent_req;
+  }
+}
+
 }  // namespace Al
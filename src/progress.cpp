@@ -27,8 +27,10 @@
 
 #include <hwloc.h>
 #include <cstdlib>
+#include <string>
 #include "Al.hpp"
 #include "progress.hpp"
+#include "slab.hpp"
 #include "trace.hpp"
 
 // For ancient versions of hwloc.
@@ -54,23 +56,248 @@ AlState::~AlState() {
 }
 
 void AlState::start() {
+#ifdef AL_HAS_NVPROF
+  // Only build the name when it is used.
   prof_range = profiling::prof_start(get_name());
+#endif
+}
+
+void AlState::restart(AlRequest req_) {
+  profiling::prof_end(prof_range);
+  req = req_;
+#ifdef AL_DEBUG_HANG_CHECK
+  hang_reported = false;
+  start_time = std::numeric_limits<double>::max();
+#endif
+  paused_for_advance = false;
+  claimed.store(false, std::memory_order_relaxed);
+  pending_action = PEAction::cont;
+  waiting_on_mpi = false;
+  started_inline = false;
+}
+
+namespace {
+
+/** Storage for a pooled state of up to Size bytes. */
+template <size_t Size>
+struct StateBlock {
+  union {
+    /** Used by the pool while the block is free. */
+    StateBlock* pool_next;
+    /** Storage for the state. */
+    alignas(64) unsigned char storage[Size];
+  };
+};
+
+template <size_t Size>
+using StatePool = SlabPool<StateBlock<Size>, 32, 64>;
+
+}  // anonymous namespace
+
+void* AlState::operator new(std::size_t size) {
+  if (size <= 128) {
+    return StatePool<128>::get();
+  } else if (size <= 256) {
+    return StatePool<256>::get();
+  } else if (size <= 512) {
+    return StatePool<512>::get();
+  } else if (size <= 1024) {
+    return StatePool<1024>::get();
+  }
+  return ::operator new(size);
+}
+
+void AlState::operator delete(void* ptr, std::size_t size) {
+  if (size <= 128) {
+    StatePool<128>::put(static_cast<StateBlock<128>*>(ptr));
+  } else if (size <= 256) {
+    StatePool<256>::put(static_cast<StateBlock<256>*>(ptr));
+  } else if (size <= 512) {
+    StatePool<512>::put(static_cast<StateBlock<512>*>(ptr));
+  } else if (size <= 1024) {
+    StatePool<1024>::put(static_cast<StateBlock<1024>*>(ptr));
+  } else {
+    ::operator delete(ptr);
+  }
+}
+
+bool AlState::dependencies_scheduled() const {
+  for (const AlRequest& dep : dependencies) {
+    if (dep != NULL_REQUEST && !dep.is_stale()
+        && !dep.get_slot()->scheduled.load(std::memory_order_acquire)
+        && !dep->load(std::memory_order_acquire)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool AlState::dependencies_done() {
+  // Drop dependencies as they complete so each is only checked until then.
+  while (!dependencies.empty()) {
+    const AlRequest& dep = dependencies.back();
+    if (dep != NULL_REQUEST && !dep.is_stale()
+        && !dep->load(std::memory_order_acquire)) {
+      return false;
+    }
+    dependencies.pop_back();
+  }
+  return true;
 }
 
 AlRequest get_free_request() {
-  return std::make_shared<std::atomic<bool>>(false);
+  RequestSlot* slot = SlabPool<RequestSlot>::get();
+  slot->done.store(false, std::memory_order_relaxed);
+  slot->callback_state.store(RequestSlot::CallbackState::none,
+                             std::memory_order_relaxed);
+  slot->caller_progress = false;
+  slot->inline_state.store(nullptr, std::memory_order_relaxed);
+  slot->scheduled.store(false, std::memory_order_relaxed);
+  return AlRequest(slot, slot->generation.load(std::memory_order_relaxed));
+}
+
+void release_request(AlRequest& req) {
+  RequestSlot* slot = req.get_slot();
+  // Invalidate outstanding copies before the slot can be reused. Only one
+  // copy wins if several are released concurrently.
+  uint64_t gen = req.get_generation();
+  if (slot->generation.compare_exchange_strong(gen, gen + 1,
+                                               std::memory_order_acq_rel)) {
+    SlabPool<RequestSlot>::put(slot);
+  }
+  req = NULL_REQUEST;
+}
+
+namespace {
+
+/** Source of unique stream generations across progress engine instances. */
+std::atomic<uint64_t> stream_generation_counter(0);
+
+/** Per-thread cache of the last stream lookup in enqueue. */
+struct StreamCache {
+  /** Stream generation the entry was looked up in. */
+  uint64_t generation = 0;
+  /** Compute stream. */
+  void* stream = nullptr;
+  /** Input queue for the stream. */
+  InputQueue* queue = nullptr;
+};
+thread_local StreamCache stream_cache;
+
+/** Parse a wait policy name from the environment. */
+WaitPolicy parse_wait_policy(const char* name) {
+  std::string policy(name);
+  if (policy == "spin") {
+    return WaitPolicy::spin;
+  } else if (policy == "yield") {
+    return WaitPolicy::spin_yield;
+  } else if (policy == "block") {
+    return WaitPolicy::spin_block;
+  }
+  throw_al_exception("Unknown wait policy " + policy);
+}
+
+/**
+ * Record that state has been admitted or started, so operations depending on
+ * it may be admitted.
+ */
+void mark_scheduled(AlState* state) {
+  if (state->get_req() != NULL_REQUEST) {
+    state->get_req().get_slot()->scheduled.store(true,
+                                                 std::memory_order_release);
+  }
+}
+
+/**
+ * Atomically add amount to counter if that keeps it at most limit.
+ * A limit of 0 means no limit. If allow_first is true, this always succeeds
+ * when counter is 0, so a single oversized request can still run.
+ */
+bool try_acquire(std::atomic<size_t>& counter, size_t amount, size_t limit,
+                 bool allow_first) {
+  size_t cur = counter.load(std::memory_order_relaxed);
+  do {
+    if (limit != 0 && cur + amount > limit && !(allow_first && cur == 0)) {
+      return false;
+    }
+  } while (!counter.compare_exchange_weak(cur, cur + amount,
+                                          std::memory_order_relaxed));
+  return true;
 }
 
+}  // anonymous namespace
+
 ProgressEngine::ProgressEngine() {
   stop_flag = false;
-  started_flag = false;
+  num_started = 0;
+  num_bounded = 0;
+  num_small_bounded = 0;
+  bytes_in_flight = 0;
+  wait_policy = WaitPolicy::AL_PE_DEFAULT_WAIT_POLICY;
+  wait_spin_iters = AL_PE_WAIT_SPIN_ITERS;
+  num_blocked_waiters = 0;
+  char* env = std::getenv("AL_WAIT_POLICY");
+  if (env) {
+    wait_policy = parse_wait_policy(env);
+  }
+  wait_spin_iters = get_env_size("AL_WAIT_SPIN_ITERS", wait_spin_iters);
+  idle_spin_iters = get_env_size("AL_PE_IDLE_SPIN_ITERS",
+                                 AL_PE_IDLE_SPIN_ITERS);
+  idle_yield_iters = get_env_size("AL_PE_IDLE_YIELD_ITERS",
+                                  AL_PE_IDLE_YIELD_ITERS);
+  num_workers = get_env_size("AL_PE_NUM_THREADS", AL_PE_NUM_THREADS);
+  if (num_workers == 0) {
+    throw_al_exception("Must have at least one progress thread");
+  }
+  workers.reset(new ProgressWorker[num_workers]);
+  for (size_t i = 0; i < num_workers; ++i) {
+    workers[i].id = i;
+  }
+  num_sleeping = 0;
+  num_deferred = 0;
+  aggregate_mpi_polling = get_env_size("AL_PE_AGGREGATE_MPI_POLLING",
+                                       AL_PE_AGGREGATE_MPI_POLLING) != 0;
+  high_priority_slots = get_env_size("AL_PE_NUM_HIGH_PRIORITY_SLOTS",
+                                     AL_PE_NUM_HIGH_PRIORITY_SLOTS);
+  max_concurrent_ops = get_env_size("AL_PE_NUM_CONCURRENT_OPS",
+                                    AL_PE_NUM_CONCURRENT_OPS);
+  max_concurrent_small_ops = get_env_size("AL_PE_NUM_CONCURRENT_SMALL_OPS",
+                                          AL_PE_NUM_CONCURRENT_SMALL_OPS);
+  small_op_bytes = get_env_size("AL_PE_SMALL_OP_BYTES", AL_PE_SMALL_OP_BYTES);
+  max_bytes_in_flight = get_env_size("AL_PE_MAX_BYTES_IN_FLIGHT",
+                                     AL_PE_MAX_BYTES_IN_FLIGHT);
+  comm_bytes_quota = get_env_size("AL_PE_COMM_BYTES_QUOTA",
+                                  AL_PE_COMM_BYTES_QUOTA);
+  num_pipeline_stages = get_env_size("AL_PE_NUM_PIPELINE_STAGES",
+                                     AL_PE_NUM_PIPELINE_STAGES);
+  stream_chunk_size = get_env_size("AL_PE_NUM_STREAMS", AL_PE_NUM_STREAMS);
+  if (max_concurrent_ops == 0 || max_concurrent_small_ops == 0) {
+    throw_al_exception("Must allow at least one concurrent operation");
+  }
+  if (num_pipeline_stages == 0) {
+    throw_al_exception("Must have at least one pipeline stage");
+  }
+  if (stream_chunk_size == 0) {
+    throw_al_exception("Must have room for at least one stream");
+  }
   world_comm = new MPICommunicator(MPI_COMM_WORLD);
   // Initialze with the default stream.
+  std::fill_n(stream_chunks, AL_PE_MAX_STREAM_CHUNKS, nullptr);
+  stream_chunks[0] = new InputQueue*[stream_chunk_size];
+  stream_chunks[0][0] = new InputQueue();
   num_input_streams = 1;
-  stream_to_queue[DEFAULT_STREAM] = &request_queues[0];
+  stream_to_queue[DEFAULT_STREAM] = 0;
+  stream_generation = ++stream_generation_counter;
 }
 
 ProgressEngine::~ProgressEngine() {
+  const size_t cur_input_streams = num_input_streams.load();
+  for (size_t i = 0; i < cur_input_streams; ++i) {
+    delete &get_input_queue(i);
+  }
+  for (size_t chunk = 0; chunk < AL_PE_MAX_STREAM_CHUNKS; ++chunk) {
+    delete[] stream_chunks[chunk];
+  }
   delete world_comm;
 }
 
@@ -81,11 +308,15 @@ void ProgressEngine::run() {
   AL_CHECK_CUDA(cudaGetDevice(&device));
   cur_device = device;
 #endif
-  thread = std::thread(&ProgressEngine::engine, this);
-  profiling::name_thread(thread.native_handle(), "al-progress");
+  for (size_t i = 0; i < num_workers; ++i) {
+    workers[i].thread = std::thread(&ProgressEngine::engine, this, i);
+    profiling::name_thread(workers[i].thread.native_handle(),
+                           i == 0 ? "al-progress"
+                           : "al-progress-" + std::to_string(i));
+  }
   // Wait for the progress engine to start.
   std::unique_lock<std::mutex> lock(startup_mutex);
-  startup_cv.wait(lock, [this] {return started_flag.load() == true;});
+  startup_cv.wait(lock, [this] {return num_started.load() == num_workers;});
 }
 
 void ProgressEngine::stop() {
@@ -93,34 +324,223 @@ void ProgressEngine::stop() {
     throw_al_exception("Stop called twice on progress engine");
   }
   stop_flag.store(true, std::memory_order_release);
-  thread.join();
+  // Make sure no progress thread is asleep.
+  {
+    std::lock_guard<std::mutex> lock(work_mutex);
+    ++work_epoch;
+  }
+  work_cv.notify_all();
+  for (size_t i = 0; i < num_workers; ++i) {
+    workers[i].thread.join();
+  }
+  if (std::getenv("AL_PE_REPORT_STATS")) {
+    ProgressEngineStats stats = get_stats();
+    std::cout << world_comm->rank() << ": progress engine"
+              << " threads=" << num_workers
+              << " busy_iterations=" << stats.busy_iterations
+              << " idle_iterations=" << stats.idle_iterations
+              << " sleeps=" << stats.num_sleeps
+              << " steals=" << stats.num_steals << std::endl;
+  }
 }
 
 void ProgressEngine::enqueue(AlState* state) {
-  // Find the correct input queue for the stream, creating it if needed.
-  auto iter = stream_to_queue.find(state->get_compute_stream());
-  if (iter != stream_to_queue.end()) {
-    iter->second->q.push(state);
+  InputQueue* queue = lookup_stream_queue(state->get_compute_stream());
+  if (state->get_priority() == OpPriority::high) {
+    queue->high_q.push(state);
   } else {
-    size_t cur_stream = num_input_streams.load();
-    if (cur_stream == AL_PE_NUM_STREAMS) {
-      throw_al_exception("Using more streams than supported!");
+    queue->q.push(state);
+  }
+  wake_engine();
+}
+
+void ProgressEngine::run_inline(AlState* state) {
+  InputQueue* queue = lookup_stream_queue(state->get_compute_stream());
+  // Starting now would overtake operations still waiting to start on the
+  // stream (high-priority ones may overtake normal ones), so leave those
+  // cases to the engine.
+  const bool would_overtake = !queue->high_q.empty()
+    || (state->get_priority() == OpPriority::normal && !queue->q.empty());
+  const bool in_order = !state->uses_dependencies()
+    && (would_overtake || queue->blocked.load(std::memory_order_acquire));
+  // It must also fit the engine's concurrency and in-flight limits; if not,
+  // the engine starts it once there is room.
+  if (in_order || !state->dependencies_done()
+      || state->blocks() || !state->needs_completion()
+      || !can_start(state)) {
+    enqueue(state);
+    return;
+  }
+  state->start();
+  state->started_inline = true;
+#ifdef AL_DEBUG_HANG_CHECK
+  state->start_time = get_time();
+#endif
+#ifdef AL_TRACE
+  trace::record_pe_start(*state);
+#endif
+  mark_scheduled(state);
+  RequestSlot* slot = state->get_req().get_slot();
+  slot->caller_progress = true;
+  slot->inline_state.store(state, std::memory_order_release);
+}
+
+InputQueue* ProgressEngine::lookup_stream_queue(void* stream) {
+  // Most threads enqueue on the same stream repeatedly, so check the cached
+  // lookup first. The generation changes when any stream is retired.
+  const uint64_t generation = stream_generation.load(std::memory_order_acquire);
+  if (stream_cache.generation == generation && stream_cache.stream == stream) {
+    return stream_cache.queue;
+  }
+  InputQueue* queue = get_stream_queue(stream);
+  stream_cache.generation = generation;
+  stream_cache.stream = stream;
+  stream_cache.queue = queue;
+  return queue;
+}
+
+InputQueue* ProgressEngine::get_stream_queue(void* stream) {
+  std::lock_guard<std::mutex> lock(stream_mutex);
+  auto iter = stream_to_queue.find(stream);
+  if (iter != stream_to_queue.end()) {
+    return &get_input_queue(iter->second);
+  }
+  // Reuse a retired queue once everything on it has started and finished
+  // blocking. Its owning progress thread stays the same.
+  for (auto i = retired_queues.begin(); i != retired_queues.end(); ++i) {
+    InputQueue& queue = get_input_queue(*i);
+    if (queue.q.empty() && queue.high_q.empty() && queue.started_q.empty()
+        && !queue.blocked.load(std::memory_order_acquire)) {
+      queue.compute_stream = stream;
+      stream_to_queue[stream] = *i;
+      retired_queues.erase(i);
+      return &queue;
     }
-    request_queues[cur_stream].compute_stream = state->get_compute_stream();
-    stream_to_queue[state->get_compute_stream()] = &request_queues[cur_stream];
-    request_queues[cur_stream].q.push(state);
-    ++num_input_streams;
   }
+  // Add a new queue, allocating a new chunk if needed.
+  const size_t idx = num_input_streams.load(std::memory_order_relaxed);
+  size_t chunk, offset;
+  locate_input_queue(idx, chunk, offset);
+  if (chunk >= AL_PE_MAX_STREAM_CHUNKS) {
+    throw_al_exception("Using more streams than supported!");
+  }
+  if (stream_chunks[chunk] == nullptr) {
+    stream_chunks[chunk] = new InputQueue*[stream_chunk_size << chunk];
+  }
+  InputQueue* queue = new InputQueue();
+  queue->compute_stream = stream;
+  stream_chunks[chunk][offset] = queue;
+  stream_to_queue[stream] = idx;
+  // Publish the queue to the progress engine.
+  num_input_streams.store(idx + 1, std::memory_order_release);
+  return queue;
+}
+
+void ProgressEngine::retire_stream(void* stream) {
+  if (stream == DEFAULT_STREAM) {
+    throw_al_exception("Cannot retire the default stream");
+  }
+  std::lock_guard<std::mutex> lock(stream_mutex);
+  auto iter = stream_to_queue.find(stream);
+  if (iter == stream_to_queue.end()) {
+    return;
+  }
+  retired_queues.push_back(iter->second);
+  stream_to_queue.erase(iter);
+  // Invalidate cached lookups of this stream in all threads.
+  stream_generation.store(++stream_generation_counter,
+                          std::memory_order_release);
+}
+
+void ProgressEngine::wake_engine() {
+  // Pairs with the fence in sleep_until_work: either we see a thread is
+  // sleeping, or it sees the newly-pushed state.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (num_sleeping.load(std::memory_order_relaxed) > 0) {
+    {
+      std::lock_guard<std::mutex> lock(work_mutex);
+      ++work_epoch;
+    }
+    // Wake everyone: idle threads can also steal from the stream's owner.
+    work_cv.notify_all();
+  }
+}
+
+void ProgressEngine::wake_deferred() {
+  if (num_deferred.load() > 0) {
+    wake_engine();
+  }
+}
+
+bool ProgressEngine::has_ready_deferred(ProgressWorker& worker) {
+  for (const auto& deferred : worker.deferred) {
+    if (deferred.state->dependencies_done()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ProgressEngine::has_pending_input() {
+  const size_t cur_input_streams = num_input_streams.load();
+  for (size_t i = 0; i < cur_input_streams; ++i) {
+    const InputQueue& queue = get_input_queue(i);
+    if (!queue.q.empty() || !queue.high_q.empty()
+        || !queue.started_q.empty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void ProgressEngine::sleep_until_work(ProgressWorker& worker) {
+  std::unique_lock<std::mutex> lock(work_mutex);
+  const uint64_t epoch = work_epoch;
+  num_sleeping.fetch_add(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  // Re-check for work that was enqueued, or dependencies that completed,
+  // while we decided to sleep.
+  if (!has_pending_input() && !has_ready_deferred(worker)
+      && !stop_flag.load(std::memory_order_acquire)) {
+    worker.num_sleeps.store(
+      worker.num_sleeps.load(std::memory_order_relaxed) + 1,
+      std::memory_order_relaxed);
+    work_cv.wait(lock, [this, epoch] () {
+        return work_epoch != epoch
+          || stop_flag.load(std::memory_order_acquire);
+      });
+  }
+  num_sleeping.fetch_sub(1, std::memory_order_relaxed);
+}
+
+ProgressEngineStats ProgressEngine::get_stats() const {
+  ProgressEngineStats stats;
+  for (size_t i = 0; i < num_workers; ++i) {
+    const ProgressWorker& worker = workers[i];
+    stats.busy_iterations +=
+      worker.busy_iterations.load(std::memory_order_relaxed);
+    stats.idle_iterations +=
+      worker.idle_iterations.load(std::memory_order_relaxed);
+    stats.num_sleeps += worker.num_sleeps.load(std::memory_order_relaxed);
+    stats.num_steals += worker.num_steals.load(std::memory_order_relaxed);
+  }
+  return stats;
 }
 
 bool ProgressEngine::is_complete(AlRequest& req) {
   if (req == NULL_REQUEST) {
     return true;
   }
-  if (req->load(std::memory_order_acquire)) {
+  if (req.is_stale()) {
+    // Completion was already observed through a copy of the request.
     req = NULL_REQUEST;
     return true;
   }
+  step_inline(req);
+  if (req->load(std::memory_order_acquire)) {
+    release_request(req);
+    return true;
+  }
   return false;
 }
 
@@ -128,48 +548,264 @@ void ProgressEngine::wait_for_completion(AlRequest& req) {
   if (req == NULL_REQUEST) {
     return;
   }
-  // Spin until the request has completed.
+  wait_until([this, &req] () { return poll_request(req); },
+             !is_caller_driven(req));
+  release_request(req);
+}
+
+void ProgressEngine::step_inline(const AlRequest& req) {
+  if (!is_caller_driven(req)) {
+    return;
+  }
+  // Whoever takes the state has exclusive access to it; if another thread
+  // is stepping it, just check the completion flag.
+  RequestSlot* slot = req.get_slot();
+  AlState* state = slot->inline_state.exchange(nullptr,
+                                               std::memory_order_acquire);
+  if (state == nullptr) {
+    return;
+  }
+  // There is no pipeline to advance through, so only completion matters.
+  if (state->step() != PEAction::complete) {
+    slot->inline_state.store(state, std::memory_order_release);
+    return;
+  }
+  if (state->get_run_type() == RunType::bounded) {
+    release_admission(state);
+  }
+#ifdef AL_TRACE
+  trace::record_pe_done(*state);
+#endif
+  const bool persistent = state->is_persistent();
+  mark_complete(state->get_req());
+  if (!persistent) {
+    delete state;
+  }
+}
+
+bool ProgressEngine::poll_request(const AlRequest& req) {
+  if (req == NULL_REQUEST || req.is_stale()) {
+    return true;
+  }
+  step_inline(req);
+  // Note: This uses a sequentially-consistent load; see mark_complete.
+  return req->load();
+}
+
+bool ProgressEngine::test_all(AlRequest* reqs, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    if (!poll_request(reqs[i])) {
+      return false;
+    }
+  }
+  for (size_t i = 0; i < count; ++i) {
+    is_complete(reqs[i]);
+  }
+  return true;
+}
+
+size_t ProgressEngine::test_some(AlRequest* reqs, size_t count,
+                                 size_t* indices) {
+  size_t num_completed = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (reqs[i] != NULL_REQUEST && is_complete(reqs[i])) {
+      indices[num_completed++] = i;
+    }
+  }
+  return num_completed;
+}
+
+void ProgressEngine::wait_all(AlRequest* reqs, size_t count) {
+  // Requests before first_pending are known to be complete, so each poll
+  // only rescans the ones still outstanding.
+  size_t first_pending = 0;
+  const bool can_block = std::none_of(reqs, reqs + count, is_caller_driven);
+  wait_until([this, reqs, count, &first_pending] () {
+      while (first_pending < count && poll_request(reqs[first_pending])) {
+        ++first_pending;
+      }
+      return first_pending == count;
+    }, can_block);
+  for (size_t i = 0; i < count; ++i) {
+    is_complete(reqs[i]);
+  }
+}
+
+size_t ProgressEngine::wait_any(AlRequest* reqs, size_t count) {
+  size_t num_active = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (reqs[i] != NULL_REQUEST) {
+      ++num_active;
+    }
+  }
+  if (num_active == 0) {
+    return count;
+  }
+  size_t completed = count;
+  const bool can_block = std::none_of(reqs, reqs + count, is_caller_driven);
+  wait_until([this, reqs, count, &completed] () {
+      for (size_t i = 0; i < count; ++i) {
+        if (reqs[i] != NULL_REQUEST && poll_request(reqs[i])) {
+          completed = i;
+          return true;
+        }
+      }
+      return false;
+    }, can_block);
+  is_complete(reqs[completed]);
+  return completed;
+}
+
+void ProgressEngine::set_wait_policy(WaitPolicy policy, size_t spin_iters) {
+  wait_policy = policy;
+  wait_spin_iters = spin_iters;
+}
+
+void ProgressEngine::set_callback(AlRequest& req,
+                                  CompletionCallback callback) {
+  if (req == NULL_REQUEST || req.is_stale()) {
+    req = NULL_REQUEST;
+    callback();
+    return;
+  }
+  RequestSlot* slot = req.get_slot();
+  // Nobody would step a caller-driven operation once its request is handed
+  // over, so take its state (or wait for it to complete) to give to the
+  // progress engine.
+  AlState* inline_state = nullptr;
+  if (slot->caller_progress) {
+    while (!req->load(std::memory_order_acquire)) {
+      inline_state = slot->inline_state.exchange(nullptr,
+                                                 std::memory_order_acquire);
+      if (inline_state != nullptr) {
+        break;
+      }
+      // Another thread is stepping it; let it finish the step.
+      std::this_thread::yield();
+    }
+  }
+  slot->callback = std::move(callback);
+  auto expected = RequestSlot::CallbackState::none;
+  if (slot->callback_state.compare_exchange_strong(
+        expected, RequestSlot::CallbackState::attached,
+        std::memory_order_acq_rel)) {
+    // The progress engine now owns the request.
+    req = NULL_REQUEST;
+    if (inline_state != nullptr) {
+      // It is already admitted and started, so it must not wait behind
+      // later operations for admission again.
+      lookup_stream_queue(inline_state->get_compute_stream())
+        ->started_q.push(inline_state);
+      wake_engine();
+    }
+    return;
+  }
+  // Already completed. mark_complete sets the done flag right after changing
+  // the state; wait for that so it is finished with the slot.
   while (!req->load(std::memory_order_acquire)) {}
-  req = NULL_REQUEST;
+  CompletionCallback cb = std::move(slot->callback);
+  slot->callback = nullptr;
+  release_request(req);
+  cb();
+}
+
+void ProgressEngine::set_completion_executor(CompletionExecutor executor) {
+  completion_executor = std::move(executor);
+}
+
+void ProgressEngine::mark_complete(AlRequest& req) {
+  RequestSlot* slot = req.get_slot();
+  if (slot->callback_state.exchange(RequestSlot::CallbackState::completed,
+                                    std::memory_order_acq_rel)
+      == RequestSlot::CallbackState::attached) {
+    // Nobody else refers to the request, so recycle it before running the
+    // callback, which may start new operations.
+    CompletionCallback cb = std::move(slot->callback);
+    slot->callback = nullptr;
+    release_request(req);
+    wake_deferred();
+    if (completion_executor) {
+      completion_executor(std::move(cb));
+    } else {
+      cb();
+    }
+    return;
+  }
+  req->store(true);
+  wake_deferred();
+  if (num_blocked_waiters.load() > 0) {
+    // Acquire the lock so a waiter cannot miss the notification between
+    // checking the request and going to sleep.
+    {
+      std::lock_guard<std::mutex> lock(wait_mutex);
+    }
+    wait_cv.notify_all();
+  }
 }
 
 std::ostream& ProgressEngine::dump_state(std::ostream& ss) {
   // Note: This pulls *directly from internal state*.
   // This is *not* thread safe, and stuff might blow up.
   // You should only be dumping state where you don't care about that anyway.
-  for (auto&& stream_pipeline_pair : run_queues) {
-    ss << "Pipelined run queue for stream " << stream_pipeline_pair.first << ":\n";
-    auto&& pipeline = stream_pipeline_pair.second;
-    for (size_t stage = 0; stage < AL_PE_NUM_PIPELINE_STAGES; ++stage) {
-      const size_t stage_queue_size = pipeline[stage].size();
-      ss << "Stage " << stage << " run queue (" << stage_queue_size << "):\n";
-      for (size_t i = 0; i < stage_queue_size; ++i) {
-        ss << i << ": ";
-        if (pipeline[stage][i]) {
-          ss << pipeline[stage][i]->get_name() << " "
-             << pipeline[stage][i]->get_desc() << "\n";
-        } else {
-          ss << "(unknown)\n";
+  ProgressEngineStats stats = get_stats();
+  ss << "Progress engine: busy_iterations=" << stats.busy_iterations
+     << " idle_iterations=" << stats.idle_iterations
+     << " sleeps=" << stats.num_sleeps
+     << " steals=" << stats.num_steals
+     << " sleeping=" << num_sleeping.load() << "\n";
+  ss << "Admission: bounded=" << num_bounded.load()
+     << " small_bounded=" << num_small_bounded.load()
+     << " bytes_in_flight=" << bytes_in_flight.load() << "\n";
+  for (size_t w = 0; w < num_workers; ++w) {
+    ss << "Progress thread " << w << ":\n";
+    for (auto&& stream_pipeline_pair : workers[w].run_queues) {
+      ss << "Pipelined run queue for stream " << stream_pipeline_pair.first << ":\n";
+      auto&& pipeline = stream_pipeline_pair.second;
+      for (size_t stage = 0; stage < pipeline.size(); ++stage) {
+        const size_t stage_queue_size = pipeline[stage].size();
+        ss << "Stage " << stage << " run queue (" << stage_queue_size << "):\n";
+        for (size_t i = 0; i < stage_queue_size; ++i) {
+          ss << i << ": ";
+          if (pipeline[stage][i]) {
+            ss << pipeline[stage][i]->get_name() << " "
+               << pipeline[stage][i]->get_desc() << "\n";
+          } else {
+            ss << "(unknown)\n";
+          }
         }
       }
     }
+    ss << "Waiting on dependencies (" << workers[w].deferred.size() << "):\n";
+    for (const auto& deferred : workers[w].deferred) {
+      ss << deferred.state->get_name() << " " << deferred.state->get_desc()
+         << " queue=" << deferred.queue << "\n";
+    }
   }
   const size_t req_queue_size = num_input_streams.load();
   ss << "Request queues (" << req_queue_size << "):\n";
   for (size_t i = 0; i < req_queue_size; ++i) {
-    ss << i << ": blocked=" << request_queues[i].blocked;
-    const size_t front = request_queues[i].q.front.load();
-    const size_t back = request_queues[i].q.back.load();
-    ss << " front=" << front << " back=" << back << "\n";
-    for (size_t j = front; j < back; ++j) {
-      ss << "\t" << j << ": " << request_queues[i].q.data[j]->get_name()
-         << " " << request_queues[i].q.data[j]->get_desc() << "\n";
+    const InputQueue& queue = get_input_queue(i);
+    ss << i << ": stream=" << queue.compute_stream
+       << " blocked=" << queue.blocked.load() << "\n";
+    for (const MPSCQueue* q : {&queue.started_q, &queue.high_q, &queue.q}) {
+      const size_t front = q->front.load();
+      const size_t back = q->back.load();
+      ss << (q == &queue.started_q ? "\tstarted"
+             : q == &queue.high_q ? "\thigh" : "\tnormal")
+         << " front=" << front << " back=" << back << "\n";
+      for (size_t j = front; j < back; ++j) {
+        const AlState* req = q->cells[j & (q->size-1)].data;
+        if (req) {
+          ss << "\t" << j << ": " << req->get_name()
+             << " " << req->get_desc() << "\n";
+        }
+      }
     }
   }
   return ss;
 }
 
-void ProgressEngine::bind() {
+void ProgressEngine::bind(size_t worker_id) {
   // Determine topology information.
   hwloc_topology_t topo;
   hwloc_topology_init(&topo);
@@ -190,6 +826,12 @@ void ProgressEngine::bind() {
   if (numa_node == NULL) {
     throw_al_exception("Could not get NUMA node.");
   }
+  // Determine how many cores are in this NUMA node.
+  int num_cores = hwloc_get_nbobjs_inside_cpuset_by_type(
+    topo, numa_node->cpuset, HWLOC_OBJ_CORE);
+  if (num_cores <= 0) {
+    throw_al_exception("Could not determine number of cores.");
+  }
   int core_to_bind = -1;
   // Check if the core has been manually set.
   char* env = std::getenv("AL_PROGRESS_CORE");
@@ -197,12 +839,6 @@ void ProgressEngine::bind() {
     // Note: This still binds within the current NUMA node.
     core_to_bind = std::atoi(env);
   } else {
-    // Determine how many cores are in this NUMA node.
-    int num_cores = hwloc_get_nbobjs_inside_cpuset_by_type(
-      topo, numa_node->cpuset, HWLOC_OBJ_CORE);
-    if (num_cores <= 0) {
-      throw_al_exception("Could not determine number of cores.");
-    }
     // Determine which core on this NUMA node to map us to.
     // Support specifying this in the environment too.
     int ranks_per_numa_node = -1;
@@ -222,11 +858,21 @@ void ProgressEngine::bind() {
     // the last core in our chunk.
     core_to_bind = (numa_rank + 1)*(num_cores / ranks_per_numa_node) - 1;
   }
+  // Additional threads take the cores below the first one, wrapping around
+  // within the NUMA node if needed.
+  if (worker_id > 0 && core_to_bind >= 0) {
+    core_to_bind = (core_to_bind - static_cast<int>(worker_id % num_cores)
+                    + num_cores) % num_cores;
+  }
   hwloc_obj_t core = hwloc_get_obj_inside_cpuset_by_type(
     topo, numa_node->cpuset, HWLOC_OBJ_CORE, core_to_bind);
   if (core == NULL) {
     throw_al_exception("Could not get core.");
   }
+  if (worker_id == 0) {
+    bound_numa_node = static_cast<int>(numa_node->os_index);
+    bound_core = core_to_bind;
+  }
   hwloc_cpuset_t coreset = hwloc_bitmap_dup(core->cpuset);
   hwloc_bitmap_singlify(coreset);
   if (hwloc_set_cpubind(topo, coreset, HWLOC_CPUBIND_THREAD) == -1) {
@@ -238,148 +884,454 @@ void ProgressEngine::bind() {
   hwloc_topology_destroy(topo);
 }
 
-void ProgressEngine::engine() {
-#ifdef AL_HAS_CUDA
-  // Set the current CUDA device for the thread.
-  AL_CHECK_CUDA_NOSYNC(cudaSetDevice(cur_device.load()));
-#endif
-  bind();
-  // Notify the main thread we're now running.
-  {
-    std::unique_lock<std::mutex> lock(startup_mutex);
-    started_flag = true;
+bool ProgressEngine::start_ops(ProgressWorker& worker) {
+  bool found_work = false;
+  size_t cur_input_streams = num_input_streams.load(std::memory_order_acquire);
+  // Operations deferred earlier were enqueued before anything still queued.
+  found_work |= start_deferred(worker);
+  // Caller-driven operations handed over were started before those too.
+  for (size_t i = worker.id; i < cur_input_streams; i += num_workers) {
+    MPSCQueue& q = get_input_queue(i).started_q;
+    while (AlState* req = q.pop()) {
+      launch_op(worker, req, i);
+      found_work = true;
+    }
   }
-  startup_cv.notify_one();
-  while (!stop_flag.load(std::memory_order_acquire)) {
-    // Check for newly-submitted requests.
-    size_t cur_input_streams = num_input_streams.load();
-    for (size_t i = 0; i < cur_input_streams; ++i) {
-      if (!request_queues[i].blocked) {
-        AlState* req = request_queues[i].q.peek();
-        if (req != nullptr) {
-          // Add to the correct run queue if one is available.
-          bool do_start = false;
-          switch (req->get_run_type()) {
-          case RunType::bounded:
-            if (num_bounded < AL_PE_NUM_CONCURRENT_OPS) {
-              ++num_bounded;
-              do_start = true;
-            }
-            break;
-          case RunType::unbounded:
-            do_start = true;
-            break;
-          }
-          if (do_start) {
-            // Add to end of first pipeline stage.
-            // Create run queues if needed.
-            if (!run_queues.count(req->get_compute_stream())) {
-              run_queues.emplace(req->get_compute_stream(),
-                                 decltype(run_queues)::mapped_type{});
-            }
-            run_queues[req->get_compute_stream()][0].push_back(req);
-            req->start();
+  // Start high-priority operations on all streams first, so they are not held
+  // up behind normal operations that are waiting for a free slot.
+  for (size_t i = worker.id; i < cur_input_streams; i += num_workers) {
+    found_work |= start_op(worker, i, get_input_queue(i).high_q);
+  }
+  for (size_t i = worker.id; i < cur_input_streams; i += num_workers) {
+    found_work |= start_op(worker, i, get_input_queue(i).q);
+  }
+  return found_work;
+}
+
+bool ProgressEngine::start_op(ProgressWorker& worker, size_t i,
+                              MPSCQueue& q) {
+  AlState* req = q.peek();
+  if (req == nullptr) {
+    return false;
+  }
+  if (req->uses_dependencies()) {
+    // Admit this in stream order, so it does not matter in what order its
+    // dependencies finish on each rank, but only after they have been
+    // admitted, so it cannot take the room they need. It is not otherwise
+    // ordered with the rest of the stream, so then take it off the queue to
+    // let later operations start while it waits for them to complete.
+    if (!req->dependencies_scheduled() || !can_start(req)) {
+      return true;
+    }
+    q.pop_always();
+    mark_scheduled(req);
+    worker.deferred.push_back({req, i});
+    num_deferred.fetch_add(1);
+    return true;
+  }
+  if (get_input_queue(i).blocked.load(std::memory_order_relaxed)) {
+    return false;
+  }
+  // Add to the correct run queue if one is available.
+  if (can_start(req)) {
+    launch_op(worker, req, i);
+    q.pop_always();
+  }
+  return true;
+}
+
+bool ProgressEngine::start_deferred(ProgressWorker& worker) {
+  bool started = false;
+  // These were admitted when they were dequeued.
+  for (auto i = worker.deferred.begin(); i != worker.deferred.end();) {
+    if (i->state->dependencies_done()) {
+      launch_op(worker, i->state, i->queue);
+      i = worker.deferred.erase(i);
+      num_deferred.fetch_sub(1, std::memory_order_relaxed);
+      started = true;
+    } else {
+      ++i;
+    }
+  }
+  return started;
+}
+
+bool ProgressEngine::can_start(AlState* req) {
+  switch (req->get_run_type()) {
+  case RunType::bounded:
+    return admit(req);
+  case RunType::unbounded:
+    return true;
+  }
+  return false;
+}
+
+void ProgressEngine::launch_op(ProgressWorker& worker, AlState* req,
+                               size_t i) {
+  mark_scheduled(req);
+  // Caller-driven operations handed over with a callback already started.
+  if (!req->started_inline) {
+    req->start();
 #ifdef AL_DEBUG_HANG_CHECK
-            req->start_time = get_time();
+    req->start_time = get_time();
 #endif
 #ifdef AL_TRACE
-            trace::record_pe_start(*req);
+    trace::record_pe_start(*req);
 #endif
-            request_queues[i].q.pop_always();
-            if (req->blocks()) {
-              request_queues[i].blocked = true;
-              blocking_reqs[req] = i;
-            }
+  }
+  // Add to end of first pipeline stage.
+  // Create run queues if needed.
+  {
+    std::lock_guard<std::mutex> lock(worker.run_mutex);
+    auto& pipeline = worker.run_queues[req->get_compute_stream()];
+    if (pipeline.empty()) {
+      pipeline.resize(num_pipeline_stages);
+    }
+    pipeline[0].push_back(req);
+  }
+  if (req->blocks()) {
+    get_input_queue(i).blocked.store(true, std::memory_order_relaxed);
+    worker.blocking_reqs[req] = i;
+  }
+}
+
+bool ProgressEngine::admit(AlState* req) {
+  const size_t bytes = req->get_bytes();
+  const bool small = bytes != 0 && bytes <= small_op_bytes;
+  // High-priority operations may also use the reserved slots.
+  const size_t reserved =
+    req->get_priority() == OpPriority::high ? high_priority_slots : 0;
+  std::atomic<size_t>& count = small ? num_small_bounded : num_bounded;
+  const size_t max_count =
+    (small ? max_concurrent_small_ops : max_concurrent_ops) + reserved;
+  if (!try_acquire(count, 1, max_count, false)) {
+    return false;
+  }
+  req->admitted_small = small;
+  req->admitted_bytes = 0;
+  if (small || bytes == 0) {
+    return true;
+  }
+  if (!try_acquire(bytes_in_flight, bytes, max_bytes_in_flight, true)) {
+    count.fetch_sub(1, std::memory_order_relaxed);
+    return false;
+  }
+  const void* key = req->get_quota_key();
+  if (comm_bytes_quota != 0 && key != nullptr) {
+    std::lock_guard<std::mutex> lock(quota_mutex);
+    size_t& comm_bytes = comm_bytes_in_flight[key];
+    if (comm_bytes != 0 && comm_bytes + bytes > comm_bytes_quota) {
+      bytes_in_flight.fetch_sub(bytes, std::memory_order_relaxed);
+      count.fetch_sub(1, std::memory_order_relaxed);
+      return false;
+    }
+    comm_bytes += bytes;
+  }
+  req->admitted_bytes = bytes;
+  return true;
+}
+
+void ProgressEngine::release_admission(AlState* req) {
+  if (req->admitted_small) {
+    num_small_bounded.fetch_sub(1, std::memory_order_relaxed);
+    return;
+  }
+  num_bounded.fetch_sub(1, std::memory_order_relaxed);
+  const size_t bytes = req->admitted_bytes;
+  if (bytes == 0) {
+    return;
+  }
+  bytes_in_flight.fetch_sub(bytes, std::memory_order_relaxed);
+  const void* key = req->get_quota_key();
+  if (comm_bytes_quota != 0 && key != nullptr) {
+    std::lock_guard<std::mutex> lock(quota_mutex);
+    auto iter = comm_bytes_in_flight.find(key);
+    iter->second -= bytes;
+    if (iter->second == 0) {
+      comm_bytes_in_flight.erase(iter);
+    }
+  }
+}
+
+void ProgressEngine::poll_mpi_requests(ProgressWorker& worker) {
+  worker.mpi_reqs.clear();
+  worker.mpi_states.clear();
+  for (auto&& stream_pipeline_pair : worker.run_queues) {
+    for (auto&& stage_queue : stream_pipeline_pair.second) {
+      for (AlState* req : stage_queue) {
+        if (req->paused_for_advance || !req->try_claim()) {
+          continue;
+        }
+        size_t count;
+        MPI_Request* mpi_reqs = req->get_mpi_requests(count);
+        bool active = false;
+        if (req->pending_action == PEAction::cont) {
+          for (size_t j = 0; j < count; ++j) {
+            active |= mpi_reqs[j] != MPI_REQUEST_NULL;
           }
         }
+        if (!active) {
+          req->release_claim();
+          continue;
+        }
+        // Keep the claim so nobody changes the requests until the results
+        // are copied back.
+        worker.mpi_states.push_back(
+          {req, mpi_reqs, worker.mpi_reqs.size(), count});
+        for (size_t j = 0; j < count; ++j) {
+          worker.mpi_reqs.push_back(mpi_reqs[j]);
+        }
       }
     }
-    // Process one step of each in-progress request.
-    for (auto&& stream_pipeline_pair : run_queues) {
-      auto&& pipeline = stream_pipeline_pair.second;
-      for (size_t stage = 0; stage < AL_PE_NUM_PIPELINE_STAGES; ++stage) {
-        // Process this stage of the pipeline.
-        for (auto i = pipeline[stage].begin(); i != pipeline[stage].end();) {
-          AlState* req = *i;
-          // Simply skip over paused states.
-          if (req->paused_for_advance) {
-            ++i;
+  }
+  if (worker.mpi_states.empty()) {
+    return;
+  }
+  worker.mpi_indices.resize(worker.mpi_reqs.size());
+  int outcount;
+  MPI_Testsome(worker.mpi_reqs.size(), worker.mpi_reqs.data(), &outcount,
+               worker.mpi_indices.data(), MPI_STATUSES_IGNORE);
+  // Completed requests are now MPI_REQUEST_NULL; copy them back.
+  for (const auto& polled : worker.mpi_states) {
+    bool waiting = false;
+    for (size_t j = 0; j < polled.count; ++j) {
+      polled.reqs[j] = worker.mpi_reqs[polled.offset + j];
+      waiting |= polled.reqs[j] != MPI_REQUEST_NULL;
+    }
+    polled.state->waiting_on_mpi = waiting;
+    polled.state->release_claim();
+  }
+}
+
+bool ProgressEngine::run_ops(ProgressWorker& worker) {
+  bool found_work = false;
+  if (aggregate_mpi_polling.load(std::memory_order_relaxed)) {
+    poll_mpi_requests(worker);
+  }
+  // Only this worker modifies its run queues, so it can read them without
+  // the lock, but must hold it when changing them.
+  for (auto&& stream_pipeline_pair : worker.run_queues) {
+    auto&& pipeline = stream_pipeline_pair.second;
+    for (size_t stage = 0; stage < pipeline.size(); ++stage) {
+      if (!pipeline[stage].empty()) {
+        found_work = true;
+      }
+      // Whether a state that is ordered by stream remains ahead of i; states
+      // that use dependencies do not hold others back.
+      bool ordered_ahead = false;
+      // Process this stage of the pipeline.
+      for (auto i = pipeline[stage].begin(); i != pipeline[stage].end();) {
+        AlState* req = *i;
+        // Simply skip over paused states and states another worker is
+        // currently stepping.
+        if (req->paused_for_advance || !req->try_claim()) {
+          ordered_ahead |= !req->uses_dependencies();
+          ++i;
+          continue;
+        }
+        // Apply the result of a stolen step if there is one.
+        PEAction action = req->pending_action;
+        if (action == PEAction::cont) {
+          if (req->waiting_on_mpi) {
+            // Polling just found its MPI requests are still active.
+            req->waiting_on_mpi = false;
           } else {
-            PEAction action = req->step();
-            switch (action) {
-            case PEAction::cont:
-              // Nothing to do here.
+            action = req->step();
+          }
+        } else {
+          req->pending_action = PEAction::cont;
+        }
+        switch (action) {
+        case PEAction::cont:
+          // Nothing to do here.
 #ifdef AL_DEBUG_HANG_CHECK
-              // Check whether we have hung.
-              if (!req->hang_reported) {
-                double t = get_time();
-                if (t - req->start_time > 10.0 + world_comm->rank()) {
-                  std::cout << world_comm->rank()
-                            << ": Progress engine detected a possible hang"
-                            << " state=" << req << " " << req->get_name()
-                            << " compute_stream=" << req->get_compute_stream()
-                            << " run_type="
-                            << (req->get_run_type() == RunType::bounded ? "bounded" : "unbounded")
-                            << " blocks=" << req->blocks() << std::endl;
-                  req->hang_reported = true;
-                }
-              }
-#endif
-              ++i;
-              break;
-            case PEAction::advance:
-#ifdef AL_DEBUG
-              // Ensure we don't advance too far.
-              if (stage + 1 >= AL_PE_NUM_PIPELINE_STAGES) {
-                throw_al_exception("Trying to advance pipeline stage too far");
-              }
+          // Check whether we have hung.
+          if (!req->hang_reported) {
+            double t = get_time();
+            if (t - req->start_time > 10.0 + world_comm->rank()) {
+              std::cout << world_comm->rank()
+                        << ": Progress engine detected a possible hang"
+                        << " state=" << req << " " << req->get_name()
+                        << " compute_stream=" << req->get_compute_stream()
+                        << " run_type="
+                        << (req->get_run_type() == RunType::bounded ? "bounded" : "unbounded")
+                        << " blocks=" << req->blocks() << std::endl;
+              req->hang_reported = true;
+            }
+          }
 #endif
-              // Only move if this is the head of the pipeline stage.
-              if (i == pipeline[stage].begin()) {
-                pipeline[stage+1].push_back(req);
-                i = pipeline[stage].erase(i);
-              } else {
-                req->paused_for_advance = true;
-                ++i;
-              }
-              break;
-            case PEAction::complete:
-              if (req->needs_completion()) {
-                req->get_req()->store(true, std::memory_order_release);
-              }
-              if (req->get_run_type() == RunType::bounded) {
-                --num_bounded;
-              }
-              if (req->blocks()) {
-                // Unblock the associated input queue.
-                request_queues[blocking_reqs[req]].blocked = false;
-                blocking_reqs.erase(req);
-              }
+          ordered_ahead |= !req->uses_dependencies();
+          req->release_claim();
+          ++i;
+          break;
+        case PEAction::advance:
+          // Ensure we don't advance too far. The number of stages is set at
+          // runtime, so this is always checked.
+          if (stage + 1 >= pipeline.size()) {
+            throw_al_exception("Trying to advance pipeline stage too far");
+          }
+          // Only move if no state ahead of this must advance first.
+          if (!ordered_ahead || req->uses_dependencies()) {
+            std::lock_guard<std::mutex> lock(worker.run_mutex);
+            pipeline[stage+1].push_back(req);
+            i = pipeline[stage].erase(i);
+          } else {
+            req->paused_for_advance = true;
+            ++i;
+          }
+          req->release_claim();
+          break;
+        case PEAction::complete: {
+          if (req->get_run_type() == RunType::bounded) {
+            release_admission(req);
+          }
+          if (req->blocks()) {
+            // Unblock the associated input queue.
+            get_input_queue(worker.blocking_reqs[req]).blocked.store(
+              false, std::memory_order_release);
+            worker.blocking_reqs.erase(req);
+          }
 #ifdef AL_TRACE
-              trace::record_pe_done(*req);
+          trace::record_pe_done(*req);
 #endif
-              delete req;
-              i = pipeline[stage].erase(i);
-              break;
-            default:
-              throw_al_exception("Unknown PEAction");
-              break;
-            }
+          // Once removed, no other worker can reach the state, and since we
+          // hold its claim, no other worker is using it.
+          {
+            std::lock_guard<std::mutex> lock(worker.run_mutex);
+            i = pipeline[stage].erase(i);
+          }
+          // A persistent state may be restarted as soon as its request
+          // completes, so it must not be touched after that.
+          const bool persistent = req->is_persistent();
+          if (req->needs_completion()) {
+            mark_complete(req->get_req());
+          } else if (req->get_req() != NULL_REQUEST) {
+            // Nobody will wait on this, so recycle the request now.
+            release_request(req->get_req());
           }
+          if (!persistent) {
+            delete req;
+          }
+          break;
+        }
+        default:
+          throw_al_exception("Unknown PEAction");
+          break;
         }
-        // Check whether we can advance paused states.
-        for (auto i = pipeline[stage].begin(); i != pipeline[stage].end();) {
-          AlState* req = *i;
-          if (req->paused_for_advance) {
-            // Move to the next stage.
-            req->paused_for_advance = false;
+      }
+      // Check whether we can advance paused states.
+      for (auto i = pipeline[stage].begin(); i != pipeline[stage].end();) {
+        AlState* req = *i;
+        if (req->uses_dependencies()) {
+          ++i;  // Never paused, and does not hold back the others.
+          continue;
+        }
+        if (req->paused_for_advance && req->try_claim()) {
+          // Move to the next stage.
+          req->paused_for_advance = false;
+          {
+            std::lock_guard<std::mutex> lock(worker.run_mutex);
             pipeline[stage+1].push_back(req);
             i = pipeline[stage].erase(i);
-          } else {
-            break;  // Nothing at the head to advance.
+          }
+          req->release_claim();
+        } else {
+          break;  // Nothing at the head to advance.
+        }
+      }
+    }
+  }
+  return found_work;
+}
+
+bool ProgressEngine::steal_step(ProgressWorker& worker) {
+  for (size_t k = 1; k < num_workers; ++k) {
+    ProgressWorker& victim = workers[(worker.id + k) % num_workers];
+    AlState* stolen = nullptr;
+    {
+      // Do not wait on a busy victim; just try the next one.
+      std::unique_lock<std::mutex> lock(victim.run_mutex, std::try_to_lock);
+      if (!lock.owns_lock()) {
+        continue;
+      }
+      for (auto&& stream_pipeline_pair : victim.run_queues) {
+        for (auto&& stage_queue : stream_pipeline_pair.second) {
+          for (AlState* req : stage_queue) {
+            if (req->try_claim()) {
+              // Leave states that are waiting on the owner alone.
+              if (!req->paused_for_advance
+                  && req->pending_action == PEAction::cont) {
+                stolen = req;
+                break;
+              }
+              req->release_claim();
+            }
+          }
+          if (stolen) {
+            break;
           }
         }
+        if (stolen) {
+          break;
+        }
+      }
+    }
+    if (stolen) {
+      // The owner will not delete the state while we hold its claim.
+      stolen->pending_action = stolen->step();
+      stolen->release_claim();
+      worker.num_steals.store(
+        worker.num_steals.load(std::memory_order_relaxed) + 1,
+        std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+void ProgressEngine::engine(size_t worker_id) {
+  ProgressWorker& worker = workers[worker_id];
+#ifdef AL_HAS_CUDA
+  // Set the current CUDA device for the thread.
+  AL_CHECK_CUDA_NOSYNC(cudaSetDevice(cur_device.load()));
+#endif
+  bind(worker_id);
+  // Notify the main thread we're now running.
+  {
+    std::unique_lock<std::mutex> lock(startup_mutex);
+    ++num_started;
+  }
+  startup_cv.notify_one();
+  // Number of consecutive iterations without any work.
+  size_t idle_streak = 0;
+  while (!stop_flag.load(std::memory_order_acquire)) {
+    // Check for newly-submitted requests.
+    bool idle = !start_ops(worker);
+    // Process one step of each in-progress request.
+    if (run_ops(worker)) {
+      idle = false;
+    } else if (num_workers > 1 && steal_step(worker)) {
+      // Nothing of our own to do, so help another thread.
+      idle = false;
+    }
+    // Back off when there is no work: spin briefly to keep latency low, then
+    // yield, then sleep until new work is enqueued.
+    if (idle) {
+      worker.idle_iterations.store(
+        worker.idle_iterations.load(std::memory_order_relaxed) + 1,
+        std::memory_order_relaxed);
+      ++idle_streak;
+      if (idle_streak > idle_spin_iters + idle_yield_iters) {
+        sleep_until_work(worker);
+        idle_streak = 0;
+      } else if (idle_streak > idle_spin_iters) {
+        std::this_thread::yield();
       }
+    } else {
+      worker.busy_iterations.store(
+        worker.busy_iterations.load(std::memory_order_relaxed) + 1,
+        std::memory_order_relaxed);
+      idle_streak = 0;
     }
   }
 }
@@ -29,9 +29,12 @@
 
 #pragma once
 
+#include <mpi.h>
+#include <cstdint>
 #include <limits>
 #include <functional>
 #include <list>
+#include <memory>
 #include <unordered_map>
 #include <thread>
 #include <atomic>
@@ -41,6 +44,8 @@
 #include <algorithm>
 #include <ostream>
 #include <array>
+#include <cstddef>
+#include <vector>
 
 namespace Al {
 
@@ -52,14 +57,98 @@ namespace internal {
 namespace profiling {
 struct ProfileRange;
 }
+class AlState;
+
+/**
+ * Completion flag backing a request.
+ * Slots are pooled and padded to a cache line so that polling one request
+ * does not contend with others.
+ */
+struct alignas(64) RequestSlot {
+  /** Whether a callback is attached; see ProgressEngine::set_callback. */
+  enum class CallbackState : uint8_t {
+    /** No callback attached and the operation has not completed. */
+    none,
+    /** A callback is attached and will be run by the progress engine. */
+    attached,
+    /** The operation completed before a callback was attached. */
+    completed
+  };
+  /** Set when the associated operation completes. */
+  std::atomic<bool> done{false};
+  /** Callback state, used to hand the callback off to the engine. */
+  std::atomic<CallbackState> callback_state{CallbackState::none};
+  /** Callback to run on completion, valid when attached. */
+  CompletionCallback callback;
+  /**
+   * Whether the operation is driven by the threads that test or wait on it
+   * rather than by the progress engine. Set before the request is returned.
+   */
+  bool caller_progress = false;
+  /**
+   * State of a caller-driven operation. A thread steps it only after taking
+   * it by exchanging in nullptr, and puts it back if it is not finished.
+   */
+  std::atomic<AlState*> inline_state{nullptr};
+  /**
+   * Set once the operation has been admitted by the progress engine or
+   * started by its caller, so operations depending on it may be admitted.
+   */
+  std::atomic<bool> scheduled{false};
+  /** Incremented each time the slot is released back to the pool. */
+  std::atomic<uint64_t> generation{0};
+  /** Used by the pool while the slot is free. */
+  RequestSlot* pool_next = nullptr;
+};
 
 /**
  * Request handle for non-blocking operations.
- * The atomic flag is used to check for completion.
+ * This refers to a pooled RequestSlot, whose atomic flag is used to check for
+ * completion. Handles are plain values and may be copied freely. The slot is
+ * released when the user observes completion (via is_complete or
+ * wait_for_completion), after which its generation no longer matches that of
+ * any outstanding copies, so they also read as complete.
  */
-using AlRequest = std::shared_ptr<std::atomic<bool>>;
+class AlRequest {
+ public:
+  /** Create a null request. */
+  AlRequest() : slot(nullptr), generation(0) {}
+  AlRequest(std::nullptr_t) : AlRequest() {}
+  /** Refer to generation gen of slot_. */
+  AlRequest(RequestSlot* slot_, uint64_t gen) : slot(slot_), generation(gen) {}
+  /** Access the completion flag. */
+  std::atomic<bool>* operator->() const { return &slot->done; }
+  std::atomic<bool>& operator*() const { return slot->done; }
+  friend bool operator==(const AlRequest& a, const AlRequest& b) {
+    return a.slot == b.slot && a.generation == b.generation;
+  }
+  friend bool operator!=(const AlRequest& a, const AlRequest& b) {
+    return !(a == b);
+  }
+  /** True if the slot has been released since this handle was created. */
+  bool is_stale() const {
+    return slot->generation.load(std::memory_order_acquire) != generation;
+  }
+  /** Return the underlying slot. */
+  RequestSlot* get_slot() const { return slot; }
+  /** Return the generation of the slot this refers to. */
+  uint64_t get_generation() const { return generation; }
+ private:
+  /** Slot holding the completion flag. */
+  RequestSlot* slot;
+  /** Generation of the slot this request refers to. */
+  uint64_t generation;
+};
+
 /** Return a free request for use. */
 AlRequest get_free_request();
+/**
+ * Return the request's slot to the pool and set req to NULL_REQUEST.
+ * This is a no-op for the slot if it was already released through a copy.
+ * The operation must be complete; the slot is not accessed through req (or
+ * copies of it) afterward except to check its generation.
+ */
+void release_request(AlRequest& req);
 /** Special marker for null requests. */
 static constexpr std::nullptr_t NULL_REQUEST = nullptr;
 /** Special marker for the default compute stream. */
@@ -72,6 +161,16 @@ enum class RunType {
   unbounded
 };
 
+/** How a user thread waits for a request to complete. */
+enum class WaitPolicy {
+  /** Poll the request until it completes. */
+  spin,
+  /** Poll for a while, then yield the core between polls. */
+  spin_yield,
+  /** Poll for a while, then sleep until the progress engine wakes us. */
+  spin_block
+};
+
 /** Actions a state can ask the progress engine to do. */
 enum class PEAction {
   /** Do nothing (i.e. keep running as it is now). */
@@ -99,6 +198,19 @@ enum class PEAction {
  * enqueued. If a state asks to advance but it is not at the head of its
  * pipeline stage, step will not be called again until it has successfully
  * advanced.
+ *
+ * With multiple progress threads, step may be called from any of them, but
+ * never concurrently for the same state. Steps of different states (even on
+ * the same compute stream) may run concurrently.
+ *
+ * Instead of relying on stream order, a state may declare the requests it
+ * depends on with set_dependencies. It is still admitted in stream order, so
+ * every rank admits operations in the same order whatever order their
+ * dependencies finish in, but only once its dependencies have been admitted,
+ * so it cannot take the room they need. It then leaves the stream and starts
+ * once its dependencies have completed, regardless of whether the stream is
+ * blocked, and advances through the pipeline without waiting for the states
+ * ahead of it. Other states on the stream are likewise not ordered after it.
  */
 class AlState {
   friend class ProgressEngine;
@@ -106,6 +218,13 @@ class AlState {
   /** Create with an associated request. */
   AlState(AlRequest req_) : req(req_) {}
   virtual ~AlState();
+  /**
+   * Allocate states from per-size-class pools instead of the heap.
+   * States are typically created by a user thread and deleted by a progress
+   * thread, so this avoids a cross-thread malloc/free for every operation.
+   */
+  static void* operator new(std::size_t size);
+  static void operator delete(void* ptr, std::size_t size);
   /**
    * Perform initial setup of the algorithm.
    * This is called by the progress engine when the operation begins execution.
@@ -124,12 +243,67 @@ class AlState {
   virtual void* get_compute_stream() const { return DEFAULT_STREAM; }
   /** Return the run queue type this operation should use. */
   virtual RunType get_run_type() const { return RunType::bounded; }
+  /**
+   * Return the number of bytes this operation communicates, used for
+   * admission control; 0 if unknown.
+   */
+  virtual size_t get_bytes() const { return 0; }
+  /**
+   * Return a key identifying the communicator this operation uses, for
+   * per-communicator quotas; nullptr if there is none.
+   */
+  virtual const void* get_quota_key() const { return nullptr; }
+  /** Return the scheduling priority of this operation. */
+  OpPriority get_priority() const { return priority; }
+  /** Set the scheduling priority; this must be done before enqueueing. */
+  void set_priority(OpPriority priority_) { priority = priority_; }
   /** True if this is meant to block operations until completion. */
   virtual bool blocks() const { return false; }
+  /**
+   * Schedule this after the operations of deps complete, instead of in order
+   * with the other operations on its compute stream. deps may be empty, in
+   * which case this can start immediately. This must be done before
+   * enqueueing. Dependencies are only polled, so caller-driven ones must
+   * still be tested or waited on to make progress.
+   */
+  void set_dependencies(std::vector<AlRequest> deps) {
+    dependencies = std::move(deps);
+    unordered = true;
+  }
+  /** True if this is scheduled by its dependencies rather than stream order. */
+  bool uses_dependencies() const { return unordered; }
+  /** Return true if every dependency has completed. */
+  bool dependencies_done();
+  /** Return true if every dependency has been admitted or has completed. */
+  bool dependencies_scheduled() const;
+  /**
+   * Keep this state when it completes so that it can be run again, instead
+   * of having the progress engine delete it. Its owner deletes it once it is
+   * no longer running.
+   */
+  void set_persistent() { persistent = true; }
+  /** True if the progress engine does not delete this on completion. */
+  bool is_persistent() const { return persistent; }
+  /**
+   * Reset a completed persistent state so it can be enqueued again, with
+   * req_ as its new request.
+   */
+  void restart(AlRequest req_);
   /** Return a name identifying the state (for debugging/info purposes). */
   virtual std::string get_name() const { return "AlState"; }
   /** Return a string description of the state (for debugging/info purposes). */
   virtual std::string get_desc() const { return ""; }
+  /**
+   * Return the MPI requests this operation is currently waiting on and set
+   * count to their number, or return nullptr if it does not expose them.
+   * With aggregated polling, the progress engine tests these for the state
+   * and skips step while any are still active. Completed requests are set to
+   * MPI_REQUEST_NULL.
+   */
+  virtual MPI_Request* get_mpi_requests(size_t& count) {
+    count = 0;
+    return nullptr;
+  }
  private:
   AlRequest req;
 #ifdef AL_DEBUG_HANG_CHECK
@@ -139,57 +313,95 @@ class AlState {
   profiling::ProfileRange prof_range;
   /** Whether execution of this operation is paused on pipeline advancement. */
   bool paused_for_advance = false;
+  /** Scheduling priority. */
+  OpPriority priority = OpPriority::normal;
+  /** Whether this was admitted as a small operation. */
+  bool admitted_small = false;
+  /** Bytes counted against the in-flight limits when admitted. */
+  size_t admitted_bytes = 0;
+  /** Set by the progress thread currently running step. */
+  std::atomic<bool> claimed{false};
+  /** Action returned by a stolen step, for the owning thread to apply. */
+  PEAction pending_action = PEAction::cont;
+  /** Set when aggregated polling found active MPI requests; skip a step. */
+  bool waiting_on_mpi = false;
+  /** Set if a caller already started this before handing it to the engine. */
+  bool started_inline = false;
+  /** Whether this is scheduled by dependencies rather than stream order. */
+  bool unordered = false;
+  /** Requests of operations that must complete before this starts. */
+  std::vector<AlRequest> dependencies;
+  /** Whether this is kept after completing; see set_persistent. */
+  bool persistent = false;
+  /** Try to take exclusive access to step this state. */
+  bool try_claim() {
+    return !claimed.load(std::memory_order_relaxed)
+      && !claimed.exchange(true, std::memory_order_acquire);
+  }
+  /** Release exclusive access. */
+  void release_claim() { claimed.store(false, std::memory_order_release); }
 };
 
 /**
- * Lock-free single-producer, single-consumer queue.
- * This is Lamport's classic SPSC queue, with memory order optimizations
- * (see Le, et al. "Correct and Efficient Bounded FIFO Queues").
+ * Lock-free bounded multi-producer, single-consumer queue.
+ * This is Vyukov's bounded MPMC queue specialized to a single consumer:
+ * each cell carries a sequence number that tells producers when it is free
+ * and the consumer when its element has been published. Producers contend
+ * only on a fetch-and-add-like CAS of the back index.
  */
-class SPSCQueue {
+class MPSCQueue {
   friend class ProgressEngine;
  public:
   /**
    * Initialize the queue.
    * size_ must be a power of 2.
    */
-  SPSCQueue(size_t size_) :
+  MPSCQueue(size_t size_) :
     front(0), back(0), size(size_) {
-    data = new AlState*[size];
-    std::fill_n(data, size, nullptr);
+    cells = new Cell[size];
+    for (size_t i = 0; i < size; ++i) {
+      cells[i].seq.store(i, std::memory_order_relaxed);
+    }
   }
-  ~SPSCQueue() {
-    delete[] data;
+  ~MPSCQueue() {
+    delete[] cells;
   }
   /**
    * Add v to the queue.
+   * This is safe to call from multiple threads concurrently.
    * This will throw an exception if the queue is full.
-   * @todo We can elide the capacity check to save an atomic load.
-   * @todo If we elide the capacity check, this can be reformulated to use
-   * just a single fetch-and-add.
    */
   void push(AlState* v) {
     size_t b = back.load(std::memory_order_relaxed);
-    size_t f = front.load(std::memory_order_acquire);
-    size_t bmod = (b+1) & (size-1);
-    if (bmod == f) {
-      throw_al_exception("Queue full");
+    while (true) {
+      Cell& cell = cells[b & (size-1)];
+      const size_t seq = cell.seq.load(std::memory_order_acquire);
+      const std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq)
+        - static_cast<std::ptrdiff_t>(b);
+      if (diff == 0) {
+        // The cell is free; try to claim it.
+        if (back.compare_exchange_weak(b, b+1, std::memory_order_relaxed)) {
+          cell.data = v;
+          cell.seq.store(b+1, std::memory_order_release);
+          return;
+        }
+      } else if (diff < 0) {
+        throw_al_exception("Queue full");
+      } else {
+        // Another producer claimed the cell first.
+        b = back.load(std::memory_order_relaxed);
+      }
     }
-    data[b] = v;
-    back.store(bmod, std::memory_order_release);
   }
   /**
    * Remove an element from the queue.
    * If the queue is empty, this returns nullptr.
    */
   AlState* pop() {
-    size_t f = front.load(std::memory_order_relaxed);
-    size_t b = back.load(std::memory_order_acquire);
-    if (b == f) {
-      return nullptr;
+    AlState* v = peek();
+    if (v != nullptr) {
+      pop_always();
     }
-    AlState* v = data[f];
-    front.store((f+1) & (size-1), std::memory_order_release);
     return v;
   }
   /**
@@ -199,38 +411,67 @@ class SPSCQueue {
    */
   void pop_always() {
     size_t f = front.load(std::memory_order_relaxed);
-    front.store((f+1) & (size-1), std::memory_order_release);
+    // Mark the cell free for the producer one lap later.
+    cells[f & (size-1)].seq.store(f + size, std::memory_order_release);
+    front.store(f+1, std::memory_order_release);
   }
   /**
    * Return the element at the front of the queue without removing it.
-   * If the queue is empty, this returns nullptr.
+   * If the queue is empty (or the next push is still in progress), this
+   * returns nullptr.
    */
   AlState* peek() {
     size_t f = front.load(std::memory_order_relaxed);
-    size_t b = back.load(std::memory_order_acquire);
-    if (b == f) {
+    const Cell& cell = cells[f & (size-1)];
+    if (cell.seq.load(std::memory_order_acquire) != f+1) {
       return nullptr;
     }
-    return data[f];
+    return cell.data;
+  }
+  /** Return true if nothing has been pushed that has not been popped. */
+  bool empty() const {
+    return front.load(std::memory_order_acquire)
+      == back.load(std::memory_order_acquire);
   }
  private:
-  /** Index for the current front of the queue. */
+  /** An element of the queue. */
+  struct Cell {
+    /** Sequence number identifying whether the cell is free or full. */
+    std::atomic<size_t> seq;
+    /** The element. */
+    AlState* data;
+  };
+  /** Index for the current front of the queue (written by the consumer). */
   std::atomic<size_t> front;
-  /** Index for the current back of the queue. */
+  /** Keep front and back on separate cache lines. */
+  char pad[64 - sizeof(std::atomic<size_t>)];
+  /** Index for the current back of the queue (advanced by producers). */
   std::atomic<size_t> back;
   /** Number of elements the queue can store. */
   const size_t size;
   /** Buffer for data in the queue. */
-  AlState** data;
+  Cell* cells;
 };
 
 /** Input request queue. */
 struct InputQueue {
-  InputQueue() : q(1<<13) {}
+  InputQueue() : q(AL_PE_INPUT_QUEUE_SIZE),
+                 high_q(AL_PE_HIGH_PRIORITY_QUEUE_SIZE),
+                 started_q(AL_PE_INPUT_QUEUE_SIZE) {}
   /** Input queue. */
-  SPSCQueue q;
-  /** Whether a blocking operation is being executed. */
-  bool blocked = false;
+  MPSCQueue q;
+  /** Input queue for high-priority operations, started before q. */
+  MPSCQueue high_q;
+  /**
+   * Caller-driven operations handed over by set_callback. These were already
+   * admitted and started, so they go straight to the run queues.
+   */
+  MPSCQueue started_q;
+  /**
+   * Whether a blocking operation is being executed.
+   * This is written only by the progress thread that owns the queue.
+   */
+  std::atomic<bool> blocked{false};
   /** Associated compute stream. */
   void* compute_stream = DEFAULT_STREAM;
 };
@@ -290,10 +531,87 @@ struct OrderedArray {
   size_t cur_size = 0;
 };
 
+/** Counters describing how the progress engine spends its time. */
+struct ProgressEngineStats {
+  /** Loop iterations that had operations to start or run. */
+  uint64_t busy_iterations = 0;
+  /** Loop iterations that had nothing to do. */
+  uint64_t idle_iterations = 0;
+  /** Number of times the engine went to sleep waiting for work. */
+  uint64_t num_sleeps = 0;
+  /** Number of steps run on behalf of another progress thread. */
+  uint64_t num_steals = 0;
+};
+
+/**
+ * State for one progress engine thread.
+ * Each worker owns the input and run queues for a disjoint set of compute
+ * streams, and only the owner starts, advances, or completes operations on
+ * them, which preserves per-stream ordering. Other workers may only claim
+ * and step running operations.
+ */
+struct ProgressWorker {
+  /** Index of this worker. */
+  size_t id = 0;
+  /** The actual thread of execution. */
+  std::thread thread;
+  /**
+   * Per-stream pipelined run queues.
+   * Only the owner modifies these, with run_mutex held; other workers read
+   * them (with run_mutex held) when stealing.
+   * Using a vector for compactness and to avoid repeated memory allocations.
+   */
+  std::unordered_map<void*, std::vector<std::vector<AlState*>>> run_queues;
+  /** Protects run_queues from modification while being stolen from. */
+  std::mutex run_mutex;
+  /**
+   * Map requests that are currently blocking to the associated input queue.
+   * This should be accessed only by the owner.
+   */
+  std::unordered_map<AlState*, size_t> blocking_reqs;
+  /** Loop iterations with work; written only by the owner. */
+  std::atomic<uint64_t> busy_iterations{0};
+  /** Loop iterations without work; written only by the owner. */
+  std::atomic<uint64_t> idle_iterations{0};
+  /** Times the worker has slept; written only by the owner. */
+  std::atomic<uint64_t> num_sleeps{0};
+  /** Steps stolen from other workers; written only by the owner. */
+  std::atomic<uint64_t> num_steals{0};
+  /** Requests gathered for aggregated MPI polling (reused each iteration). */
+  std::vector<MPI_Request> mpi_reqs;
+  /** Output indices for MPI_Testsome. */
+  std::vector<int> mpi_indices;
+  /** A state whose requests were gathered into mpi_reqs. */
+  struct PolledState {
+    AlState* state;
+    /** The state's own requests, to copy results back to. */
+    MPI_Request* reqs;
+    /** Where its requests start in mpi_reqs. */
+    size_t offset;
+    /** Number of requests. */
+    size_t count;
+  };
+  /** States whose requests are in mpi_reqs. */
+  std::vector<PolledState> mpi_states;
+  /** A state taken off an input queue to wait for its dependencies. */
+  struct DeferredState {
+    AlState* state;
+    /** Index of the input queue it came from. */
+    size_t queue;
+  };
+  /**
+   * Admitted states waiting for their dependencies to complete, in the order
+   * they were dequeued. This should be accessed only by the owner.
+   */
+  std::vector<DeferredState> deferred;
+};
+
 /**
  * Encapsulates the asynchronous progress engine.
- * Note this is intended to be used from only one thread (in addition to the
- * progress thread) and is not optimized (or tested) for other cases.
+ * Any number of user threads may enqueue operations concurrently. Operations
+ * on the same compute stream are started in the order they were enqueued;
+ * if several threads enqueue on one stream, that order is whatever order
+ * their pushes happen in.
  */
 class ProgressEngine {
  public:
@@ -305,8 +623,29 @@ class ProgressEngine {
   void run();
   /** Stop the progress engine. */
   void stop();
-  /** Enqueue state for asynchronous execution. */
+  /**
+   * Enqueue state for asynchronous execution.
+   * This is safe to call from multiple threads.
+   */
   void enqueue(AlState* state);
+  /**
+   * Start state in the calling thread and leave it to be stepped by threads
+   * that test or wait on its request, instead of by the progress engine.
+   * To keep start order on the compute stream, this falls back to enqueue if
+   * operations are still waiting to start on it or it is blocked, if state
+   * blocks or does not need completion, or if the engine's admission limits
+   * have no room for it. Caller-driven states count against those limits
+   * until they complete. They are not put in a pipeline, so advancing is a
+   * no-op for them.
+   */
+  void run_inline(AlState* state);
+  /**
+   * Stop tracking a compute stream so its input queue can be reused.
+   * Operations already enqueued on the stream still run. Nothing may be
+   * enqueued on the stream while this is called; enqueueing afterward
+   * registers it again.
+   */
+  void retire_stream(void* stream);
   /**
    * Check whether a request has completed.
    * If the request is completed, it is removed.
@@ -318,6 +657,78 @@ class ProgressEngine {
    * This will block the calling thread.
    */
   void wait_for_completion(AlRequest& req);
+  /**
+   * Check whether all count requests in reqs have completed.
+   * If they have, they are all removed; otherwise none are.
+   */
+  bool test_all(AlRequest* reqs, size_t count);
+  /**
+   * Check each of the count requests in reqs in one pass, removing completed
+   * ones and writing their indices to indices (which must have room for
+   * count entries). Null requests are ignored.
+   * Return the number of completed requests.
+   */
+  size_t test_some(AlRequest* reqs, size_t count, size_t* indices);
+  /** Wait until all count requests in reqs have completed and remove them. */
+  void wait_all(AlRequest* reqs, size_t count);
+  /**
+   * Wait until any of the count requests in reqs completes, remove it, and
+   * return its index. Null requests are ignored; if all are null, this
+   * returns count immediately.
+   */
+  size_t wait_any(AlRequest* reqs, size_t count);
+  /**
+   * Set how user threads wait for requests.
+   * spin_iters is the number of polls before yielding or blocking.
+   * This should not be called while other threads are waiting.
+   */
+  void set_wait_policy(WaitPolicy policy, size_t spin_iters);
+  /**
+   * Run callback when req completes, then release req.
+   * req is set to NULL_REQUEST and must not be tested or waited on. If the
+   * operation has already completed, callback runs immediately in the calling
+   * thread; otherwise it is run by a progress thread, or handed to the
+   * completion executor if one is set. Callbacks must not throw.
+   * A caller-driven operation is handed to a progress thread to finish,
+   * ahead of operations still waiting to be admitted.
+   */
+  void set_callback(AlRequest& req, CompletionCallback callback);
+  /**
+   * Set the executor progress threads pass completion callbacks to.
+   * An empty executor runs callbacks directly on the progress thread.
+   * This should not be called while operations with callbacks are pending.
+   */
+  void set_completion_executor(CompletionExecutor executor);
+  /** Return the current wait policy. */
+  WaitPolicy get_wait_policy() const { return wait_policy; }
+  /** Enable or disable aggregated polling of MPI requests. */
+  void set_aggregate_mpi_polling(bool enable) {
+    aggregate_mpi_polling.store(enable, std::memory_order_relaxed);
+  }
+  /** Return whether MPI requests are polled in aggregate. */
+  bool get_aggregate_mpi_polling() const {
+    return aggregate_mpi_polling.load(std::memory_order_relaxed);
+  }
+  /** Return counters for tuning the engine's idle behavior. */
+  ProgressEngineStats get_stats() const;
+  /**
+   * Return the number of bounded operations that are not small the engine
+   * runs at once, as set by AL_PE_NUM_CONCURRENT_OPS.
+   */
+  size_t get_max_concurrent_ops() const { return max_concurrent_ops; }
+  /**
+   * Return the OS index of the NUMA node the first progress thread is bound
+   * to, or -1 if it is not known. Valid once run has returned.
+   */
+  int get_numa_node() const { return bound_numa_node; }
+  /**
+   * Return the index, within its NUMA node, of the core the first progress
+   * thread is bound to, or -1 if it is not known. Valid once run has
+   * returned.
+   */
+  int get_core() const { return bound_core; }
+  /** Return the number of progress threads. */
+  size_t get_num_threads() const { return num_workers; }
 
   /**
    * Best effort to dump progress engine state for debugging.
@@ -325,62 +736,254 @@ class ProgressEngine {
    */
   std::ostream& dump_state(std::ostream& ss);
  private:
-  /** The actual thread of execution. */
-  std::thread thread;
+  /** Number of progress threads. */
+  size_t num_workers;
+  /** NUMA node of the first progress thread; set by bind. */
+  int bound_numa_node = -1;
+  /** Core of the first progress thread within its NUMA node; set by bind. */
+  int bound_core = -1;
+  /** Per-thread state; input queue i is owned by worker i % num_workers. */
+  std::unique_ptr<ProgressWorker[]> workers;
   /** Atomic flag indicating the progress engine should stop; true to stop. */
   std::atomic<bool> stop_flag;
   /** For startup_cv. */
   std::mutex startup_mutex;
   /** Used to signal to the main thread that the progress engine has started. */
   std::condition_variable startup_cv;
-  /** Atomic flag indicating that the progress engine has completed startup. */
-  std::atomic<bool> started_flag;
+  /** Number of progress threads that have completed startup. */
+  std::atomic<size_t> num_started;
   /**
    * Per-stream request queues.
    * Each queue contains requests that have been enqueued to the progress
    * engine but that it has not yet begun to process.
-   * Queues can be "added" to this by incrementing cur_streams. The calling
-   * thread sets up the queue, then increments cur_streams. (Note that this is
-   * only safe with one user thread.)
+   * Queues are stored in chunks of pointers, where chunk k holds
+   * stream_chunk_size << k queues, so nothing moves as the table grows.
+   * A new queue is set up with stream_mutex held, then published by
+   * incrementing num_input_streams.
    */
-  InputQueue request_queues[AL_PE_NUM_STREAMS];
-  /** Current number of streams. */
+  InputQueue** stream_chunks[AL_PE_MAX_STREAM_CHUNKS];
+  /** Current number of input queues (including retired ones). */
   std::atomic<size_t> num_input_streams;
+  /** Protects stream registration and retirement. */
+  std::mutex stream_mutex;
   /**
-   * Compute streams that currently have InputQueues.
-   * Only the user thread accesses this.
+   * Map compute streams to the index of their input queue.
+   * Protected by stream_mutex.
    */
-  std::unordered_map<void*, InputQueue*> stream_to_queue;
+  std::unordered_map<void*, size_t> stream_to_queue;
   /**
-   * Per-stream pipelined run queues.
-   * This should be accessed only by the progress engine.
-   * Using a vector for compactness and to avoid repeated memory allocations.
-   * @todo May extend OrderedArray / make a new class to handle this.
+   * Indices of input queues whose streams have been retired.
+   * Protected by stream_mutex.
    */
-  std::unordered_map<void*, std::array<std::vector<AlState*>, AL_PE_NUM_PIPELINE_STAGES>> run_queues;
-  /** Number of currently-active bounded-length operations. */
-  size_t num_bounded = 0;
+  std::vector<size_t> retired_queues;
   /**
-   * Map requests that are currently blocking to the associated input queue.
-   * This should be accessed only by the progress engine.
+   * Changed whenever a stream is retired, to invalidate each thread's cached
+   * stream lookup. Values are unique across engine instances.
    */
-  std::unordered_map<AlState*, size_t> blocking_reqs;
+  std::atomic<uint64_t> stream_generation;
+  /** Return the input queue with index i; i must be < num_input_streams. */
+  InputQueue& get_input_queue(size_t i) const {
+    size_t chunk, offset;
+    locate_input_queue(i, chunk, offset);
+    return *stream_chunks[chunk][offset];
+  }
+  /** Compute where input queue i lives in stream_chunks. */
+  void locate_input_queue(size_t i, size_t& chunk, size_t& offset) const {
+    // Chunk k starts at index stream_chunk_size * (2^k - 1).
+    const size_t q = i / stream_chunk_size + 1;
+    chunk = 8*sizeof(unsigned long long) - 1 - __builtin_clzll(q);
+    offset = i - stream_chunk_size * ((size_t(1) << chunk) - 1);
+  }
+  /**
+   * Return the input queue for stream, registering the stream if needed.
+   * This acquires stream_mutex.
+   */
+  InputQueue* get_stream_queue(void* stream);
+  /** Number of currently-active bounded-length operations (not small). */
+  std::atomic<size_t> num_bounded;
+  /** Number of currently-active small bounded-length operations. */
+  std::atomic<size_t> num_small_bounded;
+  /** Bytes communicated by currently-active bounded-length operations. */
+  std::atomic<size_t> bytes_in_flight;
+  /**
+   * Bytes in flight for each quota key, when quotas are enabled.
+   * Protected by quota_mutex.
+   */
+  std::unordered_map<const void*, size_t> comm_bytes_in_flight;
+  /** Protects comm_bytes_in_flight. */
+  std::mutex quota_mutex;
+  /** Max number of concurrent bounded operations that are not small. */
+  size_t max_concurrent_ops;
+  /** Max number of concurrent small bounded operations. */
+  size_t max_concurrent_small_ops;
+  /** Bounded operation slots reserved for high-priority operations. */
+  size_t high_priority_slots;
+  /** Operations communicating at most this many bytes are small. */
+  size_t small_op_bytes;
+  /** Max bytes in flight across all operations; 0 for no limit. */
+  size_t max_bytes_in_flight;
+  /** Max bytes in flight per communicator; 0 for no limit. */
+  size_t comm_bytes_quota;
+  /** Number of pipeline stages in each run queue. */
+  size_t num_pipeline_stages;
+  /** Number of streams in the first chunk of the stream table. */
+  size_t stream_chunk_size;
+  /** Whether to poll MPI requests of running operations together. */
+  std::atomic<bool> aggregate_mpi_polling;
+  /** Idle iterations to spin for before backing off. */
+  size_t idle_spin_iters;
+  /** Idle iterations to yield for before sleeping. */
+  size_t idle_yield_iters;
+  /** Number of progress threads (about to be) asleep waiting for work. */
+  std::atomic<size_t> num_sleeping;
+  /** Number of states waiting for their dependencies, on all workers. */
+  std::atomic<size_t> num_deferred;
+  /** For work_cv and work_epoch. */
+  std::mutex work_mutex;
+  /** Used to wake the engine when work is enqueued. */
+  std::condition_variable work_cv;
+  /** Incremented (with work_mutex held) to wake sleeping threads. */
+  uint64_t work_epoch = 0;
   /** World communicator. */
   Communicator* world_comm;
 #ifdef AL_HAS_CUDA
   /** Used to pass the original CUDA device to the progress engine thread. */
   std::atomic<int> cur_device;
 #endif
+  /** Policy user threads use when waiting for requests. */
+  WaitPolicy wait_policy;
+  /** Number of polls before a waiting thread yields or blocks. */
+  size_t wait_spin_iters;
+  /** Number of user threads currently blocked in wait_until. */
+  std::atomic<size_t> num_blocked_waiters;
+  /** For wait_cv. */
+  std::mutex wait_mutex;
+  /** Used to wake user threads blocked waiting for completion. */
+  std::condition_variable wait_cv;
+  /** Where completion callbacks are run; empty to run them directly. */
+  CompletionExecutor completion_executor;
+  /**
+   * Wait until done returns true, following the current wait policy.
+   * done must be safe to call repeatedly from the waiting thread.
+   * If can_block is false, this yields instead of blocking, for when done
+   * itself drives the operation.
+   */
+  template <typename Pred>
+  void wait_until(Pred done, bool can_block = true);
+  /**
+   * Mark req as completed and wake any threads blocked on it, or run its
+   * callback if one is attached.
+   */
+  void mark_complete(AlRequest& req);
+  /**
+   * Run one step of req's operation if it is caller-driven and no other thread
+   * is stepping it, completing it if it finishes.
+   */
+  void step_inline(const AlRequest& req);
+  /**
+   * Return true if req has completed (without removing it), first stepping it
+   * if it is caller-driven.
+   */
+  bool poll_request(const AlRequest& req);
+  /** Return true if req is caller-driven, in which case waits must not block. */
+  static bool is_caller_driven(const AlRequest& req) {
+    return req != NULL_REQUEST && !req.is_stale()
+      && req.get_slot()->caller_progress;
+  }
+  /** Return the input queue for stream, using the thread's cached lookup. */
+  InputQueue* lookup_stream_queue(void* stream);
+  /** Wake the engine if it is sleeping; called after enqueueing work. */
+  void wake_engine();
+  /**
+   * Wake the engine if any states wait for dependencies; called after an
+   * operation completes.
+   */
+  void wake_deferred();
+  /** Return true if any input queue has an operation waiting. */
+  bool has_pending_input();
+  /** Return true if any of worker's deferred states can start. */
+  bool has_ready_deferred(ProgressWorker& worker);
+  /** Put a worker to sleep until there is new work or it is stopped. */
+  void sleep_until_work(ProgressWorker& worker);
+  /**
+   * Start operations waiting in the worker's input queues, where possible.
+   * High-priority queues are checked before any normal ones.
+   * Return true if any input queue had an operation waiting.
+   */
+  bool start_ops(ProgressWorker& worker);
+  /**
+   * Start the operation at the head of q, one of the queues of input queue i,
+   * if there is room for it.
+   * Return true if q had an operation waiting.
+   */
+  bool start_op(ProgressWorker& worker, size_t i, MPSCQueue& q);
   /**
-   * Bind the progress engine to a core.
+   * Start the worker's deferred states whose dependencies have completed.
+   * Return true if any were started.
+   */
+  bool start_deferred(ProgressWorker& worker);
+  /** Return true if req may start now under the engine's admission limits. */
+  bool can_start(AlState* req);
+  /**
+   * Start req, which came from input queue i, and add it to the worker's run
+   * queues.
+   */
+  void launch_op(ProgressWorker& worker, AlState* req, size_t i);
+  /**
+   * Reserve room to run the bounded operation req under the concurrency and
+   * bytes-in-flight limits. Return false if it must wait.
+   */
+  bool admit(AlState* req);
+  /** Release what admit reserved for req. */
+  void release_admission(AlState* req);
+  /**
+   * Step each operation in the worker's run queues and apply the results.
+   * Return true if there were any running operations.
+   */
+  bool run_ops(ProgressWorker& worker);
+  /**
+   * Test the MPI requests of all the worker's running operations with one
+   * MPI_Testsome, and mark the states that are still waiting.
+   */
+  void poll_mpi_requests(ProgressWorker& worker);
+  /**
+   * Step one running operation owned by another worker.
+   * Return true if one was stepped.
+   */
+  bool steal_step(ProgressWorker& worker);
+  /**
+   * Bind a progress thread to a core.
    * This binds to the last core in the NUMA node the process is in.
    * If there are multiple ranks per NUMA node, they get the last-1, etc. core.
+   * Additional progress threads are bound to successively lower cores.
    */
-  void bind();
-  /** This is the main progress engine loop. */
-  void engine();
+  void bind(size_t worker_id);
+  /** This is the main progress engine loop for one worker. */
+  void engine(size_t worker_id);
 };
 
+template <typename Pred>
+void ProgressEngine::wait_until(Pred done, bool can_block) {
+  size_t spins = 0;
+  while (!done()) {
+    if (wait_policy == WaitPolicy::spin || spins < wait_spin_iters) {
+      ++spins;
+    } else if (wait_policy == WaitPolicy::spin_yield || !can_block) {
+      std::this_thread::yield();
+    } else {
+      // Register as a blocked waiter before checking done under the lock.
+      // mark_complete sets the flag before checking for waiters, so one of
+      // the two will always see the other.
+      num_blocked_waiters.fetch_add(1);
+      {
+        std::unique_lock<std::mutex> lock(wait_mutex);
+        wait_cv.wait(lock, done);
+      }
+      num_blocked_waiters.fetch_sub(1);
+    }
+  }
+}
+
 /** Return a pointer to the Aluminum progress engine. */
 ProgressEngine* get_progress_engine();
 
@@ -0,0 +1,734 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.  Produced at the
+// Lawrence Livermore National Laboratory in collaboration with University of
+// Illinois Urbana-Champaign.
+//
+// Written by the LBANN Research Team (N. Dryden, N. Maruyama, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-756777.
+// All rights reserved.
+//
+// This file is part of Aluminum GPU-aware Communication Library. For details, see
+// http://software.llnl.gov/Aluminum or https://github.com/LLNL/Aluminum.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <unistd.h>
+#include "reduction_kernels.hpp"
+#include "reduction_team.hpp"
+#include "tuning_params.hpp"
+#include "utils.hpp"
+
+// The vector kernels use GCC vector extensions and per-function targets.
+#if defined(__x86_64__) && defined(__GNUC__)
+#define AL_REDUCTION_X86 1
+#else
+#define AL_REDUCTION_X86 0
+#endif
+#if AL_REDUCTION_X86
+#include <xmmintrin.h>
+#endif
+
+/** Forces inlining, so that kernel bodies get their caller's target. */
+#define AL_KERNEL_INLINE inline __attribute__((always_inline))
+
+namespace Al {
+namespace internal {
+
+namespace {
+
+/** Level of the kernels reductions use. */
+std::atomic<SIMDLevel> selected_level(SIMDLevel::scalar);
+/** Reductions writing this many bytes or more stream their results. */
+std::atomic<size_t> streaming_min_bytes(std::numeric_limits<size_t>::max());
+/** How far ahead streaming reductions prefetch, in bytes. */
+std::atomic<size_t> prefetch_bytes(AL_REDUCTION_PREFETCH_BYTES);
+
+/**
+ * Reduction operators. scalar returns dest op src, and vector sets dest to
+ * that for GCC vectors of elements. supports says whether T has the operator.
+ */
+struct SumOp {
+  static const char* name() { return "SUM"; }
+  template <typename T> static constexpr bool supports() { return true; }
+  template <typename T> static AL_KERNEL_INLINE T scalar(T dest, T src) {
+    return dest + src;
+  }
+  template <typename V> static AL_KERNEL_INLINE void vector(V& dest, const V& src) {
+    dest = dest + src;
+  }
+};
+struct ProdOp {
+  static const char* name() { return "PROD"; }
+  template <typename T> static constexpr bool supports() { return true; }
+  template <typename T> static AL_KERNEL_INLINE T scalar(T dest, T src) {
+    return dest * src;
+  }
+  template <typename V> static AL_KERNEL_INLINE void vector(V& dest, const V& src) {
+    dest = dest * src;
+  }
+};
+struct MinOp {
+  static const char* name() { return "MIN"; }
+  template <typename T> static constexpr bool supports() { return true; }
+  // Same as std::min(dest, src), including for NaNs.
+  template <typename T> static AL_KERNEL_INLINE T scalar(T dest, T src) {
+    return src < dest ? src : dest;
+  }
+  template <typename V> static AL_KERNEL_INLINE void vector(V& dest, const V& src) {
+    dest = src < dest ? src : dest;
+  }
+};
+struct MaxOp {
+  static const char* name() { return "MAX"; }
+  template <typename T> static constexpr bool supports() { return true; }
+  // Same as std::max(dest, src), including for NaNs.
+  template <typename T> static AL_KERNEL_INLINE T scalar(T dest, T src) {
+    return dest < src ? src : dest;
+  }
+  template <typename V> static AL_KERNEL_INLINE void vector(V& dest, const V& src) {
+    dest = dest < src ? src : dest;
+  }
+};
+// Logical operators produce 1 or 0. Comparing vectors gives a mask of
+// all-ones or zero elements, which selects between those.
+struct LorOp {
+  static const char* name() { return "LOR"; }
+  template <typename T> static constexpr bool supports() { return true; }
+  template <typename T> static AL_KERNEL_INLINE T scalar(T dest, T src) {
+    return src || dest;
+  }
+  template <typename V> static AL_KERNEL_INLINE void vector(V& dest, const V& src) {
+    const V zero = {};
+    dest = ((src != 0) | (dest != 0)) ? zero + 1 : zero;
+  }
+};
+struct LandOp {
+  static const char* name() { return "LAND"; }
+  template <typename T> static constexpr bool supports() { return true; }
+  template <typename T> static AL_KERNEL_INLINE T scalar(T dest, T src) {
+    return src && dest;
+  }
+  template <typename V> static AL_KERNEL_INLINE void vector(V& dest, const V& src) {
+    const V zero = {};
+    dest = ((src != 0) & (dest != 0)) ? zero + 1 : zero;
+  }
+};
+struct LxorOp {
+  static const char* name() { return "LXOR"; }
+  template <typename T> static constexpr bool supports() { return true; }
+  template <typename T> static AL_KERNEL_INLINE T scalar(T dest, T src) {
+    return !src != !dest;
+  }
+  template <typename V> static AL_KERNEL_INLINE void vector(V& dest, const V& src) {
+    const V zero = {};
+    dest = ((src == 0) ^ (dest == 0)) ? zero + 1 : zero;
+  }
+};
+// Bitwise operators are not supported on floating point types.
+struct BorOp {
+  static const char* name() { return "BOR"; }
+  template <typename T> static constexpr bool supports() {
+    return std::is_integral<T>::value;
+  }
+  template <typename T> static AL_KERNEL_INLINE T scalar(T dest, T src) {
+    return src | dest;
+  }
+  template <typename V> static AL_KERNEL_INLINE void vector(V& dest, const V& src) {
+    dest = src | dest;
+  }
+};
+struct BandOp {
+  static const char* name() { return "BAND"; }
+  template <typename T> static constexpr bool supports() {
+    return std::is_integral<T>::value;
+  }
+  template <typename T> static AL_KERNEL_INLINE T scalar(T dest, T src) {
+    return src & dest;
+  }
+  template <typename V> static AL_KERNEL_INLINE void vector(V& dest, const V& src) {
+    dest = src & dest;
+  }
+};
+struct BxorOp {
+  static const char* name() { return "BXOR"; }
+  template <typename T> static constexpr bool supports() {
+    return std::is_integral<T>::value;
+  }
+  template <typename T> static AL_KERNEL_INLINE T scalar(T dest, T src) {
+    return src ^ dest;
+  }
+  template <typename V> static AL_KERNEL_INLINE void vector(V& dest, const V& src) {
+    dest = src ^ dest;
+  }
+};
+
+/** Whether GCC vectors of T exist; there are none of long double. */
+template <typename T>
+struct is_vectorizable : std::integral_constant<
+  bool, std::is_arithmetic<T>::value
+        && !std::is_same<T, long double>::value> {};
+
+/** Set dest to in op src one element at a time; in may be dest. */
+template <typename T, typename Op>
+AL_KERNEL_INLINE
+typename std::enable_if<!is_half_float<T>::value>::type
+scalar_loop(const T* __restrict src, const T* in, T* dest, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    dest[i] = Op::template scalar<T>(in[i], src[i]);
+  }
+}
+
+/**
+ * Conversions of GCC vectors between 16-bit floating point types and float.
+ * These are done with integer operations on vectors U of 32-bit bit patterns
+ * and F of floats, so they vectorize at every level, and match the scalar
+ * conversions of the types exactly.
+ */
+template <typename T> struct HalfConversion;
+template <> struct HalfConversion<float16> {
+  template <typename U, typename F>
+  static AL_KERNEL_INLINE void widen(const U& h, F& f) {
+    U x = (h & 0x7fff) << 13;
+    const U exp = x & 0x0f800000;
+    x += 0x38000000;
+    // Subnormals are renormalized by subtracting the implicit leading one.
+    F sub = (F) (x + 0x00800000);
+    sub -= 6.103515625e-05f;
+    x = exp == 0x0f800000 ? x + 0x38000000 : x;
+    x = exp == 0 ? (U) sub : x;
+    f = (F) (x | ((h & 0x8000) << 16));
+  }
+  template <typename U, typename F>
+  static AL_KERNEL_INLINE void narrow(const F& f, U& h) {
+    U x = (U) f;
+    const U sign = (x >> 16) & 0x8000;
+    x &= 0x7fffffff;
+    F sub = (F) x;
+    sub += 0.5f;
+    const U normal = (x + 0xc8000fff + ((x >> 13) & 1)) >> 13;
+    const U special = x > 0x7f800000 ? U{} + 0x7e00 : U{} + 0x7c00;
+    h = x < 0x38800000 ? (U) sub - 0x3f000000 : normal;
+    h = x >= 0x47800000 ? special : h;
+    h |= sign;
+  }
+};
+template <> struct HalfConversion<bfloat16> {
+  template <typename U, typename F>
+  static AL_KERNEL_INLINE void widen(const U& h, F& f) {
+    f = (F) (h << 16);
+  }
+  template <typename U, typename F>
+  static AL_KERNEL_INLINE void narrow(const F& f, U& h) {
+    const U x = (U) f;
+    h = (x & 0x7fffffff) > 0x7f800000 ?
+      (x >> 16) | 0x40 : (x + 0x7fff + ((x >> 16) & 1)) >> 16;
+  }
+};
+
+/**
+ * Vectors of Bytes / 2 bytes of 16-bit elements and the Bytes bytes of their
+ * bit patterns widened to 32 bits. These are defined for each width since
+ * GCC loses vector attributes of dependent types.
+ */
+template <size_t Bytes> struct HalfVectors;
+#define AL_DEFINE_HALF_VECTORS(Bytes)                                   \
+  template <> struct HalfVectors<Bytes> {                               \
+    typedef uint16_t half_vec __attribute__((vector_size(Bytes / 2)));  \
+    typedef uint32_t bits_vec __attribute__((vector_size(Bytes)));      \
+    static AL_KERNEL_INLINE void widen(const half_vec& h, bits_vec& x) { \
+      x = __builtin_convertvector(h, bits_vec);                         \
+    }                                                                   \
+    static AL_KERNEL_INLINE void narrow(const bits_vec& x, half_vec& h) { \
+      h = __builtin_convertvector(x, half_vec);                         \
+    }                                                                   \
+  };
+AL_DEFINE_HALF_VECTORS(16)
+AL_DEFINE_HALF_VECTORS(32)
+AL_DEFINE_HALF_VECTORS(64)
+#undef AL_DEFINE_HALF_VECTORS
+
+/** Load a float vector of Bytes bytes from p, which holds T or float. */
+template <typename T, size_t Bytes, typename F>
+AL_KERNEL_INLINE void load_vector(const float* p, F& v) {
+  // memcpy makes unaligned vector loads and stores.
+  std::memcpy(&v, p, Bytes);
+}
+template <typename T, size_t Bytes, typename F>
+AL_KERNEL_INLINE void load_vector(const T* p, F& v) {
+  typename HalfVectors<Bytes>::half_vec h;
+  typename HalfVectors<Bytes>::bits_vec x;
+  std::memcpy(&h, p, Bytes / 2);
+  HalfVectors<Bytes>::widen(h, x);
+  HalfConversion<T>::widen(x, v);
+}
+/** Store a float vector of Bytes bytes to p, as T or float. */
+template <typename T, size_t Bytes, typename F>
+AL_KERNEL_INLINE void store_vector(const F& v, float* p) {
+  std::memcpy(p, &v, Bytes);
+}
+template <typename T, size_t Bytes, typename F>
+AL_KERNEL_INLINE void store_vector(const F& v, T* p) {
+  typename HalfVectors<Bytes>::half_vec h;
+  typename HalfVectors<Bytes>::bits_vec x;
+  HalfConversion<T>::narrow(v, x);
+  HalfVectors<Bytes>::narrow(x, h);
+  std::memcpy(p, &h, Bytes / 2);
+}
+
+/**
+ * Set dest to in op src one element at a time, in float, for a 16-bit
+ * floating point type T. src and dest hold T or float.
+ */
+template <typename T, typename Op, typename S, typename D>
+AL_KERNEL_INLINE
+typename std::enable_if<is_half_float<T>::value>::type
+scalar_loop(const S* __restrict src, const T* in, D* dest, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    dest[i] = Op::template scalar<float>(static_cast<float>(in[i]),
+                                         static_cast<float>(src[i]));
+  }
+}
+
+/** Reduce Bytes bytes of elements at a time, then the remainder singly. */
+template <typename T, typename Op, size_t Bytes>
+AL_KERNEL_INLINE
+typename std::enable_if<is_vectorizable<T>::value>::type
+vector_loop(const T* __restrict src, const T* in, T* dest, size_t count) {
+  typedef T vec __attribute__((vector_size(Bytes)));
+  constexpr size_t width = Bytes / sizeof(T);
+  size_t i = 0;
+  for (; i + width <= count; i += width) {
+    // memcpy makes unaligned vector loads and stores.
+    vec s, d;
+    std::memcpy(&s, src + i, Bytes);
+    std::memcpy(&d, in + i, Bytes);
+    Op::vector(d, s);
+    std::memcpy(dest + i, &d, Bytes);
+  }
+  scalar_loop<T, Op>(src + i, in + i, dest + i, count - i);
+}
+/** As above, converting a float vector's worth of 16-bit elements at once. */
+template <typename T, typename Op, size_t Bytes, typename S, typename D>
+AL_KERNEL_INLINE
+typename std::enable_if<is_half_float<T>::value>::type
+vector_loop(const S* __restrict src, const T* in, D* dest, size_t count) {
+  typedef float vec __attribute__((vector_size(Bytes)));
+  constexpr size_t width = Bytes / sizeof(float);
+  size_t i = 0;
+  for (; i + width <= count; i += width) {
+    vec s, d;
+    load_vector<T, Bytes>(src + i, s);
+    load_vector<T, Bytes>(in + i, d);
+    Op::vector(d, s);
+    store_vector<T, Bytes>(d, dest + i);
+  }
+  scalar_loop<T, Op>(src + i, in + i, dest + i, count - i);
+}
+template <typename T, typename Op, size_t Bytes>
+AL_KERNEL_INLINE
+typename std::enable_if<!is_vectorizable<T>::value
+                        && !is_half_float<T>::value>::type
+vector_loop(const T* __restrict src, const T* in, T* dest, size_t count) {
+  scalar_loop<T, Op>(src, in, dest, count);
+}
+
+#if AL_REDUCTION_X86
+/**
+ * Store Bytes bytes of v to p, which must be aligned to Bytes, without
+ * bringing the line into the cache. This is inline assembly because the
+ * intrinsics cannot be inlined into the loops, which have no target.
+ */
+template <size_t Bytes> struct StreamStore {
+  template <typename V> static AL_KERNEL_INLINE void store(const V& v, void* p) {
+    asm("vmovntdq %1, %0" : "=m"(*static_cast<char(*)[Bytes]>(p)) : "v"(v));
+  }
+};
+template <> struct StreamStore<16> {
+  template <typename V> static AL_KERNEL_INLINE void store(const V& v, void* p) {
+    asm("movntdq %1, %0" : "=m"(*static_cast<char(*)[16]>(p)) : "x"(v));
+  }
+};
+
+/**
+ * As vector_loop, for results too large to stay in cache: dest is written
+ * with non-temporal stores, and src prefetched ahead once per cache line.
+ * Elements before dest's first vector boundary are reduced singly, since the
+ * stores must be aligned.
+ */
+template <typename T, typename Op, size_t Bytes>
+AL_KERNEL_INLINE
+typename std::enable_if<is_vectorizable<T>::value>::type
+stream_loop(const T* __restrict src, const T* in, T* dest, size_t count) {
+  typedef T vec __attribute__((vector_size(Bytes)));
+  constexpr size_t width = Bytes / sizeof(T);
+  constexpr size_t line = 64 / sizeof(T);
+  const size_t misalignment = reinterpret_cast<uintptr_t>(dest) % Bytes;
+  if (misalignment % sizeof(T) != 0) {
+    vector_loop<T, Op, Bytes>(src, in, dest, count);
+    return;
+  }
+  const size_t head = std::min(
+    count, misalignment ? (Bytes - misalignment) / sizeof(T) : 0);
+  scalar_loop<T, Op>(src, in, dest, head);
+  const size_t distance =
+    prefetch_bytes.load(std::memory_order_relaxed) / sizeof(T);
+  size_t i = head;
+  for (; i + line <= count; i += line) {
+    __builtin_prefetch(src + i + distance, 0, 0);
+    for (size_t j = i; j < i + line; j += width) {
+      vec s, d;
+      std::memcpy(&s, src + j, Bytes);
+      std::memcpy(&d, in + j, Bytes);
+      Op::vector(d, s);
+      StreamStore<Bytes>::store(d, dest + j);
+    }
+  }
+  // Order the streamed stores before whatever signals they are done.
+  _mm_sfence();
+  vector_loop<T, Op, Bytes>(src + i, in + i, dest + i, count - i);
+}
+/** Types without GCC vectors of their own are not streamed. */
+template <typename T, typename Op, size_t Bytes, typename S, typename D>
+AL_KERNEL_INLINE
+typename std::enable_if<!is_vectorizable<T>::value>::type
+stream_loop(const S* src, const T* in, D* dest, size_t count) {
+  vector_loop<T, Op, Bytes>(src, in, dest, count);
+}
+#endif
+
+// Kernels built for each level. src and dest hold S and D, which differ from
+// T only for 16-bit floating point types with float partial results.
+template <typename T, typename Op, typename S, typename D>
+void scalar_kernel(const S* src, const T* in, D* dest, size_t count) {
+  scalar_loop<T, Op>(src, in, dest, count);
+}
+#if AL_REDUCTION_X86
+template <typename T, typename Op, typename S, typename D>
+__attribute__((target("sse2")))
+void sse2_kernel(const S* src, const T* in, D* dest, size_t count) {
+  vector_loop<T, Op, 16>(src, in, dest, count);
+}
+template <typename T, typename Op, typename S, typename D>
+__attribute__((target("avx2")))
+void avx2_kernel(const S* src, const T* in, D* dest, size_t count) {
+  vector_loop<T, Op, 32>(src, in, dest, count);
+}
+template <typename T, typename Op, typename S, typename D>
+__attribute__((target("avx512f,avx512bw")))
+void avx512_kernel(const S* src, const T* in, D* dest, size_t count) {
+  vector_loop<T, Op, 64>(src, in, dest, count);
+}
+// Kernels for large reductions, which stream their results.
+template <typename T, typename Op, typename S, typename D>
+__attribute__((target("sse2")))
+void sse2_stream_kernel(const S* src, const T* in, D* dest, size_t count) {
+  stream_loop<T, Op, 16>(src, in, dest, count);
+}
+template <typename T, typename Op, typename S, typename D>
+__attribute__((target("avx2")))
+void avx2_stream_kernel(const S* src, const T* in, D* dest, size_t count) {
+  stream_loop<T, Op, 32>(src, in, dest, count);
+}
+template <typename T, typename Op, typename S, typename D>
+__attribute__((target("avx512f,avx512bw")))
+void avx512_stream_kernel(const S* src, const T* in, D* dest, size_t count) {
+  stream_loop<T, Op, 64>(src, in, dest, count);
+}
+#endif
+
+/**
+ * Both forms of reduction built on Kernel, splitting large reductions among
+ * the reduction team if there is one. Reductions writing at least
+ * streaming_min_bytes use StreamKernel instead.
+ * The two-operand form is only used when S and D are T.
+ */
+template <typename T, typename Op, typename S, typename D,
+          void (*Kernel)(const S*, const T*, D*, size_t),
+          void (*StreamKernel)(const S*, const T*, D*, size_t)>
+struct Forms {
+  /** A reduction split among the reduction team. */
+  struct Job {
+    void (*kernel)(const S*, const T*, D*, size_t);
+    const S* src;
+    const T* in;
+    D* dest;
+    size_t count;
+    /** Elements in each part. */
+    size_t chunk;
+  };
+  static void run_part(void* arg, size_t part) {
+    const Job& job = *static_cast<const Job*>(arg);
+    const size_t begin = std::min(job.chunk * part, job.count);
+    const size_t end = std::min(begin + job.chunk, job.count);
+    job.kernel(job.src + begin, job.in + begin, job.dest + begin,
+               end - begin);
+  }
+  static void run(const S* src, const T* in, D* dest, size_t count) {
+    const auto kernel =
+      count * sizeof(D) >= streaming_min_bytes.load(std::memory_order_relaxed)
+      ? StreamKernel : Kernel;
+    ReductionTeam* team = get_reduction_team();
+    if (team != nullptr && count * sizeof(T) >= team->get_min_bytes()) {
+      // Split on cache lines so threads do not share them.
+      constexpr size_t line = sizeof(T) < 64 ? 64 / sizeof(T) : 1;
+      const size_t num_parts = team->get_num_threads() + 1;
+      Job job = {kernel, src, in, dest, count,
+                 ((count + num_parts - 1) / num_parts + line - 1) / line * line};
+      if (team->run(num_parts, &run_part, &job)) {
+        return;
+      }
+    }
+    kernel(src, in, dest, count);
+  }
+  static void run(const T* src, T* dest, size_t count) {
+    run(src, dest, dest, count);
+  }
+};
+
+template <typename T, typename Op, typename S, typename D>
+void unsupported_kernel(const S*, D*, size_t) {
+  throw_al_exception(std::string(Op::name())
+                     + " not supported for floating point types");
+}
+template <typename T, typename Op, typename S, typename D>
+void unsupported_kernel(const S*, const T*, D*, size_t) {
+  throw_al_exception(std::string(Op::name())
+                     + " not supported for floating point types");
+}
+
+/**
+ * Return the kernel of type K, a ReductionKernel<T>, CopyReductionKernel<T>
+ * or WideReductionKernel<T, S, D>, for Op on T at level.
+ */
+template <typename T, typename Op, typename S, typename D, typename K>
+typename std::enable_if<Op::template supports<T>(), K>::type
+select_kernel(SIMDLevel level) {
+  switch (level) {
+#if AL_REDUCTION_X86
+  case SIMDLevel::sse2:
+    return static_cast<K>(
+      &Forms<T, Op, S, D, sse2_kernel<T, Op, S, D>,
+             sse2_stream_kernel<T, Op, S, D>>::run);
+  case SIMDLevel::avx2:
+    return static_cast<K>(
+      &Forms<T, Op, S, D, avx2_kernel<T, Op, S, D>,
+             avx2_stream_kernel<T, Op, S, D>>::run);
+  case SIMDLevel::avx512:
+    return static_cast<K>(
+      &Forms<T, Op, S, D, avx512_kernel<T, Op, S, D>,
+             avx512_stream_kernel<T, Op, S, D>>::run);
+#endif
+  default:
+    return static_cast<K>(
+      &Forms<T, Op, S, D, scalar_kernel<T, Op, S, D>,
+             scalar_kernel<T, Op, S, D>>::run);
+  }
+}
+template <typename T, typename Op, typename S, typename D, typename K>
+typename std::enable_if<!Op::template supports<T>(), K>::type
+select_kernel(SIMDLevel) {
+  return static_cast<K>(&unsupported_kernel<T, Op, S, D>);
+}
+
+/** Return the kernel of type K for op on T at level. */
+template <typename T, typename S, typename D, typename K>
+K select_op_kernel(ReductionOperator op, SIMDLevel level) {
+  switch (op) {
+  case ReductionOperator::sum:
+    return select_kernel<T, SumOp, S, D, K>(level);
+  case ReductionOperator::prod:
+    return select_kernel<T, ProdOp, S, D, K>(level);
+  case ReductionOperator::min:
+    return select_kernel<T, MinOp, S, D, K>(level);
+  case ReductionOperator::max:
+    return select_kernel<T, MaxOp, S, D, K>(level);
+  case ReductionOperator::lor:
+    return select_kernel<T, LorOp, S, D, K>(level);
+  case ReductionOperator::land:
+    return select_kernel<T, LandOp, S, D, K>(level);
+  case ReductionOperator::lxor:
+    return select_kernel<T, LxorOp, S, D, K>(level);
+  case ReductionOperator::bor:
+    return select_kernel<T, BorOp, S, D, K>(level);
+  case ReductionOperator::band:
+    return select_kernel<T, BandOp, S, D, K>(level);
+  case ReductionOperator::bxor:
+    return select_kernel<T, BxorOp, S, D, K>(level);
+  default:
+    throw_al_exception("Reduction operator not supported");
+  }
+}
+
+constexpr size_t num_reduction_ops =
+  static_cast<size_t>(ReductionOperator::bxor) + 1;
+
+/**
+ * Kernels of type K for every operator and level, instantiated once so a
+ * lookup is an index into a table of monomorphized kernels.
+ */
+template <typename T, typename S, typename D, typename K>
+struct KernelTable {
+  K kernels[num_simd_levels][num_reduction_ops];
+
+  KernelTable() {
+    for (size_t level = 0; level < num_simd_levels; ++level) {
+      for (size_t op = 0; op < num_reduction_ops; ++op) {
+        kernels[level][op] = select_op_kernel<T, S, D, K>(
+          static_cast<ReductionOperator>(op), static_cast<SIMDLevel>(level));
+      }
+    }
+  }
+
+  static K get(ReductionOperator op, SIMDLevel level) {
+    static const KernelTable table;
+    const size_t op_index = static_cast<size_t>(op);
+    const size_t level_index = static_cast<size_t>(level);
+    if (op_index >= num_reduction_ops || level_index >= num_simd_levels) {
+      throw_al_exception("Reduction operator not supported");
+    }
+    return table.kernels[level_index][op_index];
+  }
+};
+
+}  // namespace
+
+const char* simd_level_name(SIMDLevel level) {
+  switch (level) {
+  case SIMDLevel::scalar:
+    return "scalar";
+  case SIMDLevel::sse2:
+    return "sse2";
+  case SIMDLevel::avx2:
+    return "avx2";
+  case SIMDLevel::avx512:
+    return "avx512";
+  default:
+    return "unknown";
+  }
+}
+
+SIMDLevel get_supported_simd_level() {
+#if AL_REDUCTION_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+    return SIMDLevel::avx512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return SIMDLevel::avx2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return SIMDLevel::sse2;
+  }
+#endif
+  return SIMDLevel::scalar;
+}
+
+SIMDLevel get_simd_level() {
+  return selected_level.load(std::memory_order_relaxed);
+}
+
+void init_reduction_kernels() {
+  const size_t max_level = get_env_size("AL_REDUCTION_MAX_SIMD_LEVEL",
+                                        AL_REDUCTION_MAX_SIMD_LEVEL);
+  const size_t level = std::min(
+    static_cast<size_t>(get_supported_simd_level()), max_level);
+  selected_level = static_cast<SIMDLevel>(level);
+  size_t min_bytes = get_env_size("AL_REDUCTION_STREAMING_MIN_BYTES",
+                                  AL_REDUCTION_STREAMING_MIN_BYTES);
+  if (min_bytes == 0) {
+    // Past the last-level cache, results would not stay cached anyway.
+    long cache_size = 0;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+    cache_size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+    min_bytes = cache_size > 0 ? static_cast<size_t>(cache_size) : 32 << 20;
+  }
+  streaming_min_bytes = min_bytes;
+  prefetch_bytes = get_env_size("AL_REDUCTION_PREFETCH_BYTES",
+                                AL_REDUCTION_PREFETCH_BYTES);
+}
+
+size_t get_streaming_min_bytes() {
+  return streaming_min_bytes.load(std::memory_order_relaxed);
+}
+
+void set_streaming_min_bytes(size_t bytes) {
+  streaming_min_bytes = bytes;
+}
+
+template <typename T>
+ReductionKernel<T> get_reduction_kernel(ReductionOperator op,
+                                        SIMDLevel level) {
+  return KernelTable<T, T, T, ReductionKernel<T>>::get(op, level);
+}
+
+template <typename T>
+CopyReductionKernel<T> get_copy_reduction_kernel(ReductionOperator op,
+                                                 SIMDLevel level) {
+  return KernelTable<T, T, T, CopyReductionKernel<T>>::get(op, level);
+}
+
+template <typename T, typename S, typename D>
+WideReductionKernel<T, S, D> get_wide_reduction_kernel(ReductionOperator op,
+                                                       SIMDLevel level) {
+  return KernelTable<T, S, D, WideReductionKernel<T, S, D>>::get(op, level);
+}
+
+// Instantiate for every type in TypeMap.
+#define AL_INSTANTIATE_REDUCTION_KERNELS(T)                             \
+  template ReductionKernel<T> get_reduction_kernel<T>(ReductionOperator, \
+                                                      SIMDLevel);       \
+  template CopyReductionKernel<T> get_copy_reduction_kernel<T>(         \
+    ReductionOperator, SIMDLevel);
+AL_INSTANTIATE_REDUCTION_KERNELS(char)
+AL_INSTANTIATE_REDUCTION_KERNELS(signed char)
+AL_INSTANTIATE_REDUCTION_KERNELS(unsigned char)
+AL_INSTANTIATE_REDUCTION_KERNELS(short)
+AL_INSTANTIATE_REDUCTION_KERNELS(unsigned short)
+AL_INSTANTIATE_REDUCTION_KERNELS(int)
+AL_INSTANTIATE_REDUCTION_KERNELS(unsigned int)
+AL_INSTANTIATE_REDUCTION_KERNELS(long int)
+AL_INSTANTIATE_REDUCTION_KERNELS(unsigned long int)
+AL_INSTANTIATE_REDUCTION_KERNELS(long long int)
+AL_INSTANTIATE_REDUCTION_KERNELS(unsigned long long int)
+AL_INSTANTIATE_REDUCTION_KERNELS(float)
+AL_INSTANTIATE_REDUCTION_KERNELS(double)
+AL_INSTANTIATE_REDUCTION_KERNELS(long double)
+AL_INSTANTIATE_REDUCTION_KERNELS(float16)
+AL_INSTANTIATE_REDUCTION_KERNELS(bfloat16)
+#undef AL_INSTANTIATE_REDUCTION_KERNELS
+#define AL_INSTANTIATE_WIDE_REDUCTION_KERNELS(T, S, D)                   \
+  template WideReductionKernel<T, S, D> get_wide_reduction_kernel<T, S, D>( \
+    ReductionOperator, SIMDLevel);
+AL_INSTANTIATE_WIDE_REDUCTION_KERNELS(float16, float16, float)
+AL_INSTANTIATE_WIDE_REDUCTION_KERNELS(float16, float, float)
+AL_INSTANTIATE_WIDE_REDUCTION_KERNELS(float16, float, float16)
+AL_INSTANTIATE_WIDE_REDUCTION_KERNELS(bfloat16, bfloat16, float)
+AL_INSTANTIATE_WIDE_REDUCTION_KERNELS(bfloat16, float, float)
+AL_INSTANTIATE_WIDE_REDUCTION_KERNELS(bfloat16, float, bfloat16)
+#undef AL_INSTANTIATE_WIDE_REDUCTION_KERNELS
+
+}  // namespace internal
+}  // namespace Al
@@ -0,0 +1,131 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.  Produced at the
+// Lawrence Livermore National Laboratory in collaboration with University of
+// Illinois Urbana-Champaign.
+//
+// Written by the LBANN Research Team (N. Dryden, N. Maruyama, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-756777.
+// All rights reserved.
+//
+// This file is part of Aluminum GPU-aware Communication Library. For details, see
+// http://software.llnl.gov/Aluminum or https://github.com/LLNL/Aluminum.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <cstddef>
+#include "base.hpp"
+#include "float16.hpp"
+
+namespace Al {
+namespace internal {
+
+/**
+ * Instruction sets reduction kernels are built for, from least to most
+ * capable. The vector levels exist only on x86-64.
+ */
+enum class SIMDLevel {
+  scalar = 0,
+  sse2 = 1,
+  avx2 = 2,
+  avx512 = 3
+};
+constexpr size_t num_simd_levels = 4;
+
+/** Return a textual name for level. */
+const char* simd_level_name(SIMDLevel level);
+/** Return the most capable level the CPU supports. */
+SIMDLevel get_supported_simd_level();
+/** Return the level of the kernels reductions currently use. */
+SIMDLevel get_simd_level();
+/**
+ * Select reduction kernels for the most capable level the CPU supports, up to
+ * AL_REDUCTION_MAX_SIMD_LEVEL. This is called by Initialize; until then the
+ * scalar kernels are used.
+ */
+void init_reduction_kernels();
+/**
+ * Return the number of bytes from which reductions write their results with
+ * non-temporal stores and prefetch their input.
+ */
+size_t get_streaming_min_bytes();
+/** Stream the results of reductions writing bytes or more. */
+void set_streaming_min_bytes(size_t bytes);
+
+/** Reduces count elements of src into dest. */
+template <typename T>
+using ReductionKernel = void (*)(const T*, T*, size_t);
+/**
+ * Sets count elements of dest to in reduced with src, so a reduction can
+ * also copy its input: (src, in, dest, count). in may be dest.
+ */
+template <typename T>
+using CopyReductionKernel = void (*)(const T*, const T*, T*, size_t);
+
+/**
+ * Return the kernel for op on T built for level, which must be supported by
+ * the CPU. Kernels for operators T does not support throw when called.
+ * This is defined for every type with an MPI type in TypeMap. 16-bit floating
+ * point types are reduced in float and rounded back.
+ */
+template <typename T>
+ReductionKernel<T> get_reduction_kernel(ReductionOperator op,
+                                        SIMDLevel level);
+
+/** Return the kernel for op on T at the selected level. */
+template <typename T>
+ReductionKernel<T> get_reduction_kernel(ReductionOperator op) {
+  return get_reduction_kernel<T>(op, get_simd_level());
+}
+
+/** As get_reduction_kernel, for the three-operand kernels. */
+template <typename T>
+CopyReductionKernel<T> get_copy_reduction_kernel(ReductionOperator op,
+                                                 SIMDLevel level);
+
+/** Return the three-operand kernel for op on T at the selected level. */
+template <typename T>
+CopyReductionKernel<T> get_copy_reduction_kernel(ReductionOperator op) {
+  return get_copy_reduction_kernel<T>(op, get_simd_level());
+}
+
+/**
+ * Three-operand kernel for a 16-bit floating point type T where src and dest
+ * may each hold T or float, so partial results can be kept in float:
+ * (src, in, dest, count). The reduction is always done in float.
+ */
+template <typename T, typename S, typename D>
+using WideReductionKernel = void (*)(const S*, const T*, D*, size_t);
+
+/**
+ * As get_copy_reduction_kernel, for kernels on 16-bit floating point types
+ * with float partial results. This is defined for T float16 and bfloat16,
+ * with S and D each T or float.
+ */
+template <typename T, typename S, typename D>
+WideReductionKernel<T, S, D> get_wide_reduction_kernel(ReductionOperator op,
+                                                       SIMDLevel level);
+
+/** Return the kernel with float partial results at the selected level. */
+template <typename T, typename S, typename D>
+WideReductionKernel<T, S, D> get_wide_reduction_kernel(ReductionOperator op) {
+  return get_wide_reduction_kernel<T, S, D>(op, get_simd_level());
+}
+
+}  // namespace internal
+}  // namespace Al
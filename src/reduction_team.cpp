@@ -0,0 +1,251 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.  Produced at the
+// Lawrence Livermore National Laboratory in collaboration with University of
+// Illinois Urbana-Champaign.
+//
+// Written by the LBANN Research Team (N. Dryden, N. Maruyama, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-756777.
+// All rights reserved.
+//
+// This file is part of Aluminum GPU-aware Communication Library. For details, see
+// http://software.llnl.gov/Aluminum or https://github.com/LLNL/Aluminum.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <hwloc.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <limits>
+#include <string>
+#include "reduction_team.hpp"
+#include "reduction_kernels.hpp"
+#include "profiling.hpp"
+#include "tuning_params.hpp"
+#include "utils.hpp"
+
+// For ancient versions of hwloc.
+#if HWLOC_API_VERSION < 0x00010b00
+#define HWLOC_OBJ_NUMANODE HWLOC_OBJ_NODE
+#endif
+
+namespace Al {
+namespace internal {
+
+namespace {
+
+/** The reduction team, if there is one. */
+ReductionTeam* team = nullptr;
+
+/**
+ * Bind the calling thread to core (counted within the NUMA node, wrapping
+ * around) of NUMA node numa_node. This is best effort: the team still works,
+ * if less well, when a thread cannot be bound.
+ */
+void bind_to_core(int numa_node, int core) {
+  hwloc_topology_t topo;
+  hwloc_topology_init(&topo);
+  hwloc_topology_load(topo);
+  hwloc_obj_t node = nullptr;
+  while ((node = hwloc_get_next_obj_by_type(topo, HWLOC_OBJ_NUMANODE, node))
+         != nullptr) {
+    if (node->os_index == static_cast<unsigned>(numa_node)) {
+      break;
+    }
+  }
+  if (node != nullptr) {
+    const int num_cores = hwloc_get_nbobjs_inside_cpuset_by_type(
+      topo, node->cpuset, HWLOC_OBJ_CORE);
+    if (num_cores > 0) {
+      hwloc_obj_t core_obj = hwloc_get_obj_inside_cpuset_by_type(
+        topo, node->cpuset, HWLOC_OBJ_CORE,
+        ((core % num_cores) + num_cores) % num_cores);
+      if (core_obj != nullptr) {
+        hwloc_cpuset_t coreset = hwloc_bitmap_dup(core_obj->cpuset);
+        hwloc_bitmap_singlify(coreset);
+        hwloc_set_cpubind(topo, coreset, HWLOC_CPUBIND_THREAD);
+        hwloc_bitmap_free(coreset);
+      }
+    }
+  }
+  hwloc_topology_destroy(topo);
+}
+
+/** Return the shortest of several runs of sum kernel over count floats. */
+double time_sum(ReductionKernel<float> kernel, const float* src, float* dest,
+                size_t count) {
+  constexpr int num_runs = 5;
+  double best = std::numeric_limits<double>::max();
+  for (int i = 0; i < num_runs; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    kernel(src, dest, count);
+    std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  return best;
+}
+
+/**
+ * Return the smallest size, in bytes, from which splitting a float sum among
+ * the team beats one thread by a clear margin, or the largest size_t if it
+ * never does up to 16 MiB. To be robust to noise, the team must also win at
+ * twice that size.
+ */
+size_t calibrate_min_bytes(ReductionTeam& reduction_team) {
+  constexpr size_t max_count = size_t(1) << 22;
+  std::vector<float> src(max_count, 1.0f);
+  std::vector<float> dest(max_count, 0.0f);
+  auto kernel = get_reduction_kernel<float>(ReductionOperator::sum);
+  bool won_last = false;
+  for (size_t count = size_t(1) << 12; count <= max_count; count *= 2) {
+    reduction_team.set_min_bytes(std::numeric_limits<size_t>::max());
+    const double alone = time_sum(kernel, src.data(), dest.data(), count);
+    reduction_team.set_min_bytes(0);
+    const double split = time_sum(kernel, src.data(), dest.data(), count);
+    const bool won = split < 0.8 * alone;
+    if (won && won_last) {
+      return count / 2 * sizeof(float);
+    }
+    won_last = won;
+  }
+  return std::numeric_limits<size_t>::max();
+}
+
+}  // namespace
+
+ReductionTeam::ReductionTeam(size_t num_threads, int numa_node,
+                             int first_core) :
+  stop_flag(false), busy(false), job(0), parts_done(0),
+  min_bytes(std::numeric_limits<size_t>::max()), num_sleeping(0) {
+  if (num_threads > 0xffff) {
+    throw_al_exception("Too many reduction team threads");
+  }
+  spin_iters = get_env_size("AL_REDUCTION_TEAM_SPIN_ITERS",
+                            AL_REDUCTION_TEAM_SPIN_ITERS);
+  for (size_t i = 0; i < num_threads; ++i) {
+    threads.emplace_back(&ReductionTeam::worker, this, numa_node,
+                         first_core - static_cast<int>(i));
+    profiling::name_thread(threads.back().native_handle(),
+                           "al-reduce-" + std::to_string(i));
+  }
+}
+
+ReductionTeam::~ReductionTeam() {
+  {
+    std::lock_guard<std::mutex> lock(job_mutex);
+    stop_flag = true;
+  }
+  job_cv.notify_all();
+  for (auto&& t : threads) {
+    t.join();
+  }
+}
+
+bool ReductionTeam::run(size_t num_parts, PartFunction fn, void* arg) {
+  bool expected = false;
+  if (num_parts > 0xffff
+      || !busy.compare_exchange_strong(expected, true,
+                                       std::memory_order_acquire)) {
+    return false;
+  }
+  // No part of the previous job is left, so no thread reads these now.
+  job_fn = fn;
+  job_arg = arg;
+  parts_done.store(0, std::memory_order_relaxed);
+  const uint64_t generation = (job.load(std::memory_order_relaxed) >> 32) + 1;
+  const uint64_t word = (generation << 32) | (num_parts << 16);
+  // Pairs with the blocking threads: either they see the job, or we see
+  // that they are asleep.
+  job.store(word, std::memory_order_seq_cst);
+  if (num_sleeping.load(std::memory_order_seq_cst) > 0) {
+    std::lock_guard<std::mutex> lock(job_mutex);
+    job_cv.notify_all();
+  }
+  run_parts(word);
+  while (parts_done.load(std::memory_order_acquire) < num_parts) {
+    std::this_thread::yield();
+  }
+  busy.store(false, std::memory_order_release);
+  return true;
+}
+
+void ReductionTeam::run_parts(uint64_t word) {
+  while ((word & 0xffff) < ((word >> 16) & 0xffff)) {
+    // On failure, word is reloaded and may be a later job's, whose function
+    // and argument were published before it.
+    if (job.compare_exchange_weak(word, word + 1,
+                                  std::memory_order_acq_rel,
+                                  std::memory_order_acquire)) {
+      job_fn(job_arg, word & 0xffff);
+      parts_done.fetch_add(1, std::memory_order_release);
+      ++word;
+    }
+  }
+}
+
+void ReductionTeam::worker(int numa_node, int core) {
+  if (numa_node >= 0) {
+    bind_to_core(numa_node, core);
+  }
+  size_t spins = 0;
+  while (!stop_flag.load(std::memory_order_acquire)) {
+    const uint64_t word = job.load(std::memory_order_acquire);
+    if ((word & 0xffff) < ((word >> 16) & 0xffff)) {
+      run_parts(word);
+      spins = 0;
+    } else if (++spins >= spin_iters) {
+      // Block until a new job is posted.
+      std::unique_lock<std::mutex> lock(job_mutex);
+      num_sleeping.fetch_add(1, std::memory_order_seq_cst);
+      job_cv.wait(lock, [&] {
+          return stop_flag.load(std::memory_order_relaxed)
+            || job.load(std::memory_order_seq_cst) != word;
+        });
+      num_sleeping.fetch_sub(1, std::memory_order_relaxed);
+      spins = 0;
+    }
+  }
+}
+
+void init_reduction_team(int numa_node, int first_core) {
+  const size_t num_threads = get_env_size("AL_REDUCTION_TEAM_THREADS",
+                                          AL_REDUCTION_TEAM_THREADS);
+  if (num_threads == 0) {
+    return;
+  }
+  team = new ReductionTeam(num_threads, numa_node, first_core);
+  size_t min_bytes = get_env_size("AL_REDUCTION_TEAM_MIN_BYTES",
+                                  AL_REDUCTION_TEAM_MIN_BYTES);
+  if (min_bytes == 0) {
+    // The team must be visible to the kernels to time it.
+    min_bytes = calibrate_min_bytes(*team);
+  }
+  team->set_min_bytes(min_bytes);
+}
+
+void finalize_reduction_team() {
+  delete team;
+  team = nullptr;
+}
+
+ReductionTeam* get_reduction_team() {
+  return team;
+}
+
+}  // namespace internal
+}  // namespace Al
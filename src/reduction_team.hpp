@@ -0,0 +1,130 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.  Produced at the
+// Lawrence Livermore National Laboratory in collaboration with University of
+// Illinois Urbana-Champaign.
+//
+// Written by the LBANN Research Team (N. Dryden, N. Maruyama, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-756777.
+// All rights reserved.
+//
+// This file is part of Aluminum GPU-aware Communication Library. For details, see
+// http://software.llnl.gov/Aluminum or https://github.com/LLNL/Aluminum.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Al {
+namespace internal {
+
+/**
+ * Threads owned by Aluminum that split large reductions with the thread
+ * running them, instead of having it fork an OpenMP team on every call.
+ * The threads are bound to cores next to the progress engine's, spin for a
+ * while after each job, and then block until the next one.
+ * A job is divided into parts that the caller and the team's threads claim
+ * one at a time, so the caller finishes the job alone if the team is slow to
+ * wake up. The team runs one job at a time; other callers reduce by
+ * themselves meanwhile.
+ */
+class ReductionTeam {
+ public:
+  /** Runs one part of a job, given the job's argument. */
+  using PartFunction = void (*)(void* arg, size_t part);
+
+  /**
+   * Start num_threads threads, bound to the cores of NUMA node numa_node
+   * counting down from first_core, wrapping around within the node (so
+   * first_core may be negative). They are not bound if numa_node is negative.
+   */
+  ReductionTeam(size_t num_threads, int numa_node, int first_core);
+  ~ReductionTeam();
+
+  /** Return the number of threads in the team, not counting callers. */
+  size_t get_num_threads() const { return threads.size(); }
+  /** Return the smallest reduction, in bytes, to split among the team. */
+  size_t get_min_bytes() const {
+    return min_bytes.load(std::memory_order_relaxed);
+  }
+  /** Split reductions of at least bytes bytes among the team. */
+  void set_min_bytes(size_t bytes) {
+    min_bytes.store(bytes, std::memory_order_relaxed);
+  }
+  /**
+   * Run fn(arg, part) for every part in [0, num_parts) on the calling thread
+   * and the team, and return once all have completed.
+   * If the team is busy with another caller's job, return false without
+   * running anything.
+   */
+  bool run(size_t num_parts, PartFunction fn, void* arg);
+
+ private:
+  /** Threads in the team. */
+  std::vector<std::thread> threads;
+  /** Set to stop the threads. */
+  std::atomic<bool> stop_flag;
+  /** Set while a caller's job is running. */
+  std::atomic<bool> busy;
+  /**
+   * Current job: a generation in the upper 32 bits, then the number of parts
+   * and the next part to claim in 16 bits each.
+   */
+  std::atomic<uint64_t> job;
+  /** Function and argument of the current job. */
+  PartFunction job_fn = nullptr;
+  void* job_arg = nullptr;
+  /** Number of parts of the current job that have completed. */
+  std::atomic<size_t> parts_done;
+  /** Smallest reduction, in bytes, to split among the team. */
+  std::atomic<size_t> min_bytes;
+  /** Number of times idle threads poll for a job before blocking. */
+  size_t spin_iters;
+  /** Number of threads blocked waiting for a job. */
+  std::atomic<size_t> num_sleeping;
+  /** Protects blocking threads' wait on job_cv. */
+  std::mutex job_mutex;
+  /** Notified when a job is posted while threads are blocked. */
+  std::condition_variable job_cv;
+
+  /** Claim and run parts of the job in word until there are none left. */
+  void run_parts(uint64_t word);
+  /** Main loop of a team thread. */
+  void worker(int numa_node, int core);
+};
+
+/**
+ * Start the reduction team, with AL_REDUCTION_TEAM_THREADS threads bound to
+ * cores on NUMA node numa_node counting down from first_core, and calibrate
+ * its threshold unless AL_REDUCTION_TEAM_MIN_BYTES is set. This does nothing
+ * if the team has no threads. It is called by Initialize.
+ */
+void init_reduction_team(int numa_node, int first_core);
+/** Stop the reduction team. It is called by Finalize. */
+void finalize_reduction_team();
+/** Return the reduction team, or null if there is none. */
+ReductionTeam* get_reduction_team();
+
+}  // namespace internal
+}  // namespace Al
@@ -0,0 +1,153 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.  Produced at the
+// Lawrence Livermore National Laboratory in collaboration with University of
+// Illinois Urbana-Champaign.
+//
+// Written by the LBANN Research Team (N. Dryden, N. Maruyama, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-756777.
+// All rights reserved.
+//
+// This file is part of Aluminum GPU-aware Communication Library. For details, see
+// http://software.llnl.gov/Aluminum or https://github.com/LLNL/Aluminum.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include "base.hpp"
+
+namespace Al {
+namespace internal {
+
+/**
+ * A pool of objects of type T that are allocated in slabs and never freed.
+ *
+ * Objects are default-constructed once, when their slab is allocated, and
+ * keep their state across get/put, so T can carry information (e.g. a
+ * generation counter) that must survive reuse. T must have a `T* pool_next`
+ * member, which the pool uses only while the object is free.
+ *
+ * Each thread keeps a cache of free objects. Objects move in batches of
+ * CacheSize between thread caches and a global mutex-protected list, so an
+ * object may be put by a different thread than the one that got it.
+ */
+template <typename T, size_t CacheSize = 64, size_t SlabSize = 256>
+class SlabPool {
+ public:
+  /** Return a free object. */
+  static T* get() {
+    ThreadCache& cache = get_cache();
+    if (cache.head == nullptr) {
+      refill(cache);
+    }
+    T* obj = cache.head;
+    cache.head = obj->pool_next;
+    --cache.count;
+    return obj;
+  }
+  /** Return obj to the pool. */
+  static void put(T* obj) {
+    ThreadCache& cache = get_cache();
+    obj->pool_next = cache.head;
+    cache.head = obj;
+    ++cache.count;
+    if (cache.count >= 2*CacheSize) {
+      spill(cache, CacheSize);
+    }
+  }
+ private:
+  /** Per-thread list of free objects. */
+  struct ThreadCache {
+    T* head = nullptr;
+    size_t count = 0;
+    ~ThreadCache() {
+      // Return everything so other threads can use it.
+      if (count > 0) {
+        spill(*this, count);
+      }
+    }
+  };
+  /** Global list of free objects. */
+  struct GlobalList {
+    std::mutex lock;
+    T* head = nullptr;
+    size_t count = 0;
+  };
+  /** Return the global list; this is never destroyed. */
+  static GlobalList& get_global() {
+    static GlobalList* global = new GlobalList();
+    return *global;
+  }
+  /** Return the calling thread's cache. */
+  static ThreadCache& get_cache() {
+    static thread_local ThreadCache cache;
+    return cache;
+  }
+  /** Move up to CacheSize objects into an empty cache. */
+  static void refill(ThreadCache& cache) {
+    GlobalList& global = get_global();
+    {
+      std::lock_guard<std::mutex> lock(global.lock);
+      while (global.head != nullptr && cache.count < CacheSize) {
+        T* obj = global.head;
+        global.head = obj->pool_next;
+        --global.count;
+        obj->pool_next = cache.head;
+        cache.head = obj;
+        ++cache.count;
+      }
+    }
+    if (cache.head == nullptr) {
+      allocate_slab(cache);
+    }
+  }
+  /** Move n objects from cache to the global list. */
+  static void spill(ThreadCache& cache, size_t n) {
+    GlobalList& global = get_global();
+    std::lock_guard<std::mutex> lock(global.lock);
+    for (size_t i = 0; i < n; ++i) {
+      T* obj = cache.head;
+      cache.head = obj->pool_next;
+      --cache.count;
+      obj->pool_next = global.head;
+      global.head = obj;
+      ++global.count;
+    }
+  }
+  /** Allocate a new slab of objects into cache. */
+  static void allocate_slab(ThreadCache& cache) {
+    // Align slabs to cache lines so padded types do not share lines.
+    constexpr size_t align = alignof(T) > 64 ? alignof(T) : 64;
+    void* mem = nullptr;
+    if (posix_memalign(&mem, align, sizeof(T)*SlabSize) != 0) {
+      throw_al_exception("Could not allocate slab");
+    }
+    T* slab = static_cast<T*>(mem);
+    for (size_t i = 0; i < SlabSize; ++i) {
+      T* obj = new (&slab[i]) T();
+      obj->pool_next = cache.head;
+      cache.head = obj;
+      ++cache.count;
+    }
+  }
+};
+
+}  // namespace internal
+}  // namespace Al
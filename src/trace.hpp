@@ -49,7 +49,7 @@ void save_trace_entry(std::string entry, bool progress = false);
 /** Record an operation to the trace log. */
 template <typename Backend, typename T, typename... Args>
 #ifdef AL_TRACE
-void record_op(std::string op, typename Backend::comm_type& comm, Args... args) {
+void record_op(const char* op, typename Backend::comm_type& comm, Args... args) {
   std::stringstream ss;
   ss << get_time() << ": "
      << Backend::Name() << " "
@@ -63,7 +63,7 @@ void record_op(std::string op, typename Backend::comm_type& comm, Args... args)
   save_trace_entry(ss.str(), false);
 }
 #else  // AL_TRACE
-void record_op(std::string, typename Backend::comm_type&, Args...) {
+void record_op(const char*, typename Backend::comm_type&, Args...) {
 }
 #endif  // AL_TRACE
 
@@ -32,32 +32,176 @@
  */
 #pragma once
 
-/** Whether to use OpenMP for reduction operators. */
-#define AL_MPI_USE_OPENMP 0
-/** Use multiple threads for sum reductions this size or larger. */
-#define AL_MPI_MULTITHREAD_SUM_THRESH 262144
-/** Use multiple threads for prod reductions this size or larger. */
-#define AL_MPI_MULTITHREAD_PROD_THRESH 262144
-/** Use multiple threads for min/max reductions this size or larger. */
-// Note: May need to re-benchmark this to deal with branch prediction.
-#define AL_MPI_MULTITHREAD_MINMAX_THRESH 262144
-/** Use multiple threads for logical reductions this size or larger. */
-#define AL_MPI_MULTITHREAD_LOGICAL_THRESH 262144
-/** Use multiple threads for bitwise reductions this size or larger. */
-#define AL_MPI_MULTITHREAD_BITWISE_THRESH 262144
+/**
+ * Number of threads Aluminum starts to split large reductions with the
+ * thread running them; 0 for none. They are bound to the cores below the
+ * progress engine's. Overridden by AL_REDUCTION_TEAM_THREADS.
+ */
+#define AL_REDUCTION_TEAM_THREADS 0
+/**
+ * Split reductions of this many bytes or more among the reduction team; 0 to
+ * measure when splitting pays off when Aluminum is initialized.
+ * Overridden by AL_REDUCTION_TEAM_MIN_BYTES.
+ */
+#define AL_REDUCTION_TEAM_MIN_BYTES 0
+/**
+ * Number of times idle reduction team threads poll for work before they
+ * block. Overridden by AL_REDUCTION_TEAM_SPIN_ITERS.
+ */
+#define AL_REDUCTION_TEAM_SPIN_ITERS 100000
+/**
+ * Most capable instruction set reduction kernels may use, if the CPU supports
+ * it: 0 for scalar code, 1 for SSE2, 2 for AVX2, 3 for AVX-512. Overridden by
+ * AL_REDUCTION_MAX_SIMD_LEVEL.
+ */
+#define AL_REDUCTION_MAX_SIMD_LEVEL 3
+/**
+ * Reductions writing this many bytes or more use non-temporal stores, so
+ * results that will not be read again soon do not evict the cache, and
+ * prefetch the data they reduce in; 0 for the size of the last-level cache.
+ * Overridden by AL_REDUCTION_STREAMING_MIN_BYTES.
+ */
+#define AL_REDUCTION_STREAMING_MIN_BYTES 0
+/**
+ * How far ahead, in bytes, streaming reductions prefetch the data they
+ * reduce in. Overridden by AL_REDUCTION_PREFETCH_BYTES.
+ */
+#define AL_REDUCTION_PREFETCH_BYTES 512
+/**
+ * Nonzero for MPI ring allreduces (blocking, non-blocking, and persistent) of
+ * 16-bit floating point types to keep partial results in float during the
+ * reduce-scatter, rounding only final results. This doubles the
+ * reduce-scatter's traffic for accuracy, and makes the ring the automatic
+ * algorithm for large allreduces of these types. Other algorithms still round
+ * every partial result, except the biring, which throws instead.
+ * Overridden by AL_MPI_HALF_FP32_PARTIALS.
+ */
+#define AL_MPI_HALF_FP32_PARTIALS 0
 
 /**
  * Number of concurrent operations the progress engine will perform.
- * This must be a positive number.
+ * This must be a positive number. Small operations are counted separately.
+ * Overridden by AL_PE_NUM_CONCURRENT_OPS.
  */
 #define AL_PE_NUM_CONCURRENT_OPS 4
-/** Max number of streams the progress engine supports. */
+/**
+ * Number of concurrent small operations the progress engine will perform.
+ * Overridden by AL_PE_NUM_CONCURRENT_SMALL_OPS.
+ */
+#define AL_PE_NUM_CONCURRENT_SMALL_OPS 16
+/**
+ * Operations communicating at most this many bytes are small: they have
+ * their own concurrency limit and do not count toward the byte limits.
+ * Overridden by AL_PE_SMALL_OP_BYTES.
+ */
+#define AL_PE_SMALL_OP_BYTES 65536
+/**
+ * Max bytes that operations in progress may communicate; 0 for no limit.
+ * An operation is always started if nothing else is in flight.
+ * Overridden by AL_PE_MAX_BYTES_IN_FLIGHT.
+ */
+#define AL_PE_MAX_BYTES_IN_FLIGHT (size_t(1) << 28)
+/**
+ * Max bytes in flight on any one communicator; 0 for no limit.
+ * Overridden by AL_PE_COMM_BYTES_QUOTA.
+ */
+#define AL_PE_COMM_BYTES_QUOTA 0
+/**
+ * Number of additional concurrent operations reserved for high-priority
+ * operations, on top of AL_PE_NUM_CONCURRENT_OPS.
+ * Overridden by AL_PE_NUM_HIGH_PRIORITY_SLOTS.
+ */
+#define AL_PE_NUM_HIGH_PRIORITY_SLOTS 2
+/**
+ * Number of streams the progress engine initially has room for.
+ * The stream table grows in chunks of twice the previous size as needed.
+ * Overridden by AL_PE_NUM_STREAMS.
+ */
 #define AL_PE_NUM_STREAMS 64
-/** Max number of pipeline stages the progress engine supports. */
+/**
+ * Max number of stream table chunks.
+ * This allows AL_PE_NUM_STREAMS * (2^AL_PE_MAX_STREAM_CHUNKS - 1) streams.
+ */
+#define AL_PE_MAX_STREAM_CHUNKS 32
+/** Number of operations each stream's input queue can hold; a power of 2. */
+#define AL_PE_INPUT_QUEUE_SIZE (1<<13)
+/** Number of high-priority operations each stream can queue; a power of 2. */
+#define AL_PE_HIGH_PRIORITY_QUEUE_SIZE (1<<10)
+/**
+ * Number of pipeline stages the progress engine supports.
+ * Overridden by AL_PE_NUM_PIPELINE_STAGES.
+ */
 #define AL_PE_NUM_PIPELINE_STAGES 2
+/**
+ * Default policy for user threads waiting on a request.
+ * This is overridden by the AL_WAIT_POLICY environment variable.
+ */
+#define AL_PE_DEFAULT_WAIT_POLICY spin_block
+/**
+ * Number of times a waiting thread polls a request before it yields or
+ * blocks. This is overridden by the AL_WAIT_SPIN_ITERS environment variable.
+ */
+#define AL_PE_WAIT_SPIN_ITERS 100000
+/**
+ * Number of consecutive idle iterations the progress engine spins for before
+ * it starts backing off. Overridden by AL_PE_IDLE_SPIN_ITERS.
+ */
+#define AL_PE_IDLE_SPIN_ITERS 100000
+/**
+ * Number of idle iterations the progress engine yields for after spinning,
+ * before it sleeps until new work arrives. Overridden by AL_PE_IDLE_YIELD_ITERS.
+ */
+#define AL_PE_IDLE_YIELD_ITERS 1000
+/**
+ * Number of progress engine threads. Streams are divided among them, and idle
+ * threads steal steps from busy ones. Overridden by AL_PE_NUM_THREADS.
+ */
+#define AL_PE_NUM_THREADS 1
+/**
+ * Whether the progress engine tests the MPI requests of all running
+ * operations together with one MPI_Testsome per iteration, rather than each
+ * operation testing its own. Overridden by AL_PE_AGGREGATE_MPI_POLLING.
+ */
+#define AL_PE_AGGREGATE_MPI_POLLING 1
 
-/** Whether to protect memory pools with locks. */
-#define AL_LOCK_MEMPOOL 1
+/**
+ * Maximum number of free blocks of each size class the memory pool keeps in a
+ * thread's cache; 0 disables caching. Overridden by AL_MEMPOOL_CACHE_BLOCKS.
+ */
+#define AL_MEMPOOL_CACHE_BLOCKS 16
+/**
+ * Largest memory pool block, in bytes, kept in thread caches. Larger blocks
+ * always go through the pool's shared, locked lists. Overridden by
+ * AL_MEMPOOL_CACHE_MAX_BYTES.
+ */
+#define AL_MEMPOOL_CACHE_MAX_BYTES (1<<20)
+/**
+ * Bytes the host memory pool maps, binds to the progress engine's NUMA node,
+ * and pre-faults when Aluminum is initialized; 0 disables the arena. Every
+ * rank pays for this at initialization, whether or not it uses the pool, and
+ * arena memory is never freed by trimming, so it is off by default.
+ * Overridden by AL_MEMPOOL_ARENA_BYTES.
+ */
+#define AL_MEMPOOL_ARENA_BYTES 0
+/**
+ * Huge pages for host memory pool memory: 0 for none, 1 for transparent huge
+ * pages, 2 for explicit (hugetlbfs) huge pages, falling back to transparent
+ * ones if they cannot be had. Overridden by AL_MEMPOOL_HUGE_PAGES.
+ */
+#define AL_MEMPOOL_HUGE_PAGES 1
+/**
+ * Soft limit, in bytes, on memory the host memory pool and the MPI_Alloc_mem
+ * pool hold together; 0 for none. Idle blocks are freed, those of the
+ * MPI_Alloc_mem pool first, to stay under it. The pinned memory pool has a
+ * limit of its own of the same size. Overridden by AL_MEMPOOL_MAX_BYTES.
+ */
+#define AL_MEMPOOL_MAX_BYTES 0
+/**
+ * Nonzero to allocate scratch buffers for host algorithms with MPI_Alloc_mem,
+ * so the MPI library can register them with the network once and reuse them.
+ * Overridden by AL_MEMPOOL_MPI_ALLOC.
+ */
+#define AL_MEMPOOL_MPI_ALLOC 0
 
 /** Amount of sync object memory to preallocate in the pool. */
 #define AL_SYNC_MEM_PREALLOC 1024
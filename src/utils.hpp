@@ -27,7 +27,12 @@
 
 #pragma once
 
+#include <cerrno>
 #include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <string>
+#include "base.hpp"
 
 namespace Al {
 
@@ -38,4 +43,28 @@ inline double get_time() {
     steady_clock::now().time_since_epoch()).count();                            
 }
 
+namespace internal {
+
+/**
+ * Return the value of environment variable name, a non-negative decimal
+ * integer, or default_value if it is not set.
+ */
+inline size_t get_env_size(const char* name, size_t default_value) {
+  const char* env = std::getenv(name);
+  if (env == nullptr) {
+    return default_value;
+  }
+  // strtoull would also skip whitespace and accept a sign.
+  char* end = nullptr;
+  errno = 0;
+  const unsigned long long value = std::strtoull(env, &end, 10);
+  if (*env < '0' || *env > '9' || *end != '\0' || errno == ERANGE
+      || value > static_cast<size_t>(-1)) {
+    throw_al_exception(std::string("Invalid value for ") + name + ": \""
+                       + env + "\"");
+  }
+  return static_cast<size_t>(value);
+}
+
+}  // namespace internal
 }  // namespace Al
@@ -0,0 +1,252 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.  Produced at the
+// Lawrence Livermore National Laboratory in collaboration with University of
+// Illinois Urbana-Champaign.
+//
+// Written by the LBANN Research Team (N. Dryden, N. Maruyama, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-756777.
+// All rights reserved.
+//
+// This file is part of Aluminum GPU-aware Communication Library. For details, see
+// http://software.llnl.gov/Aluminum or https://github.com/LLNL/Aluminum.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <iostream>
+#include "Al.hpp"
+#include "test_utils.hpp"
+
+#include <stdlib.h>
+#include <algorithm>
+#include <string>
+#include <type_traits>
+
+size_t start_size = 1;
+size_t max_size = 1<<30;
+
+/**
+ * Generate input for 16-bit floating point allreduces.
+ * Values are small integers, so sums over any reasonable number of processes
+ * are exact in both float16 and bfloat16.
+ */
+template <typename T>
+std::vector<T> gen_half_data(size_t count, int rank) {
+  std::vector<T> v(count);
+  for (size_t i = 0; i < count; ++i) {
+    v[i] = static_cast<float>(static_cast<int>((rank + i) % 8) - 3);
+  }
+  return v;
+}
+
+/** Return the expected result of reducing gen_half_data with op. */
+template <typename T>
+std::vector<T> get_expected_half_result(size_t count, int nprocs,
+                                        Al::ReductionOperator op) {
+  std::vector<T> expected(count);
+  for (size_t i = 0; i < count; ++i) {
+    float result = op == Al::ReductionOperator::sum ? 0.0f : -1000.0f;
+    for (int rank = 0; rank < nprocs; ++rank) {
+      const float v = static_cast<int>((rank + i) % 8) - 3;
+      result = op == Al::ReductionOperator::sum ? result + v
+        : std::max(result, v);
+    }
+    expected[i] = result;
+  }
+  return expected;
+}
+
+/** Return true if expected and actual hold the same values. */
+template <typename T>
+bool check_half_vector(const std::vector<T>& expected,
+                       const std::vector<T>& actual) {
+  for (size_t i = 0; i < expected.size(); ++i) {
+    if (expected[i].bits != actual[i].bits) {
+      std::cout << "Expected " << static_cast<float>(expected[i])
+                << " but got " << static_cast<float>(actual[i])
+                << " at " << i << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+/** Test blocking and non-blocking allreduce algo on T with op. */
+template <typename T>
+void test_half_allreduce_algo(size_t size, Al::MPICommunicator& comm,
+                              Al::MPIAllreduceAlgorithm algo, bool nb,
+                              Al::ReductionOperator op) {
+  auto expected = get_expected_half_result<T>(size, comm.size(), op);
+  auto input = gen_half_data<T>(size, comm.rank());
+  std::vector<T> recv(size);
+  Al::MPIBackend::req_type req = get_request<Al::MPIBackend>();
+  // Test regular allreduce.
+  if (nb) {
+    Al::NonblockingAllreduce<Al::MPIBackend>(input.data(), recv.data(), size,
+                                             op, comm, req, algo);
+    Al::Wait<Al::MPIBackend>(req);
+  } else {
+    Al::Allreduce<Al::MPIBackend>(input.data(), recv.data(), size, op, comm,
+                                  algo);
+  }
+  if (!check_half_vector(expected, recv)) {
+    std::cout << comm.rank() << ": regular allreduce does not match" <<
+      std::endl;
+    std::abort();
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+  // Test in-place allreduce.
+  if (nb) {
+    Al::NonblockingAllreduce<Al::MPIBackend>(input.data(), size, op, comm,
+                                             req, algo);
+    Al::Wait<Al::MPIBackend>(req);
+  } else {
+    Al::Allreduce<Al::MPIBackend>(input.data(), size, op, comm, algo);
+  }
+  if (!check_half_vector(expected, input)) {
+    std::cout << comm.rank() << ": in-place allreduce does not match" <<
+      std::endl;
+    std::abort();
+  }
+}
+
+/**
+ * Return the smallest power of 2 at which T cannot represent odd integers:
+ * adding 1 to it rounds back down.
+ */
+template <typename T>
+float get_half_odd_limit() {
+  return std::is_same<T, Al::bfloat16>::value ? 256.0f : 2048.0f;
+}
+
+/**
+ * Test that ring sums of T keeping partial results in float round only once:
+ * rank 0 contributes get_half_odd_limit and every other rank 1, so any slice
+ * rank 0 starts is lost if partial results are rounded to T.
+ * This tests the blocking, non-blocking, and persistent rings.
+ */
+template <typename T>
+void test_half_single_rounding(size_t size, Al::MPICommunicator& comm) {
+  const float big = get_half_odd_limit<T>();
+  std::vector<T> expected(
+    size, T(big + static_cast<float>(comm.size() - 1)));
+  const std::vector<T> input(size, T(comm.rank() == 0 ? big : 1.0f));
+  std::vector<T> recv(size);
+  const auto algo = Al::MPIAllreduceAlgorithm::mpi_ring;
+  Al::MPIBackend::req_type req = get_request<Al::MPIBackend>();
+  Al::Allreduce<Al::MPIBackend>(input.data(), recv.data(), size,
+                                Al::ReductionOperator::sum, comm, algo);
+  if (!check_half_vector(expected, recv)) {
+    std::cout << comm.rank() << ": ring allreduce rounds partial results"
+              << std::endl;
+    std::abort();
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+  std::fill(recv.begin(), recv.end(), T(0.0f));
+  Al::NonblockingAllreduce<Al::MPIBackend>(input.data(), recv.data(), size,
+                                           Al::ReductionOperator::sum, comm,
+                                           req, algo);
+  Al::Wait<Al::MPIBackend>(req);
+  if (!check_half_vector(expected, recv)) {
+    std::cout << comm.rank() << ": non-blocking ring allreduce rounds"
+              << " partial results" << std::endl;
+    std::abort();
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+  std::fill(recv.begin(), recv.end(), T(0.0f));
+  Al::MPIBackend::persistent_req_type preq =
+    Al::MPIBackend::null_persistent_req;
+  Al::AllreduceInit<Al::MPIBackend>(input.data(), recv.data(), size,
+                                    Al::ReductionOperator::sum, comm, preq,
+                                    algo);
+  Al::Start<Al::MPIBackend>(preq, req);
+  Al::Wait<Al::MPIBackend>(req);
+  Al::RequestFree<Al::MPIBackend>(preq);
+  if (!check_half_vector(expected, recv)) {
+    std::cout << comm.rank() << ": persistent ring allreduce rounds"
+              << " partial results" << std::endl;
+    std::abort();
+  }
+}
+
+template <typename T>
+void test_correctness(const std::string& type_name) {
+  auto algos = get_allreduce_algorithms<Al::MPIBackend>();
+  if (Al::internal::mpi::use_fp32_partials()) {
+    // The biring does not keep partial results in float, and throws.
+    algos.erase(std::remove(algos.begin(), algos.end(),
+                            Al::MPIAllreduceAlgorithm::mpi_biring),
+                algos.end());
+  }
+  auto nb_algos = get_nb_allreduce_algorithms<Al::MPIBackend>();
+  Al::MPICommunicator comm =
+    get_comm_with_stream<Al::MPIBackend>(MPI_COMM_WORLD);
+  // Compute sizes to test.
+  std::vector<size_t> sizes = get_sizes(start_size, max_size, true);
+  for (const auto& size : sizes) {
+    if (comm.rank() == 0) {
+      std::cout << "Testing " << type_name << " size "
+                << human_readable_size(size) << std::endl;
+    }
+    for (auto&& op : {Al::ReductionOperator::sum,
+                      Al::ReductionOperator::max}) {
+      for (auto&& algo : algos) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        if (comm.rank() == 0) {
+          std::cout << " Algo: " << Al::algorithm_name(algo) << std::endl;
+        }
+        test_half_allreduce_algo<T>(size, comm, algo, false, op);
+      }
+      for (auto&& algo : nb_algos) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        if (comm.rank() == 0) {
+          std::cout << " Algo: NB " << Al::algorithm_name(algo) << std::endl;
+        }
+        test_half_allreduce_algo<T>(size, comm, algo, true, op);
+      }
+    }
+    if (Al::internal::mpi::use_fp32_partials()) {
+      MPI_Barrier(MPI_COMM_WORLD);
+      if (comm.rank() == 0) {
+        std::cout << " Single rounding with float partial results"
+                  << std::endl;
+      }
+      test_half_single_rounding<T>(size, comm);
+    }
+  }
+  free_comm_with_stream<Al::MPIBackend>(comm);
+}
+
+int main(int argc, char** argv) {
+  Al::Initialize(argc, argv);
+
+  std::string backend = "MPI";
+  parse_args(argc, argv, backend, start_size, max_size);
+
+  // 16-bit floating point types are only supported by the MPI backend.
+  // AL_MPI_HALF_FP32_PARTIALS=1 tests keeping partial results in float; the
+  // CTest entries run both.
+  if (backend == "MPI") {
+    test_correctness<Al::float16>("float16");
+    test_correctness<Al::bfloat16>("bfloat16");
+  } else {
+    std::cerr << "16-bit floating point types are not supported by backend "
+              << backend << std::endl;
+  }
+
+  Al::Finalize();
+  return 0;
+}
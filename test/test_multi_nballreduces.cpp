@@ -25,6 +25,7 @@
 // permissions and limitations under the license.
 ////////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include "Al.hpp"
@@ -40,6 +41,32 @@ size_t max_size = 1<<20;
 const size_t num_concurrent = 1024;
 const size_t num_blocking = 8;
 
+/**
+ * Start allreduce i. Where supported, every other one is driven by the
+ * caller, to check these interoperate with ones run by the progress engine.
+ */
+template <typename Backend>
+void start_allreduce(typename VectorType<Backend>::type& data,
+                     typename Backend::comm_type& comm,
+                     typename Backend::req_type& req,
+                     typename Backend::allreduce_algo_type algo, size_t) {
+  Al::NonblockingAllreduce<Backend>(data.data(), data.size(),
+                                    Al::ReductionOperator::sum,
+                                    comm, req, algo);
+}
+
+template <>
+void start_allreduce<Al::MPIBackend>(
+  typename VectorType<Al::MPIBackend>::type& data,
+  typename Al::MPIBackend::comm_type& comm,
+  typename Al::MPIBackend::req_type& req,
+  typename Al::MPIBackend::allreduce_algo_type algo, size_t i) {
+  Al::NonblockingAllreduce<Al::MPIBackend>(
+    data.data(), data.size(), Al::ReductionOperator::sum, comm, req, algo,
+    Al::OpPriority::normal,
+    i % 2 ? Al::ProgressMode::caller : Al::ProgressMode::engine);
+}
+
 template <typename Backend>
 void test_multiple_nballreduces() {
   auto algos = get_nb_allreduce_algorithms<Backend>();
@@ -51,7 +78,8 @@ void test_multiple_nballreduces() {
       sizes.push_back(size + 1);
     }
   }
-  for (const auto& size : sizes) {
+  for (size_t size_idx = 0; size_idx < sizes.size(); ++size_idx) {
+    const size_t size = sizes[size_idx];
     if (comm.rank() == 0) {
       std::cout << "Testing size " << human_readable_size(size) << std::endl;
     }
@@ -70,12 +98,7 @@ void test_multiple_nballreduces() {
       }
       // Start each allreduce.
       for (size_t i = 0; i < num_concurrent; ++i) {
-        Al::NonblockingAllreduce<Backend>(input_data[i].data(),
-                                          input_data[i].size(),
-                                          Al::ReductionOperator::sum,
-                                          comm,
-                                          reqs[i],
-                                          algo);
+        start_allreduce<Backend>(input_data[i], comm, reqs[i], algo, i);
       }
       // This is commented out because I don't have a good way to generalize it,
       // but it can be used to reveal bugs in the MPI-CUDA host-transfer
@@ -87,9 +110,43 @@ void test_multiple_nballreduces() {
                                       Al::ReductionOperator::sum, comm);
       }*/
       (void) num_blocking;
-      // Complete and check them.
+      // Complete them, cycling through the ways to complete requests.
+      switch (size_idx % 4) {
+      case 0:
+        for (size_t i = 0; i < num_concurrent; ++i) {
+          Al::Wait<Backend>(reqs[i]);
+        }
+        break;
+      case 1:
+        Al::WaitAll<Backend>(num_concurrent, reqs.data());
+        break;
+      case 2:
+        // Requests that completed immediately are already null.
+        while (Al::WaitAny<Backend>(num_concurrent, reqs.data())
+               != num_concurrent) {}
+        break;
+      case 3:
+        {
+          std::vector<size_t> indices(num_concurrent);
+          size_t num_remaining = std::count_if(
+            reqs.begin(), reqs.end(),
+            [] (const typename Backend::req_type& req) {
+              return req != Backend::null_req;
+            });
+          while (num_remaining > 0) {
+            num_remaining -= Al::TestSome<Backend>(
+              num_concurrent, reqs.data(), indices.data());
+          }
+          if (!Al::TestAll<Backend>(num_concurrent, reqs.data())) {
+            std::cout << comm.rank() << ": TestAll found incomplete requests"
+                      << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+          }
+        }
+        break;
+      }
+      // Check them.
       for (size_t i = 0; i < num_concurrent; ++i) {
-        Al::Wait<Backend>(reqs[i]);
         if (!check_vector(expected_results[i], input_data[i])) {
           std::cout << comm.rank() << ": allreduce does not match" << std::endl;
           MPI_Abort(MPI_COMM_WORLD, 1);
@@ -99,6 +156,107 @@ void test_multiple_nballreduces() {
   }
 }
 
+/**
+ * Run chains of in-place allreduces where each depends on the one before it
+ * in the chain, so it must reduce that one's result, while the chains are
+ * independent of each other.
+ */
+void test_dependent_nballreduces() {
+  const size_t num_chains = 16;
+  const size_t chain_length = 4;
+  auto algos = get_nb_allreduce_algorithms<Al::MPIBackend>();
+  Al::MPIBackend::comm_type comm;  // Use COMM_WORLD.
+  for (size_t size = 1; size <= max_size; size *= 8) {
+    if (comm.rank() == 0) {
+      std::cout << "Testing dependencies, size " << human_readable_size(size)
+                << std::endl;
+    }
+    for (auto&& algo : algos) {
+      std::vector<std::vector<float>> data;
+      std::vector<std::vector<float>> expected_results;
+      for (size_t c = 0; c < num_chains; ++c) {
+        data.push_back(gen_data<Al::MPIBackend>(size));
+        expected_results.push_back(data[c]);
+        for (size_t k = 0; k < chain_length; ++k) {
+          get_expected_allreduce_result(expected_results[c]);
+        }
+      }
+      MPI_Barrier(MPI_COMM_WORLD);
+      // Request for link k of chain c is at k*num_chains + c.
+      std::vector<Al::MPIBackend::req_type> reqs(num_chains*chain_length);
+      for (size_t k = 0; k < chain_length; ++k) {
+        for (size_t c = 0; c < num_chains; ++c) {
+          std::vector<Al::MPIBackend::req_type> deps;
+          if (k > 0) {
+            deps.push_back(reqs[(k-1)*num_chains + c]);
+          }
+          Al::NonblockingAllreduce<Al::MPIBackend>(
+            data[c].data(), size, Al::ReductionOperator::sum, comm,
+            reqs[k*num_chains + c], deps, algo);
+        }
+      }
+      Al::WaitAll<Al::MPIBackend>(reqs.size(), reqs.data());
+      for (size_t c = 0; c < num_chains; ++c) {
+        if (!check_vector(expected_results[c], data[c])) {
+          std::cout << comm.rank() << ": dependent allreduce does not match"
+                    << std::endl;
+          MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+      }
+    }
+  }
+}
+
+/**
+ * Run small allreduces followed by large ones, where each large allreduce
+ * depends on a small one in the reverse order. Dependencies then finish in
+ * an order unrelated to the one the large allreduces were started in, which
+ * may differ between ranks, and the large ones compete for the few slots for
+ * operations above AL_PE_SMALL_OP_BYTES.
+ */
+void test_out_of_order_dependencies() {
+  const size_t num_ops = 16;
+  const size_t small_size = 16;
+  const size_t large_size = 1<<16;
+  const size_t num_iters = 4;
+  auto algos = get_nb_allreduce_algorithms<Al::MPIBackend>();
+  Al::MPIBackend::comm_type comm;  // Use COMM_WORLD.
+  if (comm.rank() == 0) {
+    std::cout << "Testing out-of-order dependencies" << std::endl;
+  }
+  for (auto&& algo : algos) {
+    for (size_t iter = 0; iter < num_iters; ++iter) {
+      std::vector<std::vector<float>> data;
+      std::vector<std::vector<float>> expected_results;
+      for (size_t i = 0; i < 2*num_ops; ++i) {
+        data.push_back(
+          gen_data<Al::MPIBackend>(i < num_ops ? small_size : large_size));
+        expected_results.push_back(data[i]);
+        get_expected_allreduce_result(expected_results[i]);
+      }
+      MPI_Barrier(MPI_COMM_WORLD);
+      std::vector<Al::MPIBackend::req_type> reqs(2*num_ops);
+      for (size_t i = 0; i < 2*num_ops; ++i) {
+        std::vector<Al::MPIBackend::req_type> deps;
+        if (i >= num_ops) {
+          deps.push_back(reqs[2*num_ops - 1 - i]);
+        }
+        Al::NonblockingAllreduce<Al::MPIBackend>(
+          data[i].data(), data[i].size(), Al::ReductionOperator::sum, comm,
+          reqs[i], deps, algo);
+      }
+      Al::WaitAll<Al::MPIBackend>(reqs.size(), reqs.data());
+      for (size_t i = 0; i < 2*num_ops; ++i) {
+        if (!check_vector(expected_results[i], data[i])) {
+          std::cout << comm.rank() << ": out-of-order dependent allreduce"
+                    << " does not match" << std::endl;
+          MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+      }
+    }
+  }
+}
+
 int main(int argc, char** argv) {
 #ifdef AL_HAS_CUDA
   set_device();
@@ -115,6 +273,8 @@ int main(int argc, char** argv) {
 
   if (backend == "MPI") {
     test_multiple_nballreduces<Al::MPIBackend>();
+    test_dependent_nballreduces();
+    test_out_of_order_dependencies();
 #ifdef AL_HAS_NCCL
   } else if (backend == "NCCL") {
     test_multiple_nballreduces<Al::NCCLBackend>();
@@ -0,0 +1,135 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2018, Lawrence Livermore National Security, LLC.  Produced at the
+// Lawrence Livermore National Laboratory in collaboration with University of
+// Illinois Urbana-Champaign.
+//
+// Written by the LBANN Research Team (N. Dryden, N. Maruyama, et al.) listed in
+// the CONTRIBUTORS file. <lbann-dev@llnl.gov>
+//
+// LLNL-CODE-756777.
+// All rights reserved.
+//
+// This file is part of Aluminum GPU-aware Communication Library. For details, see
+// http://software.llnl.gov/Aluminum or https://github.com/LLNL/Aluminum.
+//
+// Licensed under the Apache License, Version 2.0 (the "Licensee"); you
+// may not use this file except in compliance with the License.  You may
+// obtain a copy of the License at:
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+// implied. See the License for the specific language governing
+// permissions and limitations under the license.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include "Al.hpp"
+#include "test_utils.hpp"
+
+#include <stdlib.h>
+#include <math.h>
+#include <string>
+
+size_t start_size = 1;
+size_t max_size = 1<<30;
+/** Number of times each persistent allreduce is started. */
+const size_t num_iters = 4;
+
+/**
+ * Test a persistent allreduce with algo, starting it num_iters times with
+ * fresh input each time.
+ */
+template <typename Backend>
+void test_persistent_allreduce_algo(size_t size,
+                                    typename Backend::comm_type& comm,
+                                    typename Backend::allreduce_algo_type algo) {
+  typename Backend::req_type req = get_request<Backend>();
+  typename Backend::persistent_req_type preq =
+    Backend::null_persistent_req;
+  auto input = get_vector<Backend>(size);
+  auto recv = get_vector<Backend>(size);
+  // Test regular allreduce.
+  Al::AllreduceInit<Backend>(input.data(), recv.data(), size,
+                             Al::ReductionOperator::sum, comm, preq, algo);
+  for (size_t iter = 0; iter < num_iters; ++iter) {
+    typename VectorType<Backend>::type &&data = gen_data<Backend>(size);
+    auto expected(data);
+    get_expected_allreduce_result(expected);
+    input = data;
+    Al::Start<Backend>(preq, req);
+    Al::Wait<Backend>(req);
+    if (!check_vector(expected, recv)) {
+      std::cout << comm.rank() << ": regular allreduce does not match"
+                << " in iteration " << iter << std::endl;
+      std::abort();
+    }
+  }
+  Al::RequestFree<Backend>(preq);
+  MPI_Barrier(MPI_COMM_WORLD);
+  // Test in-place allreduce.
+  Al::AllreduceInit<Backend>(input.data(), size,
+                             Al::ReductionOperator::sum, comm, preq, algo);
+  for (size_t iter = 0; iter < num_iters; ++iter) {
+    typename VectorType<Backend>::type &&data = gen_data<Backend>(size);
+    auto expected(data);
+    get_expected_allreduce_result(expected);
+    input = data;
+    Al::Start<Backend>(preq, req);
+    Al::Wait<Backend>(req);
+    if (!check_vector(expected, input)) {
+      std::cout << comm.rank() << ": in-place allreduce does not match"
+                << " in iteration " << iter << std::endl;
+      std::abort();
+    }
+  }
+  Al::RequestFree<Backend>(preq);
+}
+
+template <typename Backend>
+void test_correctness() {
+  auto algos = get_nb_allreduce_algorithms<Backend>();
+  // Persistent allreduces also support the pairwise-exchange/ring algorithm.
+  algos.push_back(Backend::allreduce_algo_type::mpi_pe_ring);
+  typename Backend::comm_type comm = get_comm_with_stream<Backend>(MPI_COMM_WORLD);
+  // Compute sizes to test.
+  std::vector<size_t> sizes = get_sizes(start_size, max_size, true);
+  for (const auto& size : sizes) {
+    if (comm.rank() == 0) {
+      std::cout << "Testing size " << human_readable_size(size) << std::endl;
+    }
+    for (auto&& mode : {Al::ProgressMode::engine, Al::ProgressMode::caller}) {
+      comm.set_progress_mode(mode);
+      for (auto&& algo : algos) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        if (comm.rank() == 0) {
+          std::cout << " Algo: persistent " << Al::algorithm_name(algo)
+                    << (mode == Al::ProgressMode::caller ? " (caller)" : "")
+                    << std::endl;
+        }
+        test_persistent_allreduce_algo<Backend>(size, comm, algo);
+      }
+    }
+  }
+  free_comm_with_stream<Backend>(comm);
+}
+
+int main(int argc, char** argv) {
+  Al::Initialize(argc, argv);
+
+  std::string backend = "MPI";
+  parse_args(argc, argv, backend, start_size, max_size);
+
+  // Persistent operations are only supported by the MPI backend.
+  if (backend == "MPI") {
+    test_correctness<Al::MPIBackend>();
+  } else {
+    std::cerr << "Persistent allreduces are not supported by backend "
+              << backend << std::endl;
+  }
+
+  Al::Finalize();
+  return 0;
+}
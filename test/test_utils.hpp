@@ -27,6 +27,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <vector>
 #include <random>
 #include <chrono>
@@ -377,6 +378,13 @@ void print_stats(std::vector<double>& times) {
     std::endl;
 }
 
+/** Return the p-th percentile of times. */
+double percentile(std::vector<double> times, double p) {
+  std::sort(times.begin(), times.end());
+  size_t idx = static_cast<size_t>(p * (times.size() - 1));
+  return times[idx];
+}
+
 // Stores runs for profiling a collective.
 template <typename Backend, typename AlgoType>
 struct CollectiveProfile {